@@ -0,0 +1,346 @@
+// Load -> save -> reload of generated files, checking the saved files are identical to the generated ones,
+// then strings saved in place, checking the file still passes verify() after every save.
+// Every size is run with a few script mixes, large sizes reach sections whose strings need a 4 byte POF0 value.
+// Usage: ytx-roundtrip [--sizes 1000,10000,100000,1000000] [--sections 8] [--folder path] [--help]
+// Returns 1 if any file does not round trip, 2 if the options are invalid.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "FileIO.h"
+#include "MappedFile.h"
+#include "Utils.h"
+#include "YtxFile.h"
+#include "YtxGenerator.h"
+
+namespace
+{
+    struct ScriptMix
+    {
+        const char* name;
+        int latinPercent;
+        int cjkPercent;
+        int surrogatePercent;
+    };
+
+    const ScriptMix SCRIPT_MIXES[] = {
+        {"ascii", 0, 0, 0},
+        {"mixed", 8, 6, 1},
+        {"cjk", 0, 90, 0},
+        {"surrogates", 0, 0, 50},
+    };
+
+    // Strings above this size in a section are stored in 4 bytes in POF0
+    const int LARGE_POFO_SIZE = 0x7FFE * 4;
+    // One string out of this many is shortened and put back to check saving in place
+    const size_t PATCH_STEP = 7;
+
+    void printUsage()
+    {
+        std::printf(
+            "Usage: ytx-roundtrip [options]\n"
+            "\n"
+            "Options:\n"
+            "  --sizes <counts>     Entries of the generated files, separated by commas(default: 1000,10000,100000,1000000)\n"
+            "  --sections <count>   Sections of the generated files(default: 8)\n"
+            "  --folder <path>      Folder where the files are generated(default: the temporary folder)\n"
+            "  -h, --help           Show this help\n");
+    }
+
+    class Timer
+    {
+    public:
+        Timer() : start(std::chrono::steady_clock::now()) {}
+
+        double seconds() const
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start;
+    };
+
+    double getThroughput(size_t bytes, double seconds)
+    {
+        return seconds > 0 ? bytes / seconds / 1e6 : 0;
+    }
+
+    // Offset of the first byte that differs, or -1 if the file holds exactly "expected"
+    long compareFile(const std::string& path, const std::vector<std::byte>& expected)
+    {
+        MappedFile file;
+        if (!file.open(path))
+        {
+            return 0;
+        }
+
+        std::span<const std::byte> bytes = file.bytes();
+        size_t common = std::min(bytes.size(), expected.size());
+        auto mismatch = std::mismatch(bytes.begin(), bytes.begin() + common, expected.begin());
+        if (mismatch.first != bytes.begin() + common)
+        {
+            return (long)(mismatch.first - bytes.begin());
+        }
+        return bytes.size() == expected.size() ? -1 : (long)common;
+    }
+
+    // Strings are emptied, then put back in two passes, every pass saved in place without the file changing size
+    // The file has to pass verify() after every pass and be the generated one again at the end
+    std::string checkSavesInPlace(const std::string& path, const std::vector<std::byte>& expected)
+    {
+        std::vector<std::string> replaced;
+        for (int pass = 0; pass <= 3; pass++)
+        {
+            YtxFile file(path);
+            file.load(false);
+            std::vector<std::string> problems = file.verify();
+            if (!problems.empty())
+            {
+                return "file saved in place fails to verify: " + problems.front();
+            }
+            if (pass == 3)
+            {
+                break;
+            }
+
+            size_t index = 0;
+            for (EntrySection& section : file.entrySections)
+            {
+                for (size_t row = 0; row < section.entries.size(); row += PATCH_STEP, index++)
+                {
+                    if (pass == 0)
+                    {
+                        replaced.push_back(std::string(section.entries.getString(row)));
+                        file.setEntryString(section, row, "");
+                    }
+                    else if (index % 2 == (size_t)pass - 1)
+                    {
+                        file.setEntryString(section, row, replaced.at(index));
+                    }
+                }
+            }
+
+            std::error_code error;
+            if (!file.saveChanges())
+            {
+                return "save in place failed";
+            }
+            if (std::filesystem::file_size(path, error) != expected.size())
+            {
+                return "strings that fit their slots were not saved in place";
+            }
+        }
+
+        long difference = compareFile(path, expected);
+        return difference < 0 ? "" : "strings put back in place differ at offset " + std::to_string(difference);
+    }
+
+    bool runCase(size_t entriesCount, int sectionsCount, const ScriptMix& mix, const std::filesystem::path& folder)
+    {
+        YtxGenerator::Options options;
+        options.entriesCount = entriesCount;
+        options.sectionsCount = sectionsCount;
+        options.latinPercent = mix.latinPercent;
+        options.cjkPercent = mix.cjkPercent;
+        options.surrogatePercent = mix.surrogatePercent;
+        options.seed = (unsigned int)entriesCount;
+
+        std::string path = (folder / ("ytx-roundtrip-" + std::to_string(entriesCount) + "-" + mix.name + ".ytx")).string();
+
+        Timer generateTimer;
+        std::vector<std::byte> expected = YtxGenerator::generate(options);
+        double generateSeconds = generateTimer.seconds();
+
+        FileIO::AtomicFileWriter out;
+        bool written = out.open(path, expected.size());
+        out.writeView(expected);
+        if (!written || !out.commit())
+        {
+            std::fprintf(stderr, "Failed to write %s\n", path.c_str());
+            return false;
+        }
+
+        std::string problem;
+        double loadSeconds = 0;
+        double saveSeconds = 0;
+        double decodedSaveSeconds = 0;
+        double reloadSeconds = 0;
+        int largePofoSections = 0;
+        std::vector<std::string> strings;
+        {
+            Timer loadTimer;
+            YtxFile file(path);
+            file.load(false);
+            loadSeconds = loadTimer.seconds();
+
+            if (!file.isValid())
+            {
+                problem = "generated file failed to load";
+            }
+            else
+            {
+                for (size_t i = 0; i + 1 < file.entrySections.size(); i++)
+                {
+                    largePofoSections += file.entrySections[i].stringsSize >= LARGE_POFO_SIZE ? 1 : 0;
+                }
+
+                // Strings that were never decoded are copied as they are
+                Timer saveTimer;
+                bool saved = file.saveChanges(true);
+                saveSeconds = saveTimer.seconds();
+
+                long difference = compareFile(path, expected);
+                if (!saved)
+                {
+                    problem = "save of raw strings failed";
+                }
+                else if (difference >= 0)
+                {
+                    problem = "save of raw strings differs at offset " + std::to_string(difference);
+                }
+            }
+
+            if (problem.empty())
+            {
+                // Every string goes through UTF-8 and back
+                for (EntrySection& section : file.entrySections)
+                {
+                    for (size_t row = 0; row < section.entries.size(); row++)
+                    {
+                        strings.push_back(std::string(section.entries.getString(row)));
+                    }
+                }
+
+                Timer saveTimer;
+                bool saved = file.saveChanges(true);
+                decodedSaveSeconds = saveTimer.seconds();
+
+                long difference = compareFile(path, expected);
+                if (!saved)
+                {
+                    problem = "save of decoded strings failed";
+                }
+                else if (difference >= 0)
+                {
+                    problem = "save of decoded strings differs at offset " + std::to_string(difference);
+                }
+            }
+        }
+
+        if (problem.empty())
+        {
+            Timer reloadTimer;
+            YtxFile file(path);
+            file.load(false);
+            size_t index = 0;
+            for (EntrySection& section : file.entrySections)
+            {
+                for (size_t row = 0; row < section.entries.size(); row++)
+                {
+                    if (index >= strings.size() || section.entries.getString(row) != strings[index])
+                    {
+                        problem = "string " + std::to_string(index) + " changed after reloading";
+                        break;
+                    }
+                    index++;
+                }
+            }
+            reloadSeconds = reloadTimer.seconds();
+
+            if (problem.empty() && index != strings.size())
+            {
+                problem = "entries missing after reloading";
+            }
+        }
+
+        if (problem.empty())
+        {
+            problem = checkSavesInPlace(path, expected);
+        }
+
+        std::printf("%9zu %-11s %9.2f %9.1f %9.1f %9.1f %9.1f %9.1f %6d  %s\n",
+                    entriesCount, mix.name, expected.size() / 1e6,
+                    getThroughput(expected.size(), generateSeconds),
+                    getThroughput(expected.size(), loadSeconds),
+                    getThroughput(expected.size(), saveSeconds),
+                    getThroughput(expected.size(), decodedSaveSeconds),
+                    getThroughput(expected.size(), reloadSeconds),
+                    largePofoSections,
+                    problem.empty() ? "identical" : problem.c_str());
+        std::fflush(stdout);
+
+        std::error_code error;
+        std::filesystem::remove(path, error);
+        return problem.empty();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<size_t> sizes = {1000, 10000, 100000, 1000000};
+    int sectionsCount = 8;
+    std::error_code error;
+    std::filesystem::path folder = std::filesystem::temp_directory_path(error);
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "-h" || argument == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (argument == "--sizes" && hasValue)
+        {
+            sizes.clear();
+            for (const std::string& size : Utils::splitString(argv[++i], ","))
+            {
+                sizes.push_back(std::strtoul(size.c_str(), nullptr, 10));
+            }
+        }
+        else if (argument == "--sections" && hasValue)
+        {
+            sectionsCount = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (argument == "--folder" && hasValue)
+        {
+            folder = argv[++i];
+        }
+        else if (argument == "--sizes" || argument == "--sections" || argument == "--folder")
+        {
+            std::fprintf(stderr, "Missing value for option: %s\n\n", argument.c_str());
+            printUsage();
+            return 2;
+        }
+        else
+        {
+            std::fprintf(stderr, "Unknown option: %s\n\n", argument.c_str());
+            printUsage();
+            return 2;
+        }
+    }
+
+    std::printf("Throughput in MB/s, \"POF0 4B\" is the amount of sections whose strings size takes 4 bytes in POF0\n");
+    std::printf("%9s %-11s %9s %9s %9s %9s %9s %9s %6s  %s\n",
+                "entries", "script", "size MB", "generate", "load", "save", "save dec", "reload", "POF0 4B", "result");
+
+    int failed = 0;
+    for (size_t size : sizes)
+    {
+        for (const ScriptMix& mix : SCRIPT_MIXES)
+        {
+            failed += runCase(size, sectionsCount, mix, folder) ? 0 : 1;
+        }
+    }
+
+    std::printf("%d failed\n", failed);
+    return failed == 0 ? 0 : 1;
+}
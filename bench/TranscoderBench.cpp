@@ -0,0 +1,156 @@
+// Throughput of Transcoder against the std::wstring_convert based conversion it replaced.
+// Usage: ytx-transcoder-bench [strings per corpus]
+
+#include <algorithm>
+#include <chrono>
+#include <codecvt>
+#include <cstdio>
+#include <cstdlib>
+#include <locale>
+#include <random>
+#include <string>
+#include <vector>
+#include "Transcoder.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#elif defined(_MSC_VER)
+#pragma warning(disable : 4996)
+#endif
+
+namespace
+{
+    struct Corpus
+    {
+        const char* name;
+        std::vector<std::u16string> utf16;
+        std::vector<std::string> utf8;
+        size_t utf16Bytes = 0;
+    };
+
+    // Previous implementation, one converter per call like Utils used to do
+    std::string legacyUtf16ToUtf8(const std::u16string& source)
+    {
+        std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
+        return convert.to_bytes(source);
+    }
+
+    std::u16string legacyUtf8ToUtf16(const std::string& source)
+    {
+        std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
+        return convert.from_bytes(source);
+    }
+
+    void appendCodePoint(std::u16string& _string, char32_t codePoint)
+    {
+        if (codePoint < 0x10000)
+        {
+            _string.push_back((char16_t)codePoint);
+            return;
+        }
+        codePoint -= 0x10000;
+        _string.push_back((char16_t)(0xD800 + (codePoint >> 10)));
+        _string.push_back((char16_t)(0xDC00 + (codePoint & 0x3FF)));
+    }
+
+    Corpus makeCorpus(const char* name, size_t count, char32_t first, char32_t last, int asciiPercent, unsigned seed)
+    {
+        Corpus corpus{name, {}, {}, 0};
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<int> length(8, 96);
+        std::uniform_int_distribution<int> percent(0, 99);
+        std::uniform_int_distribution<char32_t> ascii(0x20, 0x7E);
+        std::uniform_int_distribution<char32_t> other(first, last);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            std::u16string _string;
+            int characters = length(random);
+            for (int c = 0; c < characters; c++)
+            {
+                appendCodePoint(_string, percent(random) < asciiPercent ? ascii(random) : other(random));
+            }
+
+            corpus.utf16Bytes += _string.size() * 2;
+            corpus.utf8.push_back(legacyUtf16ToUtf8(_string));
+            corpus.utf16.push_back(std::move(_string));
+        }
+        return corpus;
+    }
+
+    // Best of a few runs, in MB/s
+    template <typename Function>
+    double measure(size_t bytes, Function function)
+    {
+        const int RUNS = 3;
+
+        double best = 0;
+        for (int run = 0; run < RUNS; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::max(best, bytes / elapsed.count() / (1024.0 * 1024.0));
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 200000;
+
+    std::vector<Corpus> corpora;
+    corpora.push_back(makeCorpus("ascii", count, 0x20, 0x7E, 100, 1));
+    corpora.push_back(makeCorpus("latin", count, 0xA0, 0x17F, 85, 2));
+    corpora.push_back(makeCorpus("cjk", count, 0x4E00, 0x9FFF, 10, 3));
+    corpora.push_back(makeCorpus("emoji", count, 0x1F300, 0x1F64F, 70, 4));
+
+    std::printf("Transcoder implementation: %s\n", Transcoder::getImplementationName());
+    std::printf("%-8s %-14s %12s %12s %9s\n", "corpus", "direction", "legacy MB/s", "new MB/s", "speedup");
+
+    size_t checksum = 0;
+    for (const Corpus& corpus : corpora)
+    {
+        double legacyTo8 = measure(corpus.utf16Bytes, [&]() {
+            for (const std::u16string& _string : corpus.utf16)
+            {
+                checksum += legacyUtf16ToUtf8(_string).size();
+            }
+        });
+
+        std::string utf8;
+        double newTo8 = measure(corpus.utf16Bytes, [&]() {
+            for (const std::u16string& _string : corpus.utf16)
+            {
+                utf8.clear();
+                Transcoder::utf16ToUtf8(_string, utf8);
+                checksum += utf8.size();
+            }
+        });
+
+        double legacyTo16 = measure(corpus.utf16Bytes, [&]() {
+            for (const std::string& _string : corpus.utf8)
+            {
+                checksum += legacyUtf8ToUtf16(_string).size();
+            }
+        });
+
+        std::vector<std::byte> utf16Be;
+        double newTo16 = measure(corpus.utf16Bytes, [&]() {
+            for (const std::string& _string : corpus.utf8)
+            {
+                utf16Be.clear();
+                Transcoder::utf8ToUtf16Be(_string, utf16Be);
+                checksum += utf16Be.size();
+            }
+        });
+
+        std::printf("%-8s %-14s %12.1f %12.1f %8.1fx\n", corpus.name, "utf16->utf8", legacyTo8, newTo8, newTo8 / legacyTo8);
+        std::printf("%-8s %-14s %12.1f %12.1f %8.1fx\n", corpus.name, "utf8->utf16be", legacyTo16, newTo16, newTo16 / legacyTo16);
+    }
+
+    // Keeps the conversions from being optimized away
+    std::printf("checksum: %zu\n", checksum);
+    return 0;
+}
@@ -0,0 +1,294 @@
+// Timings of the load, transcode, layout, save and filter hot paths on generated files.
+// Results are printed as JSON so runs can be compared, progress goes to stderr.
+// Usage: ytx-bench [--sizes 1000,100000,1000000] [--iterations 5] [--output results.json] [--folder path]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "EntryFilter.h"
+#include "Transcoder.h"
+#include "Utils.h"
+#include "YtxFile.h"
+#include "YtxGenerator.h"
+
+// Access to the stages of YtxFile that are not public
+struct YtxFileBenchAccess
+{
+    static void clearEntries(YtxFile& file)
+    {
+        for (EntrySection& section : file.entrySections)
+        {
+            section.entries.clear();
+            section.stringsSize = 0;
+        }
+    }
+
+    static bool loadEntries(YtxFile& file)
+    {
+        return file.loadEntries();
+    }
+
+    static size_t reassemble(YtxFile::SaveSnapshot& snapshot)
+    {
+        return YtxFile::reassemble(snapshot);
+    }
+
+    static void rewritePofo(YtxFile::SaveSnapshot& snapshot)
+    {
+        snapshot.pofo = YtxFile::buildPofo(snapshot.sections);
+    }
+};
+
+namespace
+{
+    struct Measurement
+    {
+        std::string name;
+        size_t entries;
+        size_t bytes;
+        int iterations;
+        double bestSeconds;
+        double medianSeconds;
+    };
+
+    // Run "function" a few times after an untimed "setup", keeping the best and median times
+    Measurement measure(const std::string& name, size_t entries, size_t bytes, int iterations,
+                        const std::function<void()>& setup, const std::function<void()>& function)
+    {
+        std::vector<double> times;
+        for (int i = 0; i < iterations; i++)
+        {
+            if (setup)
+            {
+                setup();
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            function();
+            times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        std::sort(times.begin(), times.end());
+        Measurement measurement{name, entries, bytes, iterations, times.front(), times.at(times.size() / 2)};
+
+        std::fprintf(stderr, "  %-20s %10.3f ms %10.1f MB/s %14.0f entries/s\n", name.c_str(),
+                     measurement.bestSeconds * 1000, bytes / measurement.bestSeconds / 1e6,
+                     entries / measurement.bestSeconds);
+        return measurement;
+    }
+
+    std::vector<size_t> parseSizes(const char* text)
+    {
+        std::vector<size_t> sizes;
+        for (const std::string& size : Utils::splitString(text, ","))
+        {
+            size_t value = std::strtoul(size.c_str(), nullptr, 10);
+            if (value > 0)
+            {
+                sizes.push_back(value);
+            }
+        }
+        return sizes;
+    }
+
+    void runSize(size_t entriesCount, int iterations, const std::filesystem::path& folder,
+                 std::vector<Measurement>& results, size_t& checksum)
+    {
+        std::string path = (folder / ("ytx-bench-" + std::to_string(entriesCount) + ".ytx")).string();
+        YtxGenerator::Options options;
+        options.entriesCount = entriesCount;
+        options.seed = (unsigned int)entriesCount;
+        if (!YtxGenerator::writeFile(path, options))
+        {
+            std::fprintf(stderr, "Failed to write generated file: %s\n", path.c_str());
+            std::exit(1);
+        }
+        size_t fileSize = std::filesystem::file_size(path);
+        std::fprintf(stderr, "%zu entries, %.2f MB\n", entriesCount, fileSize / 1e6);
+
+        std::optional<YtxFile> file;
+        results.push_back(measure("load", entriesCount, fileSize, iterations,
+            [&] { file.reset(); },
+            [&] { file.emplace(path); file->load(false); }));
+        if (!file->isValid())
+        {
+            std::fprintf(stderr, "Generated file is invalid: %s\n", path.c_str());
+            std::exit(1);
+        }
+
+        results.push_back(measure("loadEntries", entriesCount, fileSize, iterations,
+            [&] { YtxFileBenchAccess::clearEntries(*file); },
+            [&] { YtxFileBenchAccess::loadEntries(*file); }));
+
+        // Taken on the UI thread when saving starts, everything else runs in the background
+        std::unique_ptr<YtxFile::SaveSnapshot> snapshot;
+        results.push_back(measure("saveSnapshot", entriesCount, fileSize, iterations,
+            [&] { snapshot.reset(); },
+            [&] { snapshot = file->createSaveSnapshot(true); }));
+
+        results.push_back(measure("reassemble", entriesCount, fileSize, iterations, nullptr,
+            [&] { checksum += YtxFileBenchAccess::reassemble(*snapshot); }));
+
+        results.push_back(measure("rewritePofo", entriesCount, fileSize, iterations, nullptr,
+            [&] { YtxFileBenchAccess::rewritePofo(*snapshot); }));
+        snapshot.reset();
+
+        // Strings that were never decoded are written straight from the mapping
+        results.push_back(measure("save", entriesCount, fileSize, iterations, nullptr,
+            [&] { file->saveChanges(true); }));
+
+        std::vector<std::string> utf8;
+        std::vector<std::u16string> utf16;
+        size_t utf8Bytes = 0;
+        size_t utf16Bytes = 0;
+        for (EntrySection& section : file->entrySections)
+        {
+            for (size_t row = 0; row < section.entries.size(); row++)
+            {
+                utf8.push_back(std::string(section.entries.getString(row)));
+                utf16.push_back(Utils::convertUtf8ToUtf16(utf8.back()));
+                utf8Bytes += utf8.back().size();
+                utf16Bytes += utf16.back().size() * 2;
+            }
+        }
+
+        results.push_back(measure("convertUtf16ToUtf8", entriesCount, utf16Bytes, iterations, nullptr,
+            [&] {
+                for (const std::u16string& _string : utf16)
+                {
+                    checksum += Utils::convertUtf16ToUtf8(_string).size();
+                }
+            }));
+
+        results.push_back(measure("convertUtf8ToUtf16", entriesCount, utf8Bytes, iterations, nullptr,
+            [&] {
+                for (const std::string& _string : utf8)
+                {
+                    checksum += Utils::convertUtf8ToUtf16(_string).size();
+                }
+            }));
+
+        // Every string has to be encoded again
+        results.push_back(measure("saveDecoded", entriesCount, fileSize, iterations, nullptr,
+            [&] { file->saveChanges(true); }));
+
+        std::vector<EntryFilter::Match> matches;
+        results.push_back(measure("filterString", entriesCount, utf8Bytes, iterations, nullptr,
+            [&] {
+                EntryFilter::filterEntries(*file, std::nullopt, EntryFilter::Field::STRING, "ab", matches);
+                checksum += matches.size();
+            }));
+
+        results.push_back(measure("buildSearchIndex", entriesCount, utf8Bytes, iterations, nullptr,
+            [&] { file->buildSearchIndex(); }));
+
+        // Part of a string from the middle of the file, long enough for the index to be used
+        std::string query = Utils::convertUtf16ToUtf8(utf16.at(utf16.size() / 2).substr(0, 4));
+        results.push_back(measure("filterStringIndexed", entriesCount, utf8Bytes, iterations, nullptr,
+            [&] {
+                EntryFilter::filterEntries(*file, std::nullopt, EntryFilter::Field::STRING, query, matches);
+                checksum += matches.size();
+            }));
+
+        // Too short for the index, searched in the string arena
+        results.push_back(measure("filterStringArena", entriesCount, utf8Bytes, iterations, nullptr,
+            [&] {
+                EntryFilter::filterEntries(*file, std::nullopt, EntryFilter::Field::STRING, "ab", matches, true);
+                checksum += matches.size();
+            }));
+
+        results.push_back(measure("filterId", entriesCount, entriesCount * sizeof(int), iterations, nullptr,
+            [&] {
+                EntryFilter::filterEntries(*file, std::nullopt, EntryFilter::Field::ID, "1f", matches);
+                checksum += matches.size();
+            }));
+
+        file.reset();
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
+
+    std::string toJson(const std::vector<Measurement>& results, int iterations, size_t checksum)
+    {
+        std::string json = "{\n";
+        json += "  \"transcoder\": \"" + std::string(Transcoder::getImplementationName()) + "\",\n";
+        json += "  \"iterations\": " + std::to_string(iterations) + ",\n";
+        json += "  \"checksum\": " + std::to_string(checksum) + ",\n";
+        json += "  \"results\": [\n";
+
+        char line[512];
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Measurement& result = results[i];
+            std::snprintf(line, sizeof(line),
+                          "    {\"name\": \"%s\", \"entries\": %zu, \"bytes\": %zu, \"iterations\": %d, "
+                          "\"best_seconds\": %.9f, \"median_seconds\": %.9f, \"mb_per_second\": %.3f, \"entries_per_second\": %.1f}%s\n",
+                          result.name.c_str(), result.entries, result.bytes, result.iterations,
+                          result.bestSeconds, result.medianSeconds,
+                          result.bytes / result.bestSeconds / 1e6, result.entries / result.bestSeconds,
+                          i + 1 < results.size() ? "," : "");
+            json += line;
+        }
+
+        json += "  ]\n}\n";
+        return json;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<size_t> sizes = {1000, 100000, 1000000};
+    int iterations = 5;
+    std::string outputPath;
+    std::error_code error;
+    std::filesystem::path folder = std::filesystem::temp_directory_path(error);
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--sizes") == 0)
+        {
+            sizes = parseSizes(argv[i + 1]);
+        }
+        else if (std::strcmp(argv[i], "--iterations") == 0)
+        {
+            iterations = std::max(1, std::atoi(argv[i + 1]));
+        }
+        else if (std::strcmp(argv[i], "--output") == 0)
+        {
+            outputPath = argv[i + 1];
+        }
+        else if (std::strcmp(argv[i], "--folder") == 0)
+        {
+            folder = argv[i + 1];
+        }
+    }
+
+    std::vector<Measurement> results;
+    size_t checksum = 0;
+    for (size_t size : sizes)
+    {
+        runSize(size, iterations, folder, results, checksum);
+    }
+
+    std::string json = toJson(results, iterations, checksum);
+    if (outputPath.empty())
+    {
+        std::fwrite(json.data(), 1, json.size(), stdout);
+    }
+    else
+    {
+        std::ofstream out(outputPath, std::ios::binary);
+        out.write(json.data(), json.size());
+    }
+    return 0;
+}
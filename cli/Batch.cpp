@@ -0,0 +1,147 @@
+#include "Batch.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+
+namespace Batch
+{
+    namespace
+    {
+        bool isYtxFile(const std::filesystem::path& path)
+        {
+            std::string extension = path.extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                           [](unsigned char c) { return (char)std::tolower(c); });
+            return extension == ".ytx";
+        }
+
+        double toMegabytes(size_t bytes)
+        {
+            return bytes / (1024.0 * 1024.0);
+        }
+
+        double getThroughput(size_t bytes, double seconds)
+        {
+            return seconds > 0 ? toMegabytes(bytes) / seconds : 0;
+        }
+
+        void printSummary(const std::vector<std::string>& files, const std::vector<FileResult>& results,
+                          size_t jobs, double seconds)
+        {
+            size_t failed = 0;
+            size_t totalBytes = 0;
+            double busySeconds = 0;
+            std::vector<double> throughputs;
+            for (const FileResult& result : results)
+            {
+                failed += result.ok ? 0 : 1;
+                totalBytes += result.bytes;
+                busySeconds += result.seconds;
+                if (result.ok)
+                {
+                    throughputs.push_back(getThroughput(result.bytes, result.seconds));
+                }
+            }
+
+            std::printf("\nFiles: %zu (%zu ok, %zu failed)\n", results.size(), results.size() - failed, failed);
+            std::printf("Data: %.2f MB in %.3f s (%.1f MB/s) with %zu jobs, %.0f%% busy\n",
+                        toMegabytes(totalBytes), seconds, getThroughput(totalBytes, seconds), jobs,
+                        seconds > 0 ? 100.0 * busySeconds / (seconds * jobs) : 0.0);
+
+            if (!throughputs.empty())
+            {
+                std::sort(throughputs.begin(), throughputs.end());
+                std::printf("Per file: min %.1f MB/s, median %.1f MB/s, max %.1f MB/s\n",
+                            throughputs.front(), throughputs.at(throughputs.size() / 2), throughputs.back());
+            }
+
+            auto slowest = std::max_element(results.begin(), results.end(),
+                                            [](const FileResult& a, const FileResult& b) { return a.seconds < b.seconds; });
+            if (slowest != results.end())
+            {
+                std::printf("Slowest: %s (%.1f ms)\n", files.at(slowest - results.begin()).c_str(), slowest->seconds * 1000);
+            }
+        }
+    }
+
+    std::vector<std::string> collectFiles(const std::vector<std::string>& paths)
+    {
+        std::vector<std::string> files;
+        for (const std::string& path : paths)
+        {
+            std::error_code error;
+            if (!std::filesystem::is_directory(path, error))
+            {
+                // Files given directly are used whatever their extension is
+                files.push_back(path);
+                continue;
+            }
+
+            std::filesystem::recursive_directory_iterator iterator(
+                path, std::filesystem::directory_options::skip_permission_denied, error);
+            std::filesystem::recursive_directory_iterator end;
+            for (; !error && iterator != end; iterator.increment(error))
+            {
+                if (iterator->is_regular_file(error) && isYtxFile(iterator->path()))
+                {
+                    files.push_back(iterator->path().string());
+                }
+            }
+            if (error)
+            {
+                std::fprintf(stderr, "Failed to read folder %s: %s\n", path.c_str(), error.message().c_str());
+            }
+        }
+
+        std::sort(files.begin(), files.end());
+        files.erase(std::unique(files.begin(), files.end()), files.end());
+        return files;
+    }
+
+    size_t run(const std::vector<std::string>& files, const Task& task, const Options& options)
+    {
+        std::vector<FileResult> results(files.size());
+        std::mutex outputMutex;
+
+        auto start = std::chrono::steady_clock::now();
+        size_t jobs;
+        {
+            ThreadPool pool(std::min(options.jobs == 0 ? ThreadPool::getDefaultThreadCount() : options.jobs,
+                                     std::max<size_t>(files.size(), 1)));
+            jobs = pool.size();
+
+            for (size_t i = 0; i < files.size(); i++)
+            {
+                pool.submit([&, i]
+                {
+                    auto fileStart = std::chrono::steady_clock::now();
+                    FileResult result = task(files[i]);
+                    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - fileStart).count();
+
+                    if (!options.quiet || !result.ok)
+                    {
+                        std::lock_guard<std::mutex> lock(outputMutex);
+                        std::printf("[%s] %s  %.2f MB  %.1f ms  %.1f MB/s  %s\n", result.ok ? "ok" : "FAILED",
+                                    files[i].c_str(), toMegabytes(result.bytes), result.seconds * 1000,
+                                    getThroughput(result.bytes, result.seconds), result.message.c_str());
+                        for (const std::string& detail : result.details)
+                        {
+                            std::printf("    %s\n", detail.c_str());
+                        }
+                    }
+                    results[i] = std::move(result);
+                });
+            }
+            pool.wait();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printSummary(files, results, jobs, seconds);
+        return std::count_if(results.begin(), results.end(), [](const FileResult& result) { return !result.ok; });
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Runs one task per file on a work stealing thread pool and reports how long each one took
+namespace Batch
+{
+    struct FileResult
+    {
+        bool ok = false;
+        std::string message;
+        std::vector<std::string> details; // Extra lines printed under the file, like verify problems
+        size_t bytes = 0;                 // Size of the .ytx file processed
+        double seconds = 0;
+    };
+
+    using Task = std::function<FileResult(const std::string& path)>;
+
+    struct Options
+    {
+        size_t jobs = 0; // 0 uses one per hardware thread
+        bool quiet = false;
+    };
+
+    // Find every .ytx file in the given paths, searching folders recursively
+    std::vector<std::string> collectFiles(const std::vector<std::string>& paths);
+
+    // Run "task" on every file, printing a line per file as they finish and a throughput summary at the end
+    // Returns the amount of files that failed
+    size_t run(const std::vector<std::string>& files, const Task& task, const Options& options);
+}
@@ -0,0 +1,271 @@
+#include "Commands.h"
+#include "FolderSearch.h"
+#include "TableIO.h"
+#include "YtxFile.h"
+#include "YtxPatch.h"
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string_view>
+
+namespace Commands
+{
+    namespace
+    {
+        const char* PATCH_EXTENSION = ".ytxpatch";
+
+        // Tabs and line breaks in strings are escaped so every entry takes a single line
+        void appendEscaped(std::string& output, std::string_view _string)
+        {
+            for (char c : _string)
+            {
+                switch (c)
+                {
+                case '\\':
+                    output += "\\\\";
+                    break;
+                case '\t':
+                    output += "\\t";
+                    break;
+                case '\n':
+                    output += "\\n";
+                    break;
+                case '\r':
+                    output += "\\r";
+                    break;
+                default:
+                    output += c;
+                }
+            }
+        }
+
+        Batch::FileResult fail(const std::string& message, size_t bytes = 0)
+        {
+            Batch::FileResult result;
+            result.message = message;
+            result.bytes = bytes;
+            return result;
+        }
+    }
+
+    std::string getTablePath(const std::string& path, const Options& options)
+    {
+        std::string extension = TableIO::getExtension(options.format);
+        if (options.outputFolder.empty())
+        {
+            return path + extension;
+        }
+        std::filesystem::path name = std::filesystem::path(path).filename();
+        return (std::filesystem::path(options.outputFolder) / name).string() + extension;
+    }
+
+    std::string getPatchPath(const std::string& path, const Options& options)
+    {
+        if (options.outputFolder.empty())
+        {
+            return path + PATCH_EXTENSION;
+        }
+        std::filesystem::path name = std::filesystem::path(path).filename();
+        return (std::filesystem::path(options.outputFolder) / name).string() + PATCH_EXTENSION;
+    }
+
+    Batch::FileResult extract(const std::string& path, const Options& options)
+    {
+        YtxFile file(path);
+        file.load(false);
+        if (!file.isValid())
+        {
+            return fail("Could not be loaded");
+        }
+
+        std::string tablePath = getTablePath(path, options);
+        size_t entriesCount = 0;
+        if (!TableIO::exportFile(file, tablePath, options.format, &entriesCount))
+        {
+            return fail("Could not write " + tablePath, file.getSize());
+        }
+
+        Batch::FileResult result;
+        result.ok = true;
+        result.bytes = file.getSize();
+        result.message = std::to_string(entriesCount) + " entries written to " + tablePath;
+        return result;
+    }
+
+    Batch::FileResult apply(const std::string& path, const Options& options)
+    {
+        std::string tablePath = getTablePath(path, options);
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(tablePath, error))
+        {
+            return fail("Could not read " + tablePath);
+        }
+
+        YtxFile file(path);
+        file.load();
+        if (!file.isValid())
+        {
+            return fail("Could not be loaded");
+        }
+
+        TableIO::ImportResult imported = TableIO::importFile(file, tablePath, options.format);
+        if (!imported.ok)
+        {
+            return fail(imported.error, file.getSize());
+        }
+
+        if (imported.changed > 0 && !file.saveChanges())
+        {
+            return fail("Could not be saved", file.getSize());
+        }
+
+        Batch::FileResult result;
+        result.ok = true;
+        result.bytes = file.getSize();
+        result.message = std::to_string(imported.changed) + " entries changed";
+        if (imported.notFound > 0)
+        {
+            result.message += ", " + std::to_string(imported.notFound) + " not found in the file";
+        }
+        return result;
+    }
+
+    Batch::FileResult stat(const std::string& path, const Options&)
+    {
+        YtxFile file(path);
+        file.load(false);
+        if (!file.isValid())
+        {
+            return fail("Could not be loaded");
+        }
+
+        int entriesCount = 0;
+        int stringsSize = 0;
+        for (const EntrySection& section : file.entrySections)
+        {
+            entriesCount += (int)section.entries.size();
+            stringsSize += section.stringsSize;
+        }
+
+        Batch::FileResult result;
+        result.ok = true;
+        result.bytes = file.getSize();
+        result.message = std::to_string(file.entrySections.size()) + " sections, " +
+                         std::to_string(entriesCount) + " entries, " +
+                         std::to_string(stringsSize) + " bytes of strings";
+        return result;
+    }
+
+    Batch::FileResult verify(const std::string& path, const Options&)
+    {
+        YtxFile file(path);
+        file.load(false);
+
+        Batch::FileResult result;
+        result.bytes = file.getSize();
+        result.details = file.verify();
+        result.ok = result.details.empty();
+        result.message = result.ok ? "Valid" : std::to_string(result.details.size()) + " problems found";
+        return result;
+    }
+
+    Batch::FileResult search(const std::string& path, const Options& options)
+    {
+        Batch::FileResult result;
+        auto onResult = [&result](FolderSearch::Result&& found) {
+            std::string line;
+            char ids[32];
+            std::snprintf(ids, sizeof(ids), "%x\t%x\t", (unsigned int)found.sectionId, (unsigned int)found.entryId);
+            line += ids;
+            appendEscaped(line, found._string);
+            result.details.push_back(std::move(line));
+        };
+
+        if (!FolderSearch::searchFile(path, options.searchQuery, onResult))
+        {
+            return fail("Could not be loaded");
+        }
+
+        std::error_code error;
+        result.ok = true;
+        result.bytes = std::filesystem::file_size(path, error);
+        result.message = std::to_string(result.details.size()) + " matches";
+        return result;
+    }
+
+    Batch::FileResult diff(const std::string& path, const Options& options)
+    {
+        std::string basePath = (std::filesystem::path(options.baseFolder) / std::filesystem::path(path).filename()).string();
+        YtxFile oldFile(basePath);
+        oldFile.load(false);
+        if (!oldFile.isValid())
+        {
+            return fail("Could not load " + basePath);
+        }
+        YtxFile newFile(path);
+        newFile.load(false);
+        if (!newFile.isValid())
+        {
+            return fail("Could not be loaded");
+        }
+
+        std::vector<YtxPatch::Operation> operations;
+        std::string error;
+        if (!YtxPatch::diff(oldFile, newFile, operations, error))
+        {
+            return fail(error, newFile.getSize());
+        }
+
+        std::string patchPath = getPatchPath(path, options);
+        if (!YtxPatch::write(patchPath, operations))
+        {
+            return fail("Could not write " + patchPath, newFile.getSize());
+        }
+
+        Batch::FileResult result;
+        result.ok = true;
+        result.bytes = newFile.getSize();
+        result.message = std::to_string(operations.size()) + " entries differ, written to " + patchPath;
+        return result;
+    }
+
+    Batch::FileResult patch(const std::string& path, const Options& options)
+    {
+        std::string patchPath = getPatchPath(path, options);
+        std::vector<YtxPatch::Operation> operations;
+        std::string error;
+        if (!YtxPatch::read(patchPath, operations, error))
+        {
+            return fail(error);
+        }
+
+        YtxFile file(path);
+        file.load();
+        if (!file.isValid())
+        {
+            return fail("Could not be loaded");
+        }
+
+        YtxPatch::ApplyResult applied = YtxPatch::apply(file, operations);
+        if (!applied.ok)
+        {
+            return fail(applied.error, file.getSize());
+        }
+
+        if (applied.changed + applied.added + applied.removed > 0 && !file.saveChanges())
+        {
+            return fail("Could not be saved", file.getSize());
+        }
+
+        Batch::FileResult result;
+        result.ok = true;
+        result.bytes = file.getSize();
+        result.message = std::to_string(applied.changed) + " entries changed, " + std::to_string(applied.added) +
+                         " added, " + std::to_string(applied.removed) + " removed";
+        if (applied.alreadyApplied > 0)
+        {
+            result.message += ", " + std::to_string(applied.alreadyApplied) + " already applied";
+        }
+        return result;
+    }
+}
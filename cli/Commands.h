@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Batch.h"
+#include "TableIO.h"
+
+// What each ytx-cli command does to a single file
+namespace Commands
+{
+    struct Options
+    {
+        // Folder where the tables are written and read, next to each .ytx file when empty
+        std::string outputFolder;
+        TableIO::Format format = TableIO::Format::TSV;
+        // Folder holding the versions the diff command compares each file to, matched by file name
+        std::string baseFolder;
+        // String the search command looks for, as UTF-16 big endian
+        std::vector<std::byte> searchQuery;
+    };
+
+    // Write every entry to a table: section ID, entry ID and string
+    Batch::FileResult extract(const std::string& path, const Options& options);
+    // Replace the strings of the entries listed in the file's table and save it
+    Batch::FileResult apply(const std::string& path, const Options& options);
+    // Count sections, entries and string bytes
+    Batch::FileResult stat(const std::string& path, const Options& options);
+    // Check the file loads, its strings are valid and it is laid out the way the editor writes it
+    Batch::FileResult verify(const std::string& path, const Options& options);
+    // List the entries whose string contains the search query: section ID, entry ID and string
+    Batch::FileResult search(const std::string& path, const Options& options);
+    // Write the patch that turns the file of the same name in the base folder into the file
+    Batch::FileResult diff(const std::string& path, const Options& options);
+    // Apply the file's patch and save it
+    Batch::FileResult patch(const std::string& path, const Options& options);
+
+    // Path of the table that goes with a .ytx file, with the extension of its format
+    std::string getTablePath(const std::string& path, const Options& options);
+    // Path of the patch that goes with a .ytx file
+    std::string getPatchPath(const std::string& path, const Options& options);
+}
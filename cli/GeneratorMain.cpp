@@ -0,0 +1,124 @@
+// Writes a synthetic .ytx file, to test and benchmark files of any size or script.
+// Usage: ytx-gen [options] <output file>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "YtxGenerator.h"
+
+namespace
+{
+    void printUsage()
+    {
+        std::printf(
+            "Usage: ytx-gen [options] <output file>\n"
+            "\n"
+            "Options:\n"
+            "  --sections <count>       Entry sections(default: 8)\n"
+            "  --entries <count>        Entries spread over the sections(default: 1000)\n"
+            "  --min-length <count>     Minimum characters per string(default: 4)\n"
+            "  --max-length <count>     Maximum characters per string(default: 64)\n"
+            "  --distribution <name>    \"uniform\" or \"exponential\" string lengths(default: uniform)\n"
+            "  --latin <percent>        Characters from U+00C0 - U+017F(default: 8)\n"
+            "  --cjk <percent>          Characters from U+4E00 - U+9FFF(default: 6)\n"
+            "  --surrogates <percent>   Characters from U+1F300 - U+1F64F, stored as surrogate pairs(default: 1)\n"
+            "  --seed <number>          Seed of the random strings(default: 1)\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    YtxGenerator::Options options;
+    std::string outputPath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (argument == "-h" || argument == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        if (argument.rfind("--", 0) != 0)
+        {
+            outputPath = argument;
+            continue;
+        }
+        if (value == nullptr)
+        {
+            std::fprintf(stderr, "Missing value for %s\n", argument.c_str());
+            return 2;
+        }
+        i++;
+
+        if (argument == "--sections")
+        {
+            options.sectionsCount = std::atoi(value);
+        }
+        else if (argument == "--entries")
+        {
+            options.entriesCount = std::strtoull(value, nullptr, 10);
+        }
+        else if (argument == "--min-length")
+        {
+            options.minLength = std::atoi(value);
+        }
+        else if (argument == "--max-length")
+        {
+            options.maxLength = std::atoi(value);
+        }
+        else if (argument == "--distribution")
+        {
+            if (std::strcmp(value, "uniform") == 0)
+            {
+                options.distribution = YtxGenerator::LengthDistribution::UNIFORM;
+            }
+            else if (std::strcmp(value, "exponential") == 0)
+            {
+                options.distribution = YtxGenerator::LengthDistribution::EXPONENTIAL;
+            }
+            else
+            {
+                std::fprintf(stderr, "Unknown distribution: %s\n", value);
+                return 2;
+            }
+        }
+        else if (argument == "--latin")
+        {
+            options.latinPercent = std::atoi(value);
+        }
+        else if (argument == "--cjk")
+        {
+            options.cjkPercent = std::atoi(value);
+        }
+        else if (argument == "--surrogates")
+        {
+            options.surrogatePercent = std::atoi(value);
+        }
+        else if (argument == "--seed")
+        {
+            options.seed = (unsigned int)std::strtoul(value, nullptr, 10);
+        }
+        else
+        {
+            std::fprintf(stderr, "Unknown option: %s\n\n", argument.c_str());
+            printUsage();
+            return 2;
+        }
+    }
+
+    if (outputPath.empty())
+    {
+        printUsage();
+        return 2;
+    }
+
+    if (!YtxGenerator::writeFile(outputPath, options))
+    {
+        std::fprintf(stderr, "Failed to write %s\n", outputPath.c_str());
+        return 1;
+    }
+    return 0;
+}
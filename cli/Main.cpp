@@ -0,0 +1,190 @@
+// Command line interface to process many .ytx files at once without the editor.
+// Usage: ytx-cli <command> [options] <files or folders...>
+
+#include <loguru.hpp>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "Batch.h"
+#include "Commands.h"
+#include "Transcoder.h"
+
+namespace
+{
+    // More jobs than this is a typo rather than a thread count
+    const unsigned long MAX_JOBS = 1024;
+
+    void printUsage()
+    {
+        std::printf(
+            "Usage: ytx-cli <command> [options] <files or folders...>\n"
+            "\n"
+            "Commands:\n"
+            "  extract  Write the strings of each file to a table(section ID, entry ID, string)\n"
+            "  apply    Replace strings with the ones in each file's table and save it\n"
+            "  stat     Show the sections, entries and string bytes of each file\n"
+            "  verify   Check each file is valid and its sections, strings and POF0 are consistent\n"
+            "  search   List the entries whose string contains the text given with --string\n"
+            "  diff     Write a patch of each file's differences from its original in --base\n"
+            "  patch    Apply each file's patch and save it\n"
+            "\n"
+            "Folders are searched recursively for .ytx files.\n"
+            "\n"
+            "Options:\n"
+            "  -b, --base <folder>    Folder with the original files the diff command compares to\n"
+            "  -f, --format <format>  Format of the tables: tsv, csv, jsonl or po(default: tsv)\n"
+            "  -j, --jobs <count>     Files processed at the same time(default: one per hardware thread)\n"
+            "  -o, --output <folder>  Folder where tables and patches are written and read(default: next to each file)\n"
+            "  -q, --quiet            Only print failures and the summary\n"
+            "  -s, --string <text>    Text the search command looks for\n"
+            "  -v <level>             Log verbosity(default: off)\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    loguru::g_stderr_verbosity = loguru::Verbosity_OFF;
+    loguru::init(argc, argv);
+
+    if (argc < 2 || std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0)
+    {
+        printUsage();
+        return argc < 2 ? 2 : 0;
+    }
+
+    std::string command = argv[1];
+    Batch::Task task;
+    Commands::Options commandOptions;
+    if (command == "extract")
+    {
+        task = [&](const std::string& path) { return Commands::extract(path, commandOptions); };
+    }
+    else if (command == "apply")
+    {
+        task = [&](const std::string& path) { return Commands::apply(path, commandOptions); };
+    }
+    else if (command == "stat")
+    {
+        task = [&](const std::string& path) { return Commands::stat(path, commandOptions); };
+    }
+    else if (command == "verify")
+    {
+        task = [&](const std::string& path) { return Commands::verify(path, commandOptions); };
+    }
+    else if (command == "search")
+    {
+        task = [&](const std::string& path) { return Commands::search(path, commandOptions); };
+    }
+    else if (command == "diff")
+    {
+        task = [&](const std::string& path) { return Commands::diff(path, commandOptions); };
+    }
+    else if (command == "patch")
+    {
+        task = [&](const std::string& path) { return Commands::patch(path, commandOptions); };
+    }
+    else
+    {
+        std::fprintf(stderr, "Unknown command: %s\n\n", command.c_str());
+        printUsage();
+        return 2;
+    }
+
+    Batch::Options batchOptions;
+    std::vector<std::string> paths;
+    std::string searchString;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((argument == "-j" || argument == "--jobs") && hasValue)
+        {
+            const char* value = argv[++i];
+            char* end = nullptr;
+            unsigned long jobs = std::isdigit((unsigned char)value[0]) ? std::strtoul(value, &end, 10) : 0;
+            if (end == nullptr || *end != '\0' || jobs == 0 || jobs > MAX_JOBS)
+            {
+                std::fprintf(stderr, "Invalid job count: %s (expected 1 to %lu)\n\n", value, MAX_JOBS);
+                printUsage();
+                return 2;
+            }
+            batchOptions.jobs = jobs;
+        }
+        else if ((argument == "-f" || argument == "--format") && hasValue)
+        {
+            std::optional<TableIO::Format> format = TableIO::parseFormat(argv[++i]);
+            if (!format)
+            {
+                std::fprintf(stderr, "Unknown format: %s\n\n", argv[i]);
+                printUsage();
+                return 2;
+            }
+            commandOptions.format = *format;
+        }
+        else if ((argument == "-b" || argument == "--base") && hasValue)
+        {
+            commandOptions.baseFolder = argv[++i];
+        }
+        else if ((argument == "-o" || argument == "--output") && hasValue)
+        {
+            commandOptions.outputFolder = argv[++i];
+        }
+        else if ((argument == "-s" || argument == "--string") && hasValue)
+        {
+            searchString = argv[++i];
+        }
+        else if (argument == "-q" || argument == "--quiet")
+        {
+            batchOptions.quiet = true;
+        }
+        else if (!argument.empty() && argument.front() == '-')
+        {
+            std::fprintf(stderr, "Unknown option: %s\n\n", argument.c_str());
+            printUsage();
+            return 2;
+        }
+        else
+        {
+            paths.push_back(argument);
+        }
+    }
+
+    if (!commandOptions.outputFolder.empty())
+    {
+        std::error_code error;
+        std::filesystem::create_directories(commandOptions.outputFolder, error);
+    }
+
+    if (command == "search")
+    {
+        // Encoded once, every file is compared against the same UTF-16 bytes
+        Transcoder::Result result = Transcoder::utf8ToUtf16Be(searchString, commandOptions.searchQuery);
+        if (commandOptions.searchQuery.empty() || !result.ok())
+        {
+            std::fprintf(stderr, "search needs a valid non-empty --string.\n");
+            return 2;
+        }
+    }
+
+    if (command == "diff" && commandOptions.baseFolder.empty())
+    {
+        std::fprintf(stderr, "diff needs the folder of the original files with --base.\n");
+        return 2;
+    }
+
+    std::vector<std::string> files = Batch::collectFiles(paths);
+    if (files.empty())
+    {
+        std::fprintf(stderr, "No .ytx files found.\n");
+        return 2;
+    }
+
+    size_t failed = Batch::run(files, task, batchOptions);
+    return failed == 0 ? 0 : 1;
+}
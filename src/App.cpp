@@ -4,7 +4,8 @@
 
 namespace App
 {
-    std::optional<YtxFile> file;
+    Workspace workspace;
+    YtxFile* file = nullptr;
 
     void run()
     {
@@ -0,0 +1,179 @@
+#include "BackupStore.h"
+#include "FileIO.h"
+#include "Utils.h"
+#include <loguru.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+namespace
+{
+    const char* BACKUP_DIRECTORY = ".ytx-backups";
+    const char* BACKUP_EXTENSION = ".backup";
+
+    // Parse "<file name>.<version>.<hash>.backup", returns false for anything else
+    bool parseBackupName(const std::string& backupName, const std::string& fileName, int& version, uint64_t& hash)
+    {
+        std::string_view rest = backupName;
+        std::string_view extension = BACKUP_EXTENSION;
+        if (rest.size() <= fileName.size() + extension.size() ||
+            rest.substr(0, fileName.size()) != fileName || rest[fileName.size()] != '.' ||
+            rest.substr(rest.size() - extension.size()) != extension)
+        {
+            return false;
+        }
+        rest = rest.substr(fileName.size() + 1, rest.size() - fileName.size() - 1 - extension.size());
+
+        size_t separator = rest.find('.');
+        if (separator == std::string_view::npos)
+        {
+            return false;
+        }
+
+        std::string_view versionText = rest.substr(0, separator);
+        std::string_view hashText = rest.substr(separator + 1);
+        std::from_chars_result versionResult = std::from_chars(versionText.data(), versionText.data() + versionText.size(), version);
+        std::from_chars_result hashResult = std::from_chars(hashText.data(), hashText.data() + hashText.size(), hash, 16);
+        return versionResult.ec == std::errc() && versionResult.ptr == versionText.data() + versionText.size() &&
+               hashResult.ec == std::errc() && hashResult.ptr == hashText.data() + hashText.size() &&
+               version >= 0;
+    }
+}
+
+BackupStore::BackupStore(int keepVersions)
+    : keepVersions(std::max(0, keepVersions))
+{
+}
+
+BackupStore::Method BackupStore::backup(const std::string& path, std::span<const std::byte> content)
+{
+    uint64_t hash = Utils::hashBytes(content);
+
+    std::vector<Backup> backups = listBackups(path);
+    for (const Backup& existing : backups)
+    {
+        if (existing.hash == hash)
+        {
+            LOG_F(INFO, "File already backed up: %s", existing.path.c_str());
+            return Method::EXISTING;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::path directory = getBackupDirectory(path);
+    std::filesystem::create_directories(directory, error);
+    if (error)
+    {
+        LOG_F(ERROR, "Failed to create backup folder: %s", directory.string().c_str());
+        return Method::NONE;
+    }
+
+    int version = backups.empty() ? 0 : backups.back().version + 1;
+    char backupName[64];
+    std::snprintf(backupName, sizeof(backupName), ".%d.%016llx", version, (unsigned long long)hash);
+    std::string fileName = std::filesystem::path(path).filename().string();
+    std::string backupPath = (directory / (fileName + backupName + BACKUP_EXTENSION)).string();
+
+    Method method = createBackup(path, content, backupPath);
+    if (method == Method::NONE)
+    {
+        LOG_F(ERROR, "Failed to back up file: %s", path.c_str());
+        return method;
+    }
+    LOG_F(INFO, "Backup created at: %s; Method: %s", backupPath.c_str(), getMethodName(method));
+
+    applyRetention(path);
+    return method;
+}
+
+BackupStore::Method BackupStore::createBackup(const std::string& path, std::span<const std::byte> content,
+                                              const std::string& backupPath)
+{
+    if (FileIO::cloneFile(path, backupPath))
+    {
+        return Method::REFLINK;
+    }
+
+    // No hard links: a file sharing its data with a backup could only be saved by rewriting it whole,
+    // a copy once per version lets small edits be patched in place
+    FileIO::AtomicFileWriter out;
+    if (!out.open(backupPath, content.size()))
+    {
+        return Method::NONE;
+    }
+    out.writeView(content);
+    return out.commit() ? Method::COPY : Method::NONE;
+}
+
+std::vector<BackupStore::Backup> BackupStore::listBackups(const std::string& path)
+{
+    std::vector<Backup> backups;
+    std::string fileName = std::filesystem::path(path).filename().string();
+
+    std::error_code error;
+    std::filesystem::directory_iterator iterator(getBackupDirectory(path), error);
+    if (error)
+    {
+        return backups;
+    }
+
+    for (const std::filesystem::directory_entry& directoryEntry : iterator)
+    {
+        Backup backup;
+        if (parseBackupName(directoryEntry.path().filename().string(), fileName, backup.version, backup.hash))
+        {
+            backup.path = directoryEntry.path().string();
+            backups.push_back(backup);
+        }
+    }
+
+    std::sort(backups.begin(), backups.end(),
+              [](const Backup& a, const Backup& b) { return a.version < b.version; });
+    return backups;
+}
+
+void BackupStore::applyRetention(const std::string& path)
+{
+    std::vector<Backup> backups = listBackups(path);
+
+    // The first version is the original file and is always kept
+    size_t removable = backups.size() > 1 ? backups.size() - 1 : 0;
+    if (removable <= (size_t)keepVersions)
+    {
+        return;
+    }
+
+    for (size_t i = 1; i <= removable - keepVersions; i++)
+    {
+        std::error_code error;
+        std::filesystem::remove(backups.at(i).path, error);
+        if (error)
+        {
+            LOG_F(WARNING, "Failed to remove old backup: %s", backups.at(i).path.c_str());
+            continue;
+        }
+        LOG_F(INFO, "Old backup removed: %s", backups.at(i).path.c_str());
+    }
+}
+
+std::string BackupStore::getBackupDirectory(const std::string& path)
+{
+    return (std::filesystem::path(path).parent_path() / BACKUP_DIRECTORY).string();
+}
+
+const char* BackupStore::getMethodName(Method method)
+{
+    switch (method)
+    {
+    case Method::EXISTING:
+        return "existing";
+    case Method::REFLINK:
+        return "reflink";
+    case Method::COPY:
+        return "copy";
+    default:
+        return "none";
+    }
+}
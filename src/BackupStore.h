@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+// Versioned backups of the files opened in the editor.
+// Backups are kept in a ".ytx-backups" folder next to each file and named
+// "<file name>.<version>.<content hash>.backup". Version 0 is the file as it was the first time
+// it was opened and is never removed, after it only the last few versions are kept.
+// A backup is only made when the content changed since the ones already stored.
+class BackupStore
+{
+public:
+    // How a backup was made
+    enum class Method
+    {
+        NONE,     // Failed
+        EXISTING, // The same content was already backed up
+        REFLINK,  // Copy on write clone, shares the data with the file until either changes
+        COPY      // Full copy
+    };
+
+    struct Backup
+    {
+        std::string path;
+        int version;
+        uint64_t hash;
+    };
+
+    const static int DEFAULT_KEEP_VERSIONS = 5;
+
+    explicit BackupStore(int keepVersions = DEFAULT_KEEP_VERSIONS);
+
+    // Back up a file whose current bytes are "content"(usually its mapping)
+    Method backup(const std::string& path, std::span<const std::byte> content);
+
+    // Backups of a file, oldest first
+    std::vector<Backup> listBackups(const std::string& path);
+
+    static std::string getBackupDirectory(const std::string& path);
+    static const char* getMethodName(Method method);
+
+private:
+    int keepVersions;
+
+    Method createBackup(const std::string& path, std::span<const std::byte> content, const std::string& backupPath);
+    // Remove the versions that are neither the first one nor among the last "keepVersions"
+    void applyRetention(const std::string& path);
+};
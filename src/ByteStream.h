@@ -0,0 +1,227 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+// Cursor based readers and writers over a fixed span of bytes.
+// Out of range accesses never touch memory: they set a sticky failure flag
+// (checked with good()) and reads return 0, similar to std::istream.
+
+namespace ByteStream
+{
+    // Load an integer stored with the given byte order
+    template <typename T, std::endian E>
+    inline T load(const std::byte* source)
+    {
+        static_assert(std::is_integral_v<T>, "Only integers can be loaded");
+        using U = std::make_unsigned_t<T>;
+
+        U value = 0;
+        if constexpr (E == std::endian::big)
+        {
+            for (size_t i = 0; i < sizeof(T); i++)
+            {
+                value = (U)(value << 8) | std::to_integer<U>(source[i]);
+            }
+        }
+        else
+        {
+            for (size_t i = sizeof(T); i > 0; i--)
+            {
+                value = (U)(value << 8) | std::to_integer<U>(source[i - 1]);
+            }
+        }
+        return (T)value;
+    }
+
+    // Store an integer with the given byte order
+    template <typename T, std::endian E>
+    inline void store(std::byte* destination, T value)
+    {
+        static_assert(std::is_integral_v<T>, "Only integers can be stored");
+        using U = std::make_unsigned_t<T>;
+
+        U bits = (U)value;
+        for (size_t i = 0; i < sizeof(T); i++)
+        {
+            size_t index = (E == std::endian::big) ? sizeof(T) - 1 - i : i;
+            destination[index] = std::byte(bits & 0xFF);
+            bits = (U)(bits >> 8);
+        }
+    }
+}
+
+class ByteReader
+{
+public:
+    explicit ByteReader(std::span<const std::byte> buffer, size_t position = 0)
+        : buffer(buffer),
+          cursor(position),
+          failed(position > buffer.size())
+    {
+    }
+
+    // Read a value at the cursor and move past it
+    template <typename T, std::endian E = std::endian::big>
+    inline T read()
+    {
+        if (!canRead(sizeof(T)))
+        {
+            failed = true;
+            return 0;
+        }
+
+        T value = ByteStream::load<T, E>(buffer.data() + cursor);
+        cursor += sizeof(T);
+        return value;
+    }
+
+    // Read a value at an absolute position without moving the cursor
+    template <typename T, std::endian E = std::endian::big>
+    inline T readAt(size_t position)
+    {
+        if (position > buffer.size() || buffer.size() - position < sizeof(T))
+        {
+            failed = true;
+            return 0;
+        }
+
+        return ByteStream::load<T, E>(buffer.data() + position);
+    }
+
+    // Get a view of the next "count" bytes and move past them
+    std::span<const std::byte> readBytes(size_t count)
+    {
+        if (!canRead(count))
+        {
+            failed = true;
+            return {};
+        }
+
+        std::span<const std::byte> result = buffer.subspan(cursor, count);
+        cursor += count;
+        return result;
+    }
+
+    void seek(size_t position)
+    {
+        if (position > buffer.size())
+        {
+            failed = true;
+            return;
+        }
+        cursor = position;
+    }
+
+    void skip(size_t count)
+    {
+        seek(cursor + count);
+    }
+
+    bool canRead(size_t count) const
+    {
+        return cursor <= buffer.size() && buffer.size() - cursor >= count;
+    }
+
+    size_t position() const { return cursor; }
+    size_t remaining() const { return buffer.size() - cursor; }
+    bool good() const { return !failed; }
+
+private:
+    std::span<const std::byte> buffer;
+    size_t cursor;
+    bool failed;
+};
+
+class ByteWriter
+{
+public:
+    explicit ByteWriter(std::span<std::byte> buffer, size_t position = 0)
+        : buffer(buffer),
+          cursor(position),
+          failed(position > buffer.size())
+    {
+    }
+
+    // Write a value at the cursor and move past it
+    template <typename T, std::endian E = std::endian::big>
+    inline void write(T value)
+    {
+        if (!canWrite(sizeof(T)))
+        {
+            failed = true;
+            return;
+        }
+
+        ByteStream::store<T, E>(buffer.data() + cursor, value);
+        cursor += sizeof(T);
+    }
+
+    // Write a value at an absolute position without moving the cursor
+    template <typename T, std::endian E = std::endian::big>
+    inline void writeAt(size_t position, T value)
+    {
+        if (position > buffer.size() || buffer.size() - position < sizeof(T))
+        {
+            failed = true;
+            return;
+        }
+
+        ByteStream::store<T, E>(buffer.data() + position, value);
+    }
+
+    void writeBytes(std::span<const std::byte> bytes)
+    {
+        if (!canWrite(bytes.size()))
+        {
+            failed = true;
+            return;
+        }
+
+        if (!bytes.empty())
+        {
+            std::memcpy(buffer.data() + cursor, bytes.data(), bytes.size());
+        }
+        cursor += bytes.size();
+    }
+
+    // Write "count" copies of the same byte
+    void fill(std::byte value, size_t count)
+    {
+        if (!canWrite(count))
+        {
+            failed = true;
+            return;
+        }
+
+        std::memset(buffer.data() + cursor, std::to_integer<int>(value), count);
+        cursor += count;
+    }
+
+    void seek(size_t position)
+    {
+        if (position > buffer.size())
+        {
+            failed = true;
+            return;
+        }
+        cursor = position;
+    }
+
+    bool canWrite(size_t count) const
+    {
+        return cursor <= buffer.size() && buffer.size() - cursor >= count;
+    }
+
+    size_t position() const { return cursor; }
+    size_t remaining() const { return buffer.size() - cursor; }
+    bool good() const { return !failed; }
+
+private:
+    std::span<std::byte> buffer;
+    size_t cursor;
+    bool failed;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+// CPU feature detection for the SIMD code paths
+
+#if defined(__x86_64__) || defined(_M_X64) || \
+    ((defined(__i386__) || defined(_M_IX86)) && (defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+// SSE2 is always available, AVX2 has to be checked at runtime
+#define CPU_X86 1
+#endif
+
+// Functions using AVX2 intrinsics are compiled for AVX2 on their own and only called after checking hasAvx2()
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CPU_TARGET_AVX2
+#endif
+
+namespace Cpu
+{
+    bool hasAvx2();
+}
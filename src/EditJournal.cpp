@@ -0,0 +1,459 @@
+#include "EditJournal.h"
+#include "BackupStore.h"
+#include "ByteStream.h"
+#include "MappedFile.h"
+#include "Utils.h"
+#include <loguru.hpp>
+#include <algorithm>
+#include <filesystem>
+
+const size_t EditJournal::MAX_STEPS;
+const int EditJournal::SYNC_INTERVAL_MS;
+
+namespace
+{
+    // "YTXJ"
+    const uint32_t MAGIC = 0x5954584A;
+    const uint32_t VERSION = 1;
+    // Magic, version, size and hash of the file the journal applies to
+    const size_t HEADER_SIZE = 24;
+    // Payload size before every change and checksum of the payload after it
+    const size_t FRAME_SIZE = 8;
+    // Kind, merge flag and amount of edits
+    const size_t CHANGE_SIZE = 6;
+    // Type, section ID, entry ID and the sizes of both strings
+    const size_t EDIT_SIZE = 17;
+
+    const char* JOURNAL_EXTENSION = ".journal";
+    const char* STALE_EXTENSION = ".old";
+
+    uint32_t getChecksum(std::span<const std::byte> payload)
+    {
+        return (uint32_t)Utils::hashBytes(payload);
+    }
+
+    std::span<const std::byte> asBytes(const std::string& _string)
+    {
+        return std::as_bytes(std::span<const char>(_string.data(), _string.size()));
+    }
+}
+
+EditJournal::~EditJournal()
+{
+    sync(true);
+}
+
+bool EditJournal::open(const std::string& filePath, std::span<const std::byte> content, std::vector<Change>& recovered)
+{
+    file.close();
+    path = getJournalPath(filePath);
+    recoveredOffsets.clear();
+    uint64_t contentHash = Utils::hashBytes(content);
+
+    std::error_code error;
+    std::filesystem::create_directories(BackupStore::getBackupDirectory(filePath), error);
+
+    // A missing or empty journal is simply created
+    MappedFile existing;
+    if (existing.open(path) && existing.size() > 0)
+    {
+        ByteReader reader(existing.bytes());
+        bool matches = reader.read<uint32_t>() == MAGIC && reader.read<uint32_t>() == VERSION &&
+                       reader.read<uint64_t>() == content.size() && reader.read<uint64_t>() == contentHash &&
+                       reader.good();
+        if (matches)
+        {
+            size_t end = decode(existing.bytes(), recovered, recoveredOffsets);
+            existing.close();
+            if (!file.open(path))
+            {
+                LOG_F(WARNING, "Failed to open journal, edits will not be recoverable: %s", path.c_str());
+                return false;
+            }
+
+            // The editor stopped while a change was being written, only the changes before it are kept
+            if (end < file.size())
+            {
+                LOG_F(WARNING, "Dropping %d bytes of the journal that were not fully written: %s",
+                      (int)(file.size() - end), path.c_str());
+                file.truncate(end);
+            }
+
+            generation++;
+            LOG_F(INFO, "Journal opened: %s; Changes to recover: %d", path.c_str(), (int)recovered.size());
+            return true;
+        }
+
+        // The file was changed by something else since the journal was written
+        existing.close();
+        std::string stalePath = path + STALE_EXTENSION;
+        LOG_F(WARNING, "Journal does not match the file, setting it aside: %s", stalePath.c_str());
+        std::filesystem::rename(path, stalePath, error);
+    }
+    existing.close();
+
+    return create(content.size(), contentHash);
+}
+
+void EditJournal::dropRecovered(size_t index)
+{
+    if (index >= recoveredOffsets.size())
+    {
+        return;
+    }
+
+    LOG_F(WARNING, "Dropping %d changes from the journal: %s", (int)(recoveredOffsets.size() - index), path.c_str());
+    if (file.isOpen())
+    {
+        file.truncate(recoveredOffsets[index]);
+        file.sync();
+    }
+    recoveredOffsets.resize(index);
+}
+
+void EditJournal::discard()
+{
+    file.close();
+    if (!path.empty())
+    {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
+    unsynced = false;
+    generation++;
+    clearHistory();
+}
+
+bool EditJournal::isOpen() const
+{
+    return file.isOpen();
+}
+
+void EditJournal::record(Change change)
+{
+    if (file.isOpen())
+    {
+        write(change);
+    }
+    replay(std::move(change));
+}
+
+void EditJournal::replay(Change change)
+{
+    switch (change.kind)
+    {
+    case ChangeKind::DO:
+        for (const std::vector<Edit>& step : redoSteps)
+        {
+            historySize -= getStepSize(step);
+        }
+        redoSteps.clear();
+
+        if (change.merge && lastWasDo && !undoSteps.empty())
+        {
+            // Typing again in an entry only keeps the string it had before the first key
+            std::vector<Edit>& step = undoSteps.back();
+            historySize -= getStepSize(step);
+            for (Edit& edit : change.edits)
+            {
+                Edit* last = step.empty() ? nullptr : &step.back();
+                if (last != nullptr && last->type == EditType::SET_STRING && edit.type == EditType::SET_STRING &&
+                    last->sectionId == edit.sectionId && last->entryId == edit.entryId)
+                {
+                    last->newString = std::move(edit.newString);
+                }
+                else
+                {
+                    step.push_back(std::move(edit));
+                }
+            }
+            historySize += getStepSize(step);
+        }
+        else
+        {
+            historySize += getStepSize(change.edits);
+            undoSteps.push_back(std::move(change.edits));
+            if (undoSteps.size() > MAX_STEPS)
+            {
+                historySize -= getStepSize(undoSteps.front());
+                undoSteps.pop_front();
+            }
+        }
+        lastWasDo = true;
+        break;
+
+    case ChangeKind::UNDO:
+        // Steps recorded before the journal was last started over are not in the history
+        if (!undoSteps.empty())
+        {
+            redoSteps.push_back(std::move(undoSteps.back()));
+            undoSteps.pop_back();
+        }
+        lastWasDo = false;
+        break;
+
+    case ChangeKind::REDO:
+        if (!redoSteps.empty())
+        {
+            undoSteps.push_back(std::move(redoSteps.back()));
+            redoSteps.pop_back();
+        }
+        lastWasDo = false;
+        break;
+    }
+}
+
+const std::vector<EditJournal::Edit>* EditJournal::getUndoStep() const
+{
+    return undoSteps.empty() ? nullptr : &undoSteps.back();
+}
+
+const std::vector<EditJournal::Edit>* EditJournal::getRedoStep() const
+{
+    return redoSteps.empty() ? nullptr : &redoSteps.back();
+}
+
+EditJournal::Change EditJournal::invert(const std::vector<Edit>& edits, ChangeKind kind)
+{
+    Change change{kind, false, {}};
+    change.edits.reserve(edits.size());
+    for (auto edit = edits.rbegin(); edit != edits.rend(); edit++)
+    {
+        EditType type = edit->type;
+        if (type == EditType::ADD)
+        {
+            type = EditType::REMOVE;
+        }
+        else if (type == EditType::REMOVE)
+        {
+            type = EditType::ADD;
+        }
+        change.edits.push_back(Edit{type, edit->sectionId, edit->entryId, edit->newString, edit->oldString});
+    }
+    return change;
+}
+
+void EditJournal::clearHistory()
+{
+    undoSteps.clear();
+    redoSteps.clear();
+    lastWasDo = false;
+    historySize = 0;
+}
+
+void EditJournal::sync(bool force)
+{
+    if (!unsynced || !file.isOpen())
+    {
+        return;
+    }
+    if (!force && std::chrono::steady_clock::now() - firstUnsynced < std::chrono::milliseconds(SYNC_INTERVAL_MS))
+    {
+        return;
+    }
+
+    if (!file.sync())
+    {
+        LOG_F(WARNING, "Failed to sync journal: %s", path.c_str());
+    }
+    unsynced = false;
+}
+
+EditJournal::Position EditJournal::getPosition() const
+{
+    return Position{generation, file.isOpen() ? file.size() : 0};
+}
+
+void EditJournal::checkpoint(Position position, uint64_t contentSize, uint64_t contentHash)
+{
+    if (!file.isOpen())
+    {
+        return;
+    }
+    if (position.generation != generation || position.offset > file.size())
+    {
+        LOG_F(WARNING, "Journal was started over since the file was saved, keeping it: %s", path.c_str());
+        return;
+    }
+
+    // Changes made while the file was being saved still have to be replayed on the saved file
+    uint64_t end = file.size();
+    file.close();
+    std::vector<std::byte> changes;
+    {
+        MappedFile current;
+        if (!current.open(path) || current.size() < end)
+        {
+            LOG_F(WARNING, "Failed to read journal, keeping it: %s", path.c_str());
+            file.open(path);
+            return;
+        }
+        std::span<const std::byte> bytes = current.bytes().subspan(position.offset, end - position.offset);
+        changes.assign(bytes.begin(), bytes.end());
+    }
+
+    create(contentSize, contentHash, changes);
+}
+
+std::string EditJournal::getJournalPath(const std::string& filePath)
+{
+    std::filesystem::path directory = BackupStore::getBackupDirectory(filePath);
+    return (directory / (std::filesystem::path(filePath).filename().string() + JOURNAL_EXTENSION)).string();
+}
+
+size_t EditJournal::getMemoryUsage() const
+{
+    return sizeof(EditJournal) + historySize + buffer.capacity() + recoveredOffsets.capacity() * sizeof(uint64_t);
+}
+
+bool EditJournal::create(uint64_t contentSize, uint64_t contentHash, std::span<const std::byte> changes)
+{
+    file.close();
+
+    std::byte header[HEADER_SIZE];
+    ByteWriter writer(header);
+    writer.write<uint32_t>(MAGIC);
+    writer.write<uint32_t>(VERSION);
+    writer.write<uint64_t>(contentSize);
+    writer.write<uint64_t>(contentHash);
+
+    // Replaced in one go, so a journal is never left without its header
+    FileIO::AtomicFileWriter out;
+    bool created = out.open(path, HEADER_SIZE + changes.size());
+    if (created)
+    {
+        out.write(header);
+        out.write(changes);
+        created = out.commit();
+    }
+
+    if (!created || !file.open(path))
+    {
+        LOG_F(WARNING, "Failed to create journal, edits will not be recoverable: %s", path.c_str());
+        file.close();
+        return false;
+    }
+
+    generation++;
+    unsynced = false;
+    return true;
+}
+
+bool EditJournal::write(const Change& change)
+{
+    encode(change);
+
+    uint64_t previousSize = file.size();
+    if (!file.append(buffer))
+    {
+        // The changes written before stay recoverable, the ones after would not apply without this one
+        LOG_F(WARNING, "Failed to write to journal, edits are no longer recorded: %s", path.c_str());
+        file.truncate(previousSize);
+        file.sync();
+        file.close();
+        return false;
+    }
+
+    if (!unsynced)
+    {
+        unsynced = true;
+        firstUnsynced = std::chrono::steady_clock::now();
+    }
+    sync();
+    return true;
+}
+
+void EditJournal::encode(const Change& change)
+{
+    size_t payloadSize = CHANGE_SIZE;
+    for (const Edit& edit : change.edits)
+    {
+        payloadSize += EDIT_SIZE + edit.oldString.size() + edit.newString.size();
+    }
+    buffer.resize(payloadSize + FRAME_SIZE);
+
+    ByteWriter writer(buffer);
+    writer.write<uint32_t>((uint32_t)payloadSize);
+    writer.write<uint8_t>((uint8_t)change.kind);
+    writer.write<uint8_t>(change.merge ? 1 : 0);
+    writer.write<uint32_t>((uint32_t)change.edits.size());
+    for (const Edit& edit : change.edits)
+    {
+        writer.write<uint8_t>((uint8_t)edit.type);
+        writer.write<int32_t>(edit.sectionId);
+        writer.write<int32_t>(edit.entryId);
+        writer.write<uint32_t>((uint32_t)edit.oldString.size());
+        writer.writeBytes(asBytes(edit.oldString));
+        writer.write<uint32_t>((uint32_t)edit.newString.size());
+        writer.writeBytes(asBytes(edit.newString));
+    }
+    writer.write<uint32_t>(getChecksum(std::span<const std::byte>(buffer).subspan(4, payloadSize)));
+}
+
+size_t EditJournal::decode(std::span<const std::byte> bytes, std::vector<Change>& changes, std::vector<uint64_t>& offsets)
+{
+    size_t position = HEADER_SIZE;
+    while (bytes.size() - position >= FRAME_SIZE)
+    {
+        ByteReader frame(bytes, position);
+        uint32_t payloadSize = frame.read<uint32_t>();
+        std::span<const std::byte> payload = frame.readBytes(payloadSize);
+        uint32_t checksum = frame.read<uint32_t>();
+        if (!frame.good() || checksum != getChecksum(payload))
+        {
+            break;
+        }
+
+        ByteReader reader(payload);
+        Change change;
+        uint8_t kind = reader.read<uint8_t>();
+        change.kind = (ChangeKind)kind;
+        change.merge = reader.read<uint8_t>() != 0;
+        uint32_t editsCount = reader.read<uint32_t>();
+        bool valid = kind <= (uint8_t)ChangeKind::REDO && editsCount <= payload.size() / EDIT_SIZE;
+        if (valid)
+        {
+            change.edits.reserve(editsCount);
+        }
+
+        for (uint32_t i = 0; valid && i < editsCount; i++)
+        {
+            Edit edit;
+            uint8_t type = reader.read<uint8_t>();
+            edit.type = (EditType)type;
+            edit.sectionId = reader.read<int32_t>();
+            edit.entryId = reader.read<int32_t>();
+            std::span<const std::byte> oldString = reader.readBytes(reader.read<uint32_t>());
+            std::span<const std::byte> newString = reader.readBytes(reader.read<uint32_t>());
+            edit.oldString.assign(reinterpret_cast<const char*>(oldString.data()), oldString.size());
+            edit.newString.assign(reinterpret_cast<const char*>(newString.data()), newString.size());
+            valid = reader.good() && type >= (uint8_t)EditType::SET_STRING && type <= (uint8_t)EditType::REMOVE;
+            change.edits.push_back(std::move(edit));
+        }
+
+        if (!valid || !reader.good() || reader.remaining() != 0)
+        {
+            break;
+        }
+
+        offsets.push_back(position);
+        changes.push_back(std::move(change));
+        position = frame.position();
+    }
+    return position;
+}
+
+size_t EditJournal::getEditSize(const Edit& edit)
+{
+    return sizeof(Edit) + edit.oldString.size() + edit.newString.size();
+}
+
+size_t EditJournal::getStepSize(const std::vector<Edit>& step)
+{
+    size_t size = sizeof(step);
+    for (const Edit& edit : step)
+    {
+        size += getEditSize(edit);
+    }
+    return size;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <string>
+#include <vector>
+#include "FileIO.h"
+
+// Edits made to a file, kept as the steps undo and redo walk through and appended to a journal in the
+// backup folder of the file as they are made.
+// Each change is written to the journal as soon as it is recorded, so it survives the editor crashing,
+// and the journal is synced to the disk at most once every SYNC_INTERVAL_MS so typing never waits for it.
+// The journal starts with the size and hash of the file it applies to: when the same file is opened
+// again its changes are replayed, recovering the edits that were not saved. Saving starts it over.
+class EditJournal
+{
+public:
+    enum class EditType : uint8_t
+    {
+        SET_STRING = 1,
+        ADD = 2,
+        REMOVE = 3
+    };
+
+    struct Edit
+    {
+        EditType type;
+        int sectionId;
+        int entryId;
+        // Empty for an entry that does not exist before or after the edit
+        std::string oldString;
+        std::string newString;
+    };
+
+    // What a change did to the history
+    enum class ChangeKind : uint8_t
+    {
+        DO = 0,
+        UNDO = 1,
+        REDO = 2
+    };
+
+    // Edits applied together, in the order they were applied
+    struct Change
+    {
+        ChangeKind kind;
+        // Typing in the same entry again, the edit joins the last step
+        bool merge = false;
+        std::vector<Edit> edits;
+    };
+
+    // Where the journal was when a snapshot of the file was taken
+    struct Position
+    {
+        uint64_t generation = 0;
+        uint64_t offset = 0;
+    };
+
+    // Steps older than this can no longer be undone
+    const static size_t MAX_STEPS = 1000;
+    // Longest time a change waits to be synced to the disk
+    const static int SYNC_INTERVAL_MS = 1000;
+
+    EditJournal() = default;
+    // Syncs the journal, it is kept for the next time the file is opened
+    ~EditJournal();
+
+    EditJournal(const EditJournal&) = delete;
+    EditJournal& operator=(const EditJournal&) = delete;
+
+    // Open the journal of the file at "filePath" whose bytes are "content"
+    // The changes recorded for the same content are stored in "recovered" to be replayed, the journal
+    // of another version of the file is set aside. Returns false if the journal can't be written,
+    // the history is then only kept in memory
+    bool open(const std::string& filePath, std::span<const std::byte> content, std::vector<Change>& recovered);
+    // Drop the recovered changes from "index" on, when one of them could not be replayed
+    void dropRecovered(size_t index);
+    // Remove the journal and forget the history, the changes of the file are discarded
+    void discard();
+    bool isOpen() const;
+
+    // Write a change that was applied to the file and add it to the history
+    void record(Change change);
+    // Add a recovered change to the history without writing it again
+    void replay(Change change);
+
+    // Step undo() would revert and redo() would apply again, nullptr if there is none
+    const std::vector<Edit>* getUndoStep() const;
+    const std::vector<Edit>* getRedoStep() const;
+    // Edits that revert "edits", in the order they must be applied
+    static Change invert(const std::vector<Edit>& edits, ChangeKind kind);
+    void clearHistory();
+
+    // Sync the changes written if the oldest of them waited SYNC_INTERVAL_MS, or right away if "force"
+    void sync(bool force = false);
+    Position getPosition() const;
+    // Start the journal over from a saved version of the file, keeping the changes recorded
+    // since "position". Ignored if the journal was started over since "position" was taken
+    void checkpoint(Position position, uint64_t contentSize, uint64_t contentHash);
+
+    static std::string getJournalPath(const std::string& filePath);
+    // Bytes allocated by the history
+    size_t getMemoryUsage() const;
+
+private:
+    std::string path;
+    FileIO::AppendFile file;
+    // Incremented every time the journal starts over
+    uint64_t generation = 0;
+    // Offset of every recovered change, to drop them
+    std::vector<uint64_t> recoveredOffsets;
+
+    bool unsynced = false;
+    std::chrono::steady_clock::time_point firstUnsynced;
+
+    std::deque<std::vector<Edit>> undoSteps;
+    std::vector<std::vector<Edit>> redoSteps;
+    // Only typing right after a new edit is merged into it
+    bool lastWasDo = false;
+    size_t historySize = 0;
+
+    // Encoded change, reused by every write
+    std::vector<std::byte> buffer;
+
+    // Start a new journal for content of the given size and hash, followed by encoded "changes"
+    bool create(uint64_t contentSize, uint64_t contentHash, std::span<const std::byte> changes = {});
+    bool write(const Change& change);
+    void encode(const Change& change);
+    // Read the changes of a journal after its header, storing where each of them starts in "offsets"
+    // Returns where the part that could be read ends
+    static size_t decode(std::span<const std::byte> bytes, std::vector<Change>& changes, std::vector<uint64_t>& offsets);
+
+    static size_t getEditSize(const Edit& edit);
+    static size_t getStepSize(const std::vector<Edit>& step);
+};
@@ -0,0 +1,198 @@
+#include "EntryFilter.h"
+#include <bit>
+#include <charconv>
+#include <utility>
+#include "StringArena.h"
+#include "Transcoder.h"
+#include "Utils.h"
+
+namespace EntryFilter
+{
+    namespace
+    {
+        size_t find(std::string_view _string, std::string_view filter, bool ignoreCase)
+        {
+            return ignoreCase ? Utils::findIgnoreCaseAscii(_string, filter) : _string.find(filter);
+        }
+
+        // Parse up to 8 hex digits, nothing else
+        bool parseHex(std::string_view text, uint32_t& value)
+        {
+            if (text.empty() || text.size() > 8)
+            {
+                return false;
+            }
+            auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, 16);
+            return error == std::errc() && end == text.data() + text.size();
+        }
+
+        bool matchesNumber(uint32_t value, const Filter& filter)
+        {
+            if (!filter.valid)
+            {
+                return false;
+            }
+
+            if (filter.isRange)
+            {
+                return value >= filter.low && value <= filter.high;
+            }
+
+            // Drop the digits after the prefix, the hex digits of a value never start with 0
+            int digits = value == 0 ? 1 : (std::bit_width(value) + 3) / 4;
+            return digits >= filter.prefixDigits && (value >> (4 * (digits - filter.prefixDigits))) == filter.prefix;
+        }
+    }
+
+    Filter makeFilter(Field field, std::string_view text, bool ignoreCase)
+    {
+        Filter filter;
+        filter.field = field;
+        filter.text = text;
+        filter.ignoreCase = ignoreCase;
+        if (field == Field::STRING || text.empty())
+        {
+            return filter;
+        }
+
+        size_t separator = text.find('-');
+        if (separator == std::string_view::npos)
+        {
+            filter.valid = parseHex(text, filter.prefix);
+            filter.prefixDigits = (int)text.size();
+            return filter;
+        }
+
+        std::string_view low = text.substr(0, separator);
+        std::string_view high = text.substr(separator + 1);
+        filter.isRange = true;
+        filter.valid = (low.empty() || parseHex(low, filter.low)) && (high.empty() || parseHex(high, filter.high));
+        if (filter.low > filter.high)
+        {
+            std::swap(filter.low, filter.high);
+        }
+        return filter;
+    }
+
+    bool narrows(const Filter& narrower, const Filter& wider)
+    {
+        if (narrower.field != wider.field || narrower.ignoreCase != wider.ignoreCase)
+        {
+            return false;
+        }
+
+        if (narrower.field == Field::STRING)
+        {
+            // Strings containing the new filter also contain any part of it
+            return find(narrower.text, wider.text, narrower.ignoreCase) != std::string::npos;
+        }
+
+        // Adding digits to a prefix only drops values
+        return !narrower.isRange && !wider.isRange && narrower.text.starts_with(wider.text);
+    }
+
+    bool matches(EntryStore& entries, size_t row, const Filter& filter)
+    {
+        if (filter.text.size() == 0)
+        {
+            return true;
+        }
+
+        switch (filter.field)
+        {
+        case Field::ID:
+            return matchesNumber((uint32_t)entries.getId(row), filter);
+
+        case Field::STRING:
+            return find(entries.getString(row), filter.text, filter.ignoreCase) != std::string::npos;
+
+        case Field::ADDRESS:
+            return matchesNumber((uint32_t)entries.getStringAddress(row), filter);
+        }
+        return false;
+    }
+
+    bool matches(EntryStore& entries, size_t row, Field field, std::string_view filter, bool ignoreCase)
+    {
+        return matches(entries, row, makeFilter(field, filter, ignoreCase));
+    }
+
+    bool Candidates::contains(uint32_t searchId) const
+    {
+        // Strings added after the index or arena was built were not searched
+        return !useIndex || searchId >= documents.size() || documents[searchId];
+    }
+
+    bool Candidates::isExact(uint32_t searchId) const
+    {
+        return useIndex && searchId < exactCount;
+    }
+
+    void findCandidates(YtxFile& file, Field field, std::string_view filter, Candidates& result, bool ignoreCase)
+    {
+        result.useIndex = false;
+        result.exactCount = 0;
+        if (field != Field::STRING || filter.empty())
+        {
+            return;
+        }
+
+        const TrigramIndex* index = file.getSearchIndex();
+        if (index != nullptr && !ignoreCase)
+        {
+            std::u16string query;
+            // Invalid strings are indexed as they are in the file but replaced when decoded,
+            // so filters with replacement characters can not use the index
+            result.useIndex = Transcoder::utf8ToUtf16(filter, query).ok() &&
+                              query.find(u'\uFFFD') == std::u16string::npos &&
+                              index->findCandidates(query, result.documents);
+            if (result.useIndex)
+            {
+                return;
+            }
+        }
+
+        const StringArena* arena = file.getStringArena();
+        if (arena != nullptr)
+        {
+            arena->find(filter, ignoreCase, result.documents);
+            result.exactCount = result.documents.size();
+            result.useIndex = true;
+        }
+    }
+
+    void filterEntries(YtxFile& file, std::optional<int> sectionId,
+                       Field field, std::string_view filter, std::vector<Match>& result,
+                       bool ignoreCase)
+    {
+        result.clear();
+
+        Candidates candidates;
+        findCandidates(file, field, filter, candidates, ignoreCase);
+        Filter prepared = makeFilter(field, filter, ignoreCase);
+
+        for (EntrySection& section : file.entrySections)
+        {
+            if (sectionId && section.id != *sectionId)
+            {
+                continue;
+            }
+
+            EntryStore& entries = section.entries;
+            for (size_t row = 0; row < entries.size(); row++)
+            {
+                uint32_t searchId = entries.getSearchId(row);
+                if (candidates.contains(searchId) &&
+                    (candidates.isExact(searchId) || matches(entries, row, prepared)))
+                {
+                    result.push_back({&section, entries.getHandle(row)});
+                }
+            }
+
+            if (sectionId)
+            {
+                break;
+            }
+        }
+    }
+}
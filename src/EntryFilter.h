@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "YtxFile.h"
+
+// Filtering of entries by ID, string or address, as done by the editor's filter box
+namespace EntryFilter
+{
+    // Same order as the options of the filter box
+    enum class Field
+    {
+        ID,
+        STRING,
+        ADDRESS
+    };
+
+    // Entries are referred to by handle, which stays valid while other entries are added or removed
+    struct Match
+    {
+        EntrySection* section;
+        EntryStore::Handle handle;
+    };
+
+    // Filter prepared once to check many entries
+    // String filters match the strings containing them, "ignoreCase" only ignores the case of ASCII letters
+    // ID and address filters are hex numbers: "1f" matches the values whose hex digits start with 1f
+    // and "100-1ff" the values from 0x100 to 0x1ff, either bound of a range can be left out
+    struct Filter
+    {
+        Field field = Field::STRING;
+        std::string_view text;
+        bool ignoreCase = false;
+
+        // ID and address filters that are not hex numbers match nothing
+        bool valid = true;
+        bool isRange = false;
+        uint32_t low = 0;
+        uint32_t high = UINT32_MAX;
+        uint32_t prefix = 0;
+        int prefixDigits = 0;
+    };
+
+    // "text" must outlive the filter
+    Filter makeFilter(Field field, std::string_view text, bool ignoreCase = false);
+    // Whether every entry matching "narrower" also matches "wider"
+    bool narrows(const Filter& narrower, const Filter& wider);
+
+    // Whether the entry at "row" matches the filter. Empty filters match everything
+    bool matches(EntryStore& entries, size_t row, const Filter& filter);
+    bool matches(EntryStore& entries, size_t row, Field field, std::string_view filter, bool ignoreCase = false);
+
+    // Entries that can match a filter according to the search index or the string arena of the file
+    struct Candidates
+    {
+        // Every entry can match when neither could be used
+        bool useIndex = false;
+        // Indexed by the search ID of the entries
+        std::vector<uint8_t> documents;
+        // Documents below this were searched in full by the string arena, they match if set in "documents"
+        size_t exactCount = 0;
+
+        bool contains(uint32_t searchId) const;
+        // Whether the entry is known to match without checking it again
+        bool isExact(uint32_t searchId) const;
+    };
+
+    // Find the entries worth checking for "filter", only string filters use the index and arena:
+    // the index for case sensitive filters of 3 or more characters, the arena for the others
+    void findCandidates(YtxFile& file, Field field, std::string_view filter, Candidates& result,
+                        bool ignoreCase = false);
+
+    // Replace "result" with the entries of the given section(every section if std::nullopt)
+    // that match the filter, in file order
+    // String filters only check the candidates of the search index of the file when it was built
+    void filterEntries(YtxFile& file, std::optional<int> sectionId,
+                       Field field, std::string_view filter, std::vector<Match>& result,
+                       bool ignoreCase = false);
+}
@@ -0,0 +1,383 @@
+#include "EntryStore.h"
+#include "Transcoder.h"
+#include <loguru.hpp>
+#include <algorithm>
+
+const uint32_t EntryStore::NO_ROW;
+const uint32_t EntryStore::NO_SEARCH_ID;
+const size_t EntryStore::BLOCK_SIZE;
+
+void EntryStore::clear()
+{
+    ids.clear();
+    stringAddresses.clear();
+    stringSizes.clear();
+    slotSizes.clear();
+    stringOffsets.clear();
+    stringLengths.clear();
+    flags.clear();
+    searchIds.clear();
+    handles.clear();
+    handleRows.clear();
+    blocks.clear();
+    sealed = false;
+    arenaSize = 0;
+    arenaUsed = 0;
+}
+
+void EntryStore::reserve(size_t count)
+{
+    ids.reserve(count);
+    stringAddresses.reserve(count);
+    stringSizes.reserve(count);
+    slotSizes.reserve(count);
+    stringOffsets.reserve(count);
+    stringLengths.reserve(count);
+    flags.reserve(count);
+    searchIds.reserve(count);
+    handles.reserve(count);
+    handleRows.reserve(count);
+}
+
+void EntryStore::setSource(std::span<const std::byte> _source)
+{
+    source = _source;
+}
+
+EntryStore::Handle EntryStore::addRaw(int id, int stringAddress, uint32_t offset, uint32_t byteSize, int stringSize)
+{
+    Handle handle = addRow(id, stringAddress, stringSize);
+    stringOffsets.push_back(offset);
+    stringLengths.push_back(byteSize);
+    flags.push_back(0);
+    return handle;
+}
+
+EntryStore::Handle EntryStore::add(int id, std::string_view _string, int stringSize)
+{
+    Handle handle = addRow(id, 0, stringSize);
+    stringOffsets.push_back(0);
+    stringLengths.push_back(0);
+    flags.push_back(DECODED);
+    storeString(ids.size() - 1, _string);
+    return handle;
+}
+
+EntryStore::Handle EntryStore::addRow(int id, int stringAddress, int stringSize)
+{
+    Handle handle = (Handle)handleRows.size();
+    handleRows.push_back((uint32_t)ids.size());
+    handles.push_back(handle);
+
+    ids.push_back(id);
+    stringAddresses.push_back(stringAddress);
+    stringSizes.push_back(stringSize);
+    slotSizes.push_back(stringSize);
+    searchIds.push_back(NO_SEARCH_ID);
+    return handle;
+}
+
+void EntryStore::remove(const std::vector<uint8_t>& removed)
+{
+    // Rows that stay are moved down over the removed ones, column by column
+    size_t kept = 0;
+    for (size_t row = 0; row < ids.size(); row++)
+    {
+        if (row < removed.size() && removed[row])
+        {
+            handleRows[handles[row]] = NO_ROW;
+            if (flags[row] & DECODED)
+            {
+                arenaUsed -= stringLengths[row];
+            }
+            continue;
+        }
+
+        if (kept != row)
+        {
+            ids[kept] = ids[row];
+            stringAddresses[kept] = stringAddresses[row];
+            stringSizes[kept] = stringSizes[row];
+            slotSizes[kept] = slotSizes[row];
+            stringOffsets[kept] = stringOffsets[row];
+            stringLengths[kept] = stringLengths[row];
+            flags[kept] = flags[row];
+            searchIds[kept] = searchIds[row];
+            handles[kept] = handles[row];
+            handleRows[handles[kept]] = (uint32_t)kept;
+        }
+        kept++;
+    }
+
+    ids.resize(kept);
+    stringAddresses.resize(kept);
+    stringSizes.resize(kept);
+    slotSizes.resize(kept);
+    stringOffsets.resize(kept);
+    stringLengths.resize(kept);
+    flags.resize(kept);
+    searchIds.resize(kept);
+    handles.resize(kept);
+    compactIfNeeded();
+}
+
+void EntryStore::removeRow(size_t row)
+{
+    handleRows[handles[row]] = NO_ROW;
+    if (flags[row] & DECODED)
+    {
+        arenaUsed -= stringLengths[row];
+    }
+
+    ids.erase(ids.begin() + row);
+    stringAddresses.erase(stringAddresses.begin() + row);
+    stringSizes.erase(stringSizes.begin() + row);
+    slotSizes.erase(slotSizes.begin() + row);
+    stringOffsets.erase(stringOffsets.begin() + row);
+    stringLengths.erase(stringLengths.begin() + row);
+    flags.erase(flags.begin() + row);
+    searchIds.erase(searchIds.begin() + row);
+    handles.erase(handles.begin() + row);
+    for (size_t moved = row; moved < handles.size(); moved++)
+    {
+        handleRows[handles[moved]] = (uint32_t)moved;
+    }
+    compactIfNeeded();
+}
+
+uint32_t EntryStore::getRow(Handle handle) const
+{
+    return handle < handleRows.size() ? handleRows[handle] : NO_ROW;
+}
+
+const std::vector<int>& EntryStore::getIds() const
+{
+    return ids;
+}
+
+void EntryStore::setStringAddress(size_t row, int stringAddress)
+{
+    stringAddresses[row] = stringAddress;
+}
+
+int EntryStore::getStringSize(size_t row) const
+{
+    return stringSizes[row];
+}
+
+int EntryStore::getSlotSize(size_t row) const
+{
+    return slotSizes[row];
+}
+
+void EntryStore::setSlotSize(size_t row, int slotSize)
+{
+    slotSizes[row] = slotSize;
+}
+
+bool EntryStore::isDirty(size_t row) const
+{
+    return flags[row] & DIRTY;
+}
+
+void EntryStore::setSearchId(size_t row, uint32_t searchId)
+{
+    searchIds[row] = searchId;
+}
+
+bool EntryStore::isDecoded(size_t row) const
+{
+    return flags[row] & DECODED;
+}
+
+std::span<const std::byte> EntryStore::getRawString(size_t row) const
+{
+    if (flags[row] & DECODED)
+    {
+        return {};
+    }
+    return source.subspan(stringOffsets[row], stringLengths[row]);
+}
+
+void EntryStore::setRawOffset(size_t row, uint32_t offset)
+{
+    stringOffsets[row] = offset;
+}
+
+std::string_view EntryStore::getString(size_t row)
+{
+    if (!(flags[row] & DECODED))
+    {
+        // Room for the longest UTF-8 the code units can turn into, so the block never grows
+        std::span<const std::byte> rawString = getRawString(row);
+        uint64_t offset;
+        std::string& block = getBlock(rawString.size() / 2 * 3, offset);
+        size_t start = block.size();
+
+        Transcoder::Result result = Transcoder::utf16BeToUtf8(rawString, block);
+        if (!result.ok())
+        {
+            LOG_F(WARNING, "Invalid string in entry %x: %s at character %d",
+                  ids[row], Transcoder::getErrorName(result.error), (int)result.position);
+        }
+
+        stringOffsets[row] = offset;
+        stringLengths[row] = (uint32_t)(block.size() - start);
+        flags[row] |= DECODED;
+        arenaSize += stringLengths[row];
+        arenaUsed += stringLengths[row];
+    }
+
+    const std::string& block = *blocks[stringOffsets[row] >> 32];
+    return std::string_view(block.data() + (uint32_t)stringOffsets[row], stringLengths[row]);
+}
+
+void EntryStore::setString(size_t row, std::string_view _string, int stringSize)
+{
+    if (flags[row] & DECODED)
+    {
+        arenaUsed -= stringLengths[row];
+    }
+
+    // Strings are appended, the space of the previous one is only reclaimed by compact()
+    storeString(row, _string);
+    stringSizes[row] = stringSize;
+    flags[row] = (flags[row] | DECODED | DIRTY) & ~SAVING;
+    compactIfNeeded();
+}
+
+EntryStore EntryStore::snapshot()
+{
+    for (uint8_t& flag : flags)
+    {
+        if (flag & DIRTY)
+        {
+            flag |= SAVING;
+        }
+    }
+
+    return share();
+}
+
+EntryStore EntryStore::share()
+{
+    // Neither copy appends to the blocks they share from now on
+    sealed = true;
+    return *this;
+}
+
+bool EntryStore::finishSave(const EntryStore& saved, bool success, bool rewritten)
+{
+    if (success)
+    {
+        for (size_t savedRow = 0; savedRow < saved.size(); savedRow++)
+        {
+            uint32_t row = getRow(saved.handles[savedRow]);
+            if (row == NO_ROW)
+            {
+                continue;
+            }
+
+            if (flags[row] & SAVING)
+            {
+                flags[row] &= ~DIRTY;
+            }
+
+            // Patched strings keep their slot, a full rewrite gives each string a slot of its own size
+            if (rewritten)
+            {
+                stringAddresses[row] = saved.stringAddresses[savedRow];
+                slotSizes[row] = saved.stringSizes[savedRow];
+            }
+        }
+    }
+
+    bool changed = false;
+    for (uint8_t& flag : flags)
+    {
+        flag &= ~SAVING;
+        changed = changed || (flag & DIRTY);
+    }
+    return changed;
+}
+
+size_t EntryStore::getArenaUsed() const
+{
+    return arenaUsed;
+}
+
+size_t EntryStore::getArenaSize() const
+{
+    return arenaSize;
+}
+
+size_t EntryStore::getMemoryUsage() const
+{
+    size_t usage = ids.capacity() * sizeof(int) +
+                   stringAddresses.capacity() * sizeof(int) +
+                   stringSizes.capacity() * sizeof(int) +
+                   slotSizes.capacity() * sizeof(int) +
+                   stringOffsets.capacity() * sizeof(uint64_t) +
+                   stringLengths.capacity() * sizeof(uint32_t) +
+                   flags.capacity() +
+                   searchIds.capacity() * sizeof(uint32_t) +
+                   handles.capacity() * sizeof(Handle) +
+                   handleRows.capacity() * sizeof(uint32_t);
+    for (const std::shared_ptr<std::string>& block : blocks)
+    {
+        usage += block->capacity();
+    }
+    return usage;
+}
+
+std::string& EntryStore::getBlock(size_t size, uint64_t& offset)
+{
+    if (blocks.empty() || sealed || blocks.back()->capacity() - blocks.back()->size() < size)
+    {
+        blocks.push_back(std::make_shared<std::string>());
+        blocks.back()->reserve(std::max(BLOCK_SIZE, size));
+        sealed = false;
+    }
+
+    std::string& block = *blocks.back();
+    offset = ((uint64_t)(blocks.size() - 1) << 32) | block.size();
+    return block;
+}
+
+void EntryStore::storeString(size_t row, std::string_view _string)
+{
+    uint64_t offset;
+    getBlock(_string.size(), offset).append(_string);
+
+    stringOffsets[row] = offset;
+    stringLengths[row] = (uint32_t)_string.size();
+    arenaSize += _string.size();
+    arenaUsed += _string.size();
+}
+
+void EntryStore::compactIfNeeded()
+{
+    size_t unused = arenaSize - arenaUsed;
+    if (unused >= COMPACT_SIZE && unused > arenaUsed)
+    {
+        compact();
+    }
+}
+
+void EntryStore::compact()
+{
+    std::vector<std::shared_ptr<std::string>> previous = std::move(blocks);
+    blocks.clear();
+    sealed = false;
+    arenaSize = 0;
+    arenaUsed = 0;
+
+    for (size_t row = 0; row < ids.size(); row++)
+    {
+        if (flags[row] & DECODED)
+        {
+            const std::string& block = *previous[stringOffsets[row] >> 32];
+            storeString(row, std::string_view(block.data() + (uint32_t)stringOffsets[row], stringLengths[row]));
+        }
+    }
+}
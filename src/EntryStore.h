@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Entries of a section stored by column: IDs, addresses, sizes and string offsets each have an array
+// of their own, so a scan over one of them reads memory in order and an entry allocates nothing.
+// Strings stay UTF-16 in the file until they are first read, their UTF-8 is then appended to an arena
+// of large blocks. Edited strings are appended too, and the arena is compacted once most of it holds
+// strings that were replaced.
+// Rows move when entries are removed, handles keep pointing to the same entry until it is removed.
+// Copies share the blocks of the arena, which are never written again once a snapshot was taken.
+class EntryStore
+{
+public:
+    using Handle = uint32_t;
+
+    // Returned by getRow() for handles of entries that were removed
+    const static uint32_t NO_ROW = UINT32_MAX;
+    // Search ID of entries that are not in a search index
+    const static uint32_t NO_SEARCH_ID = UINT32_MAX;
+
+    // Handles given before are no longer valid
+    void clear();
+    void reserve(size_t count);
+
+    // Bytes the strings that were not decoded point into, usually the mapped file
+    void setSource(std::span<const std::byte> source);
+
+    // Add an entry whose string is "byteSize" bytes of UTF-16 big endian at "offset" in the source
+    Handle addRaw(int id, int stringAddress, uint32_t offset, uint32_t byteSize, int stringSize);
+    // Add an entry with a UTF-8 string, "stringSize" is the size the string takes in the file
+    Handle add(int id, std::string_view _string, int stringSize);
+    // Remove the rows set to 1 in "removed", the other rows keep their order
+    void remove(const std::vector<uint8_t>& removed);
+    // Remove a single row, only the rows after it move
+    void removeRow(size_t row);
+
+    // Getters read by every scan are defined here so they can be inlined
+    size_t size() const { return ids.size(); }
+    // Current row of an entry, NO_ROW if it was removed
+    uint32_t getRow(Handle handle) const;
+    Handle getHandle(size_t row) const { return handles[row]; }
+
+    const std::vector<int>& getIds() const;
+    int getId(size_t row) const { return ids[row]; }
+    // Address of the string in the file - 0x20
+    int getStringAddress(size_t row) const { return stringAddresses[row]; }
+    void setStringAddress(size_t row, int stringAddress);
+    // Bytes the string takes in the file: UTF-16 code units, null terminator and padding
+    int getStringSize(size_t row) const;
+    // Bytes available for the string at its current address in the file on disk
+    int getSlotSize(size_t row) const;
+    void setSlotSize(size_t row, int slotSize);
+    // The string was changed since the file was last saved
+    bool isDirty(size_t row) const;
+    // Document of the string in the search index of the file
+    uint32_t getSearchId(size_t row) const { return searchIds[row]; }
+    void setSearchId(size_t row, uint32_t searchId);
+
+    bool isDecoded(size_t row) const;
+    // UTF-16 big endian bytes of a string that was not decoded, without the null terminator
+    std::span<const std::byte> getRawString(size_t row) const;
+    // Point a string that was not decoded to where it is in a new source
+    void setRawOffset(size_t row, uint32_t offset);
+
+    // Get the string as UTF-8, decoding it on first use
+    // The view stays valid until a string is changed or removed, or the store is cleared
+    std::string_view getString(size_t row);
+    // Replace the string and mark it as changed, "stringSize" is the size it takes in the file
+    void setString(size_t row, std::string_view _string, int stringSize);
+
+    // Copy of the store to save from on another thread, sharing the blocks of the arena
+    // Strings changed afterwards go to new blocks and are not marked as saved by finishSave()
+    EntryStore snapshot();
+    // Copy of the store to read from on another thread, sharing the blocks of the arena like snapshot()
+    // but leaving the changed strings as they are
+    EntryStore share();
+    // Merge a saved snapshot back: the rows whose string did not change since it was taken are no longer
+    // changed, and if the file was "rewritten" every row of the snapshot gets the address and slot
+    // the snapshot was written with. Rows removed since are skipped
+    // Returns whether strings were changed and not saved
+    bool finishSave(const EntryStore& saved, bool success, bool rewritten);
+
+    // Bytes of the arena used by the current strings and in total
+    size_t getArenaUsed() const;
+    size_t getArenaSize() const;
+    // Bytes allocated by the columns and the arena
+    size_t getMemoryUsage() const;
+
+private:
+    // Size of the blocks of the arena, longer strings get a block of their own
+    const static size_t BLOCK_SIZE = 64 * 1024;
+    // The arena is not compacted while the replaced strings take less than this
+    const static size_t COMPACT_SIZE = 1024 * 1024;
+
+    // Bits of "flags"
+    enum Flag : uint8_t
+    {
+        DECODED = 1,
+        DIRTY = 2,
+        // Changed, and not changed again since the last snapshot
+        SAVING = 4
+    };
+
+    std::vector<int> ids;
+    std::vector<int> stringAddresses;
+    std::vector<int> stringSizes;
+    std::vector<int> slotSizes;
+    // Offset in the source for strings that were not decoded, block << 32 | position in the arena otherwise
+    std::vector<uint64_t> stringOffsets;
+    // In bytes, UTF-16 for strings that were not decoded and UTF-8 otherwise
+    std::vector<uint32_t> stringLengths;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> searchIds;
+    std::vector<Handle> handles;
+    // Row of every handle given, NO_ROW once its entry is removed
+    std::vector<uint32_t> handleRows;
+
+    std::span<const std::byte> source;
+
+    // Blocks are reserved up front and never grow past it, so their bytes never move
+    std::vector<std::shared_ptr<std::string>> blocks;
+    // The last block is shared with a snapshot, new strings go to a new block
+    bool sealed = false;
+    size_t arenaSize = 0;
+    size_t arenaUsed = 0;
+
+    Handle addRow(int id, int stringAddress, int stringSize);
+    // Block with room for "size" more bytes, where they start is stored in "offset"
+    std::string& getBlock(size_t size, uint64_t& offset);
+    // Copy a UTF-8 string to the arena and point the row to it
+    void storeString(size_t row, std::string_view _string);
+    // Drop the strings that were replaced once they take most of the arena
+    void compactIfNeeded();
+    void compact();
+};
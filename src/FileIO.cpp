@@ -0,0 +1,746 @@
+#include "FileIO.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#elif defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+#endif
+
+namespace FileIO
+{
+    // Size of the buffer small writes are gathered in
+    const size_t STAGING_SIZE = 256 * 1024;
+    // Maximum amount of pieces sent in a single writev call(IOV_MAX is at least 1024 on supported systems)
+    const size_t MAX_SEGMENTS = 512;
+    // Names tried for a temporary file before giving up, only left over files of a crashed process can be in the way
+    const int MAX_TEMP_ATTEMPTS = 16;
+
+    // Temporary files are named after the process and a counter, so writers of the same target never share one
+    std::atomic<uint64_t> tempCounter = 0;
+
+    std::string makeTempPath(const std::string& path)
+    {
+#ifdef _WIN32
+        unsigned long processId = GetCurrentProcessId();
+#else
+        unsigned long processId = (unsigned long)getpid();
+#endif
+        return path + "." + std::to_string(processId) + "." + std::to_string(tempCounter++) + ".tmp";
+    }
+
+#ifdef _WIN32
+    bool patchFile(const std::string& path, std::span<const Patch> patches)
+    {
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        bool success = true;
+        for (const Patch& patch : patches)
+        {
+            uint64_t offset = patch.offset;
+            std::span<const std::byte> remaining = patch.bytes;
+            while (success && !remaining.empty())
+            {
+                OVERLAPPED overlapped = {};
+                overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+                overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+                DWORD written = 0;
+                DWORD toWrite = (DWORD)std::min<size_t>(remaining.size(), 0x40000000);
+                if (!WriteFile(file, remaining.data(), toWrite, &written, &overlapped) || written == 0)
+                {
+                    success = false;
+                    break;
+                }
+                offset += written;
+                remaining = remaining.subspan(written);
+            }
+        }
+
+        success = FlushFileBuffers(file) != 0 && success;
+        CloseHandle(file);
+        return success;
+    }
+#else
+    bool patchFile(const std::string& path, std::span<const Patch> patches)
+    {
+        int file = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (file < 0)
+        {
+            return false;
+        }
+
+        bool success = true;
+        for (const Patch& patch : patches)
+        {
+            off_t offset = (off_t)patch.offset;
+            std::span<const std::byte> remaining = patch.bytes;
+            while (success && !remaining.empty())
+            {
+                ssize_t written = pwrite(file, remaining.data(), remaining.size(), offset);
+                if (written < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (written <= 0)
+                {
+                    success = false;
+                    break;
+                }
+                offset += written;
+                remaining = remaining.subspan(written);
+            }
+        }
+
+        // Only the data has to reach the disk, the file size did not change
+#ifdef __APPLE__
+        success = fsync(file) == 0 && success;
+#else
+        success = fdatasync(file) == 0 && success;
+#endif
+        ::close(file);
+        return success;
+    }
+#endif
+
+#ifdef _WIN32
+    bool cloneFile(const std::string& source, const std::string& destination)
+    {
+        // Block cloning is only available on ReFS volumes, plain copies are used instead
+        return false;
+    }
+
+    int getLinkCount(const std::string& path)
+    {
+        HANDLE file = CreateFileA(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return 0;
+        }
+
+        BY_HANDLE_FILE_INFORMATION information;
+        int count = GetFileInformationByHandle(file, &information) ? (int)information.nNumberOfLinks : 0;
+        CloseHandle(file);
+        return count;
+    }
+#else
+    bool cloneFile(const std::string& source, const std::string& destination)
+    {
+#if defined(__linux__) && defined(FICLONE)
+        int sourceFile = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+        if (sourceFile < 0)
+        {
+            return false;
+        }
+
+        struct stat sourceStat;
+        mode_t mode = (fstat(sourceFile, &sourceStat) == 0) ? (sourceStat.st_mode & 07777) : 0644;
+        int destinationFile = ::open(destination.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+        if (destinationFile < 0)
+        {
+            ::close(sourceFile);
+            return false;
+        }
+
+        bool cloned = ioctl(destinationFile, FICLONE, sourceFile) == 0;
+        ::close(destinationFile);
+        ::close(sourceFile);
+        if (!cloned)
+        {
+            unlink(destination.c_str());
+        }
+        return cloned;
+#elif defined(__APPLE__)
+        return clonefile(source.c_str(), destination.c_str(), 0) == 0;
+#else
+        return false;
+#endif
+    }
+
+    int getLinkCount(const std::string& path)
+    {
+        struct stat fileStat;
+        if (stat(path.c_str(), &fileStat) != 0)
+        {
+            return 0;
+        }
+        return (int)fileStat.st_nlink;
+    }
+#endif
+
+    AtomicFileWriter::AtomicFileWriter()
+        : expectedSize(0),
+          stagingUsed(0),
+          written(0),
+          pending(0),
+          failed(false),
+          opened(false),
+#ifdef _WIN32
+          fileHandle(INVALID_HANDLE_VALUE)
+#else
+          fileDescriptor(-1)
+#endif
+    {
+    }
+
+    AtomicFileWriter::~AtomicFileWriter()
+    {
+        abort();
+    }
+
+    bool AtomicFileWriter::open(const std::string& path, uint64_t size)
+    {
+        abort();
+
+        targetPath = path;
+
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        for (int attempt = 0; attempt < MAX_TEMP_ATTEMPTS && file == INVALID_HANDLE_VALUE; attempt++)
+        {
+            tempPath = makeTempPath(path);
+            file = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE && GetLastError() != ERROR_FILE_EXISTS)
+            {
+                return false;
+            }
+        }
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        fileHandle = file;
+
+        // Reserve the space up front so a full disk is found before anything is written
+        FILE_ALLOCATION_INFO allocation = {};
+        allocation.AllocationSize.QuadPart = (LONGLONG)size;
+        if (!SetFileInformationByHandle(file, FileAllocationInfo, &allocation, sizeof(allocation)) &&
+            GetLastError() == ERROR_DISK_FULL)
+        {
+            closeFile();
+            DeleteFileA(tempPath.c_str());
+            return false;
+        }
+#else
+        // The new file keeps the permissions of the one it replaces
+        mode_t mode = 0644;
+        struct stat targetStat;
+        if (stat(path.c_str(), &targetStat) == 0)
+        {
+            mode = targetStat.st_mode & 07777;
+        }
+
+        int file = -1;
+        for (int attempt = 0; attempt < MAX_TEMP_ATTEMPTS && file < 0; attempt++)
+        {
+            tempPath = makeTempPath(path);
+            file = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+            if (file < 0 && errno != EEXIST)
+            {
+                return false;
+            }
+        }
+        if (file < 0)
+        {
+            return false;
+        }
+        fileDescriptor = file;
+        fchmod(file, mode);
+
+#ifdef __linux__
+        // Reserve the space up front so a full disk is found before anything is written.
+        // File systems without fallocate support are simply written without it
+        if (size > 0 && fallocate(file, 0, 0, (off_t)size) != 0 && (errno == ENOSPC || errno == EFBIG))
+        {
+            closeFile();
+            unlink(tempPath.c_str());
+            return false;
+        }
+#endif
+#endif
+
+        expectedSize = size;
+        staging.resize(STAGING_SIZE);
+        stagingUsed = 0;
+        segments.clear();
+        segments.reserve(MAX_SEGMENTS);
+        written = 0;
+        pending = 0;
+        failed = false;
+        opened = true;
+        return true;
+    }
+
+    void AtomicFileWriter::write(std::span<const std::byte> bytes)
+    {
+        if (!opened)
+        {
+            failed = true;
+            return;
+        }
+
+        while (!bytes.empty() && !failed)
+        {
+            if (stagingUsed == staging.size() || segments.size() == MAX_SEGMENTS)
+            {
+                flush();
+                continue;
+            }
+
+            size_t count = std::min(bytes.size(), staging.size() - stagingUsed);
+            std::byte* destination = staging.data() + stagingUsed;
+            std::memcpy(destination, bytes.data(), count);
+            stagingUsed += count;
+            addSegment(destination, count);
+
+            bytes = bytes.subspan(count);
+        }
+    }
+
+    void AtomicFileWriter::writeView(std::span<const std::byte> bytes)
+    {
+        if (!opened)
+        {
+            failed = true;
+            return;
+        }
+        if (bytes.empty())
+        {
+            return;
+        }
+
+        if (segments.size() == MAX_SEGMENTS)
+        {
+            flush();
+        }
+        addSegment(bytes.data(), bytes.size());
+    }
+
+    void AtomicFileWriter::fill(std::byte value, size_t count)
+    {
+        if (!opened)
+        {
+            failed = true;
+            return;
+        }
+
+        while (count > 0 && !failed)
+        {
+            if (stagingUsed == staging.size() || segments.size() == MAX_SEGMENTS)
+            {
+                flush();
+                continue;
+            }
+
+            size_t fillCount = std::min(count, staging.size() - stagingUsed);
+            std::byte* destination = staging.data() + stagingUsed;
+            std::memset(destination, std::to_integer<int>(value), fillCount);
+            stagingUsed += fillCount;
+            addSegment(destination, fillCount);
+
+            count -= fillCount;
+        }
+    }
+
+    bool replaceFile(const std::string& source, const std::string& destination)
+    {
+#ifdef _WIN32
+        return MoveFileExA(source.c_str(), destination.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        if (rename(source.c_str(), destination.c_str()) != 0)
+        {
+            return false;
+        }
+
+        // The rename itself is only durable once the directory is synced
+        std::string directory = std::filesystem::path(destination).parent_path().string();
+        int directoryDescriptor = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directoryDescriptor >= 0)
+        {
+            fsync(directoryDescriptor);
+            ::close(directoryDescriptor);
+        }
+        return true;
+#endif
+    }
+
+    bool AtomicFileWriter::commit()
+    {
+        if (!finish())
+        {
+            return false;
+        }
+
+        if (!replaceFile(tempPath, targetPath))
+        {
+            std::error_code error;
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+        return true;
+    }
+
+    bool AtomicFileWriter::finish()
+    {
+        if (!opened)
+        {
+            return false;
+        }
+
+        flush();
+        if (failed || written != expectedSize)
+        {
+            abort();
+            return false;
+        }
+
+#ifdef _WIN32
+        bool synced = FlushFileBuffers(fileHandle) != 0;
+#else
+        bool synced = fsync(fileDescriptor) == 0;
+#endif
+        closeFile();
+        opened = false;
+        if (!synced)
+        {
+            std::error_code error;
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+        return true;
+    }
+
+    void AtomicFileWriter::abort()
+    {
+        if (!opened)
+        {
+            return;
+        }
+
+        closeFile();
+#ifdef _WIN32
+        DeleteFileA(tempPath.c_str());
+#else
+        unlink(tempPath.c_str());
+#endif
+
+        segments.clear();
+        stagingUsed = 0;
+        pending = 0;
+        opened = false;
+    }
+
+    void AtomicFileWriter::addSegment(const std::byte* data, size_t size)
+    {
+        pending += size;
+
+        // Consecutive copies to the staging buffer are sent as one piece
+        if (!segments.empty() && segments.back().data + segments.back().size == data)
+        {
+            segments.back().size += size;
+            return;
+        }
+        segments.push_back({data, size});
+    }
+
+    bool AtomicFileWriter::flush()
+    {
+        if (failed)
+        {
+            return false;
+        }
+
+#ifdef _WIN32
+        for (const Segment& segment : segments)
+        {
+            const std::byte* data = segment.data;
+            size_t remaining = segment.size;
+            while (remaining > 0)
+            {
+                DWORD chunkWritten = 0;
+                DWORD toWrite = (DWORD)std::min<size_t>(remaining, 0x40000000);
+                if (!WriteFile(fileHandle, data, toWrite, &chunkWritten, nullptr) || chunkWritten == 0)
+                {
+                    failed = true;
+                    return false;
+                }
+                data += chunkWritten;
+                remaining -= chunkWritten;
+                written += chunkWritten;
+            }
+        }
+#else
+        std::vector<iovec> vectors(segments.size());
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            vectors[i].iov_base = const_cast<std::byte*>(segments[i].data);
+            vectors[i].iov_len = segments[i].size;
+        }
+
+        size_t index = 0;
+        while (index < vectors.size())
+        {
+            ssize_t result = writev(fileDescriptor, vectors.data() + index, (int)(vectors.size() - index));
+            if (result < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (result <= 0)
+            {
+                failed = true;
+                return false;
+            }
+            written += result;
+
+            // Skip what was fully written and resume a partially written piece where it stopped
+            size_t advance = (size_t)result;
+            while (index < vectors.size() && advance >= vectors[index].iov_len)
+            {
+                advance -= vectors[index].iov_len;
+                index++;
+            }
+            if (index < vectors.size())
+            {
+                vectors[index].iov_base = static_cast<std::byte*>(vectors[index].iov_base) + advance;
+                vectors[index].iov_len -= advance;
+            }
+        }
+#endif
+
+        segments.clear();
+        stagingUsed = 0;
+        pending = 0;
+        return true;
+    }
+
+    void AtomicFileWriter::closeFile()
+    {
+#ifdef _WIN32
+        if (fileHandle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(fileHandle);
+        }
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (fileDescriptor >= 0)
+        {
+            ::close(fileDescriptor);
+        }
+        fileDescriptor = -1;
+#endif
+    }
+
+#ifdef _WIN32
+    AppendFile::AppendFile()
+        : length(0),
+          fileHandle(INVALID_HANDLE_VALUE)
+    {
+    }
+#else
+    AppendFile::AppendFile()
+        : length(0),
+          fileDescriptor(-1)
+    {
+    }
+#endif
+
+    AppendFile::~AppendFile()
+    {
+        close();
+    }
+
+#ifdef _WIN32
+    bool AppendFile::open(const std::string& path)
+    {
+        close();
+
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize))
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        fileHandle = file;
+        length = (uint64_t)fileSize.QuadPart;
+        return true;
+    }
+
+    void AppendFile::close()
+    {
+        if (fileHandle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(fileHandle);
+        }
+        fileHandle = INVALID_HANDLE_VALUE;
+        length = 0;
+    }
+
+    bool AppendFile::isOpen() const
+    {
+        return fileHandle != INVALID_HANDLE_VALUE;
+    }
+
+    bool AppendFile::append(std::span<const std::byte> bytes)
+    {
+        if (!isOpen())
+        {
+            return false;
+        }
+
+        while (!bytes.empty())
+        {
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = (DWORD)(length & 0xFFFFFFFF);
+            overlapped.OffsetHigh = (DWORD)(length >> 32);
+
+            DWORD written = 0;
+            DWORD toWrite = (DWORD)std::min<size_t>(bytes.size(), 0x40000000);
+            if (!WriteFile(fileHandle, bytes.data(), toWrite, &written, &overlapped) || written == 0)
+            {
+                return false;
+            }
+            length += written;
+            bytes = bytes.subspan(written);
+        }
+        return true;
+    }
+
+    bool AppendFile::sync()
+    {
+        return isOpen() && FlushFileBuffers(fileHandle) != 0;
+    }
+
+    bool AppendFile::truncate(uint64_t size)
+    {
+        if (!isOpen())
+        {
+            return false;
+        }
+
+        FILE_END_OF_FILE_INFO endOfFile = {};
+        endOfFile.EndOfFile.QuadPart = (LONGLONG)size;
+        if (!SetFileInformationByHandle(fileHandle, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile)))
+        {
+            return false;
+        }
+        length = size;
+        return true;
+    }
+#else
+    bool AppendFile::open(const std::string& path)
+    {
+        close();
+
+        int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (file < 0)
+        {
+            return false;
+        }
+
+        struct stat fileStat;
+        if (fstat(file, &fileStat) != 0)
+        {
+            ::close(file);
+            return false;
+        }
+
+        fileDescriptor = file;
+        length = (uint64_t)fileStat.st_size;
+        return true;
+    }
+
+    void AppendFile::close()
+    {
+        if (fileDescriptor >= 0)
+        {
+            ::close(fileDescriptor);
+        }
+        fileDescriptor = -1;
+        length = 0;
+    }
+
+    bool AppendFile::isOpen() const
+    {
+        return fileDescriptor >= 0;
+    }
+
+    bool AppendFile::append(std::span<const std::byte> bytes)
+    {
+        if (!isOpen())
+        {
+            return false;
+        }
+
+        // Written at the known end rather than with O_APPEND, so a truncate() is followed exactly
+        while (!bytes.empty())
+        {
+            ssize_t written = pwrite(fileDescriptor, bytes.data(), bytes.size(), (off_t)length);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                return false;
+            }
+            length += written;
+            bytes = bytes.subspan(written);
+        }
+        return true;
+    }
+
+    bool AppendFile::sync()
+    {
+        if (!isOpen())
+        {
+            return false;
+        }
+
+        // The size changes with every append, which fdatasync also syncs
+#ifdef __APPLE__
+        return fsync(fileDescriptor) == 0;
+#else
+        return fdatasync(fileDescriptor) == 0;
+#endif
+    }
+
+    bool AppendFile::truncate(uint64_t size)
+    {
+        if (!isOpen() || ftruncate(fileDescriptor, (off_t)size) != 0)
+        {
+            return false;
+        }
+        length = size;
+        return true;
+    }
+#endif
+}
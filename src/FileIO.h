@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+// Low level file writes that the standard streams do not offer
+namespace FileIO
+{
+    // Bytes to be written at a given offset of a file
+    struct Patch
+    {
+        uint64_t offset;
+        std::span<const std::byte> bytes;
+    };
+
+    // Write every patch at its offset of an existing file, leaving the rest of it untouched.
+    // The file is neither created nor truncated. Returns false if any write fails
+    bool patchFile(const std::string& path, std::span<const Patch> patches);
+
+    // Create "destination" as a copy on write clone of "source"(FICLONE on Linux, clonefile on macOS).
+    // Fails if the file system can't share data between files or "destination" already exists
+    bool cloneFile(const std::string& source, const std::string& destination);
+    // Number of hard links to a file, 0 if it can't be read
+    int getLinkCount(const std::string& path);
+    // Move "source" over "destination" in a single step that survives a crash. Returns false, leaving both files
+    // as they were, if it could not be moved. Windows refuses to replace a file while a view of it is mapped
+    bool replaceFile(const std::string& source, const std::string& destination);
+
+    // Writes a new version of a file to a temporary file next to it, which replaces the original
+    // only once everything was written and synced. The original is never left half written.
+    // Writes are gathered and sent with writev, failures are sticky and checked with good()
+    class AtomicFileWriter
+    {
+    public:
+        AtomicFileWriter();
+        ~AtomicFileWriter();
+
+        AtomicFileWriter(const AtomicFileWriter&) = delete;
+        AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+        // Create the temporary file for "path" with room for exactly "size" bytes
+        bool open(const std::string& path, uint64_t size);
+
+        // Copy bytes to the output
+        void write(std::span<const std::byte> bytes);
+        // Write bytes without copying them, they must stay valid until commit()
+        void writeView(std::span<const std::byte> bytes);
+        // Write "count" copies of the same byte
+        void fill(std::byte value, size_t count);
+
+        // Write what is left, sync it and replace the original file.
+        // Fails if the amount written is not the size given to open()
+        bool commit();
+        // Same as commit(), but the synced file is left at getTempPath() for replaceFile() to move over
+        // the original later, once nothing maps it. It is removed if it could not be written
+        bool finish();
+        const std::string& getTempPath() const { return tempPath; }
+        // Remove the temporary file, leaving the original untouched
+        void abort();
+
+        uint64_t position() const { return written + pending; }
+        bool good() const { return !failed; }
+
+    private:
+        struct Segment
+        {
+            const std::byte* data;
+            size_t size;
+        };
+
+        std::string targetPath;
+        std::string tempPath;
+        uint64_t expectedSize;
+
+        // Small writes are copied here and sent together with the views between them
+        std::vector<std::byte> staging;
+        size_t stagingUsed;
+        std::vector<Segment> segments;
+
+        uint64_t written;
+        uint64_t pending;
+        bool failed;
+        bool opened;
+
+#ifdef _WIN32
+        void* fileHandle;
+#else
+        int fileDescriptor;
+#endif
+
+        void addSegment(const std::byte* data, size_t size);
+        bool flush();
+        void closeFile();
+    };
+
+    // File that is only ever added to, for logs of changes that must survive a crash.
+    // Appended bytes reach the system right away, sync() makes them durable and is left to the caller
+    // so many small appends can share one
+    class AppendFile
+    {
+    public:
+        AppendFile();
+        ~AppendFile();
+
+        AppendFile(const AppendFile&) = delete;
+        AppendFile& operator=(const AppendFile&) = delete;
+
+        // Open "path" for appending, creating it if needed, the bytes already in it are kept
+        bool open(const std::string& path);
+        void close();
+        bool isOpen() const;
+
+        // Returns false if not every byte could be written
+        bool append(std::span<const std::byte> bytes);
+        // Wait until everything appended is on the disk
+        bool sync();
+        // Drop everything past "size", appends continue from there
+        bool truncate(uint64_t size);
+        uint64_t size() const { return length; }
+
+    private:
+        uint64_t length;
+
+#ifdef _WIN32
+        void* fileHandle;
+#else
+        int fileDescriptor;
+#endif
+    };
+}
@@ -0,0 +1,75 @@
+#include "FileLoader.h"
+#include "Workspace.h"
+
+FileLoader::~FileLoader()
+{
+    cancel();
+    delete loadedFile.exchange(nullptr);
+}
+
+void FileLoader::start(const std::string& _path)
+{
+    cancel();
+    delete loadedFile.exchange(nullptr);
+    failed = false;
+
+    // The previous thread was joined, nothing else reads the progress while it is reset
+    path = _path;
+    stopSource = std::stop_source();
+    progress.stage = YtxFile::LoadStage::MAPPING;
+    progress.done = 0;
+    progress.total = 0;
+    progress.stopToken = stopSource.get_token();
+
+    loading = true;
+    thread = std::thread(&FileLoader::run, this);
+}
+
+void FileLoader::cancel()
+{
+    stopSource.request_stop();
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+bool FileLoader::isLoading()
+{
+    return loading;
+}
+
+std::unique_ptr<YtxFile> FileLoader::takeFile()
+{
+    return std::unique_ptr<YtxFile>(loadedFile.exchange(nullptr, std::memory_order_acquire));
+}
+
+bool FileLoader::takeFailure()
+{
+    return failed.exchange(false);
+}
+
+const YtxFile::LoadProgress& FileLoader::getProgress()
+{
+    return progress;
+}
+
+const std::string& FileLoader::getPath()
+{
+    return path;
+}
+
+void FileLoader::run()
+{
+    std::unique_ptr<YtxFile> file = Workspace::loadFile(path, &progress);
+    if (file)
+    {
+        // Everything the thread wrote to the file is visible to whoever takes the pointer
+        loadedFile.store(file.release(), std::memory_order_release);
+    }
+    else if (!progress.stopToken.stop_requested())
+    {
+        failed = true;
+    }
+    loading = false;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include "YtxFile.h"
+
+// Loads a file on a thread of its own, with progress that can be shown while it runs.
+// The file is only handed over once it is fully built, through a single pointer swap, so the
+// thread drawing the UI never sees a file that is half loaded.
+class FileLoader
+{
+public:
+    FileLoader() = default;
+    // Stops the load running
+    ~FileLoader();
+
+    FileLoader(const FileLoader&) = delete;
+    FileLoader& operator=(const FileLoader&) = delete;
+
+    // Load "path", stopping the load running and dropping a file that was not taken
+    void start(const std::string& path);
+    // Stop the load running and wait for its thread
+    void cancel();
+    bool isLoading();
+
+    // Take the loaded file, nullptr if none finished loading since the last call
+    std::unique_ptr<YtxFile> takeFile();
+    // Whether a load failed since the last call, stopped loads don't count
+    bool takeFailure();
+
+    const YtxFile::LoadProgress& getProgress();
+    // Path of the file being loaded, or last loaded
+    const std::string& getPath();
+
+private:
+    std::thread thread;
+    std::stop_source stopSource;
+    std::string path;
+
+    YtxFile::LoadProgress progress;
+    std::atomic<bool> loading = false;
+    std::atomic<bool> failed = false;
+    // Owned by the loader until takeFile() swaps it out
+    std::atomic<YtxFile*> loadedFile = nullptr;
+
+    void run();
+};
@@ -0,0 +1,224 @@
+#include "FilterWorker.h"
+#include <algorithm>
+
+FilterWorker::FilterWorker()
+{
+    thread = std::thread(&FilterWorker::workerLoop, this);
+}
+
+FilterWorker::~FilterWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+        stopQuery();
+    }
+    queryAvailable.notify_one();
+    thread.join();
+}
+
+void FilterWorker::submit(Query _query)
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopQuery();
+        query = std::move(_query);
+        hasPendingQuery = true;
+    }
+    queryAvailable.notify_one();
+}
+
+void FilterWorker::invalidate()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        generation++;
+        hasReadyResults = false;
+        if (!query)
+        {
+            return;
+        }
+
+        stopQuery();
+        hasPendingQuery = true;
+    }
+    queryAvailable.notify_one();
+}
+
+void FilterWorker::cancel()
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    generation++;
+    stopQuery();
+    query.reset();
+    hasPendingQuery = false;
+    hasReadyResults = false;
+    readyResults.clear();
+}
+
+bool FilterWorker::takeResults(std::vector<EntryFilter::Match>& result)
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (!hasReadyResults)
+    {
+        return false;
+    }
+
+    result.swap(readyResults);
+    hasReadyResults = false;
+    return true;
+}
+
+bool FilterWorker::isBusy()
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return hasPendingQuery || running;
+}
+
+std::unique_lock<std::mutex> FilterWorker::lockEntries()
+{
+    return std::unique_lock<std::mutex>(entriesMutex);
+}
+
+void FilterWorker::stopQuery()
+{
+    stopSource.request_stop();
+    stopSource = std::stop_source();
+}
+
+void FilterWorker::workerLoop()
+{
+    std::vector<EntryFilter::Match> result;
+    while (true)
+    {
+        Query current;
+        std::stop_token stopToken;
+        uint64_t queryGeneration;
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            queryAvailable.wait(lock, [this] { return stopping || hasPendingQuery; });
+            if (stopping)
+            {
+                return;
+            }
+
+            current = *query;
+            hasPendingQuery = false;
+            running = true;
+            stopToken = stopSource.get_token();
+            queryGeneration = generation;
+        }
+
+        bool refine = canRefine(current, queryGeneration);
+        bool finished = runQuery(current, refine, stopToken, result);
+
+        std::lock_guard<std::mutex> lock(stateMutex);
+        running = false;
+        if (finished && !stopToken.stop_requested())
+        {
+            readyResults.assign(result.begin(), result.end());
+            hasReadyResults = true;
+
+            lastQuery = std::move(current);
+            lastGeneration = queryGeneration;
+            hasLastResults = true;
+            lastResults.swap(result);
+        }
+    }
+}
+
+bool FilterWorker::canRefine(const Query& _query, uint64_t queryGeneration)
+{
+    return hasLastResults &&
+           lastGeneration == queryGeneration &&
+           lastQuery.file == _query.file &&
+           lastQuery.sectionId == _query.sectionId &&
+           EntryFilter::narrows(EntryFilter::makeFilter(_query.field, _query.filter, _query.ignoreCase),
+                                EntryFilter::makeFilter(lastQuery.field, lastQuery.filter, lastQuery.ignoreCase));
+}
+
+bool FilterWorker::runQuery(const Query& _query, bool refine, std::stop_token stopToken,
+                            std::vector<EntryFilter::Match>& result)
+{
+    result.clear();
+    EntryFilter::Filter filter = EntryFilter::makeFilter(_query.field, _query.filter, _query.ignoreCase);
+
+    if (refine)
+    {
+        for (size_t start = 0; start < lastResults.size(); start += CHUNK_SIZE)
+        {
+            std::lock_guard<std::mutex> lock(entriesMutex);
+            if (stopToken.stop_requested())
+            {
+                return false;
+            }
+
+            size_t end = std::min(lastResults.size(), start + CHUNK_SIZE);
+            for (size_t i = start; i < end; i++)
+            {
+                // Entries removed since are skipped
+                EntryStore& entries = lastResults[i].section->entries;
+                uint32_t row = entries.getRow(lastResults[i].handle);
+                if (row != EntryStore::NO_ROW && EntryFilter::matches(entries, row, filter))
+                {
+                    result.push_back(lastResults[i]);
+                }
+            }
+        }
+        return true;
+    }
+
+    EntryFilter::Candidates candidates;
+    bool hasCandidates = false;
+    size_t sectionIndex = 0;
+    size_t entryIndex = 0;
+    while (true)
+    {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+        if (stopToken.stop_requested())
+        {
+            return false;
+        }
+
+        if (!hasCandidates)
+        {
+            EntryFilter::findCandidates(*_query.file, _query.field, _query.filter, candidates, _query.ignoreCase);
+            hasCandidates = true;
+        }
+
+        std::vector<EntrySection>& sections = _query.file->entrySections;
+        size_t checked = 0;
+        while (sectionIndex < sections.size() && checked < CHUNK_SIZE)
+        {
+            EntrySection& section = sections[sectionIndex];
+            if (!_query.sectionId || section.id == *_query.sectionId)
+            {
+                EntryStore& entries = section.entries;
+                size_t end = std::min(entries.size(), entryIndex + CHUNK_SIZE - checked);
+                checked += end - entryIndex;
+                for (; entryIndex < end; entryIndex++)
+                {
+                    uint32_t searchId = entries.getSearchId(entryIndex);
+                    if (candidates.contains(searchId) &&
+                        (candidates.isExact(searchId) || EntryFilter::matches(entries, entryIndex, filter)))
+                    {
+                        result.push_back({&section, entries.getHandle(entryIndex)});
+                    }
+                }
+
+                if (entryIndex < section.entries.size())
+                {
+                    continue;
+                }
+            }
+
+            sectionIndex++;
+            entryIndex = 0;
+        }
+
+        if (sectionIndex >= sections.size())
+        {
+            return true;
+        }
+    }
+}
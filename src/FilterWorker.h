@@ -0,0 +1,86 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+#include "EntryFilter.h"
+
+// Runs the filter of the entry table on its own thread so the table keeps drawing while
+// a large file is being filtered. Every new query cancels the one running, and a query that
+// contains the previous one only checks the entries the previous one matched.
+//
+// The worker reads the entries of the file in small chunks while holding lockEntries(),
+// anything that reads or changes entries on another thread must hold it too.
+class FilterWorker
+{
+public:
+    struct Query
+    {
+        YtxFile* file = nullptr;
+        std::optional<int> sectionId;
+        EntryFilter::Field field = EntryFilter::Field::ID;
+        std::string filter;
+        bool ignoreCase = false;
+    };
+
+    FilterWorker();
+    ~FilterWorker();
+
+    FilterWorker(const FilterWorker&) = delete;
+    FilterWorker& operator=(const FilterWorker&) = delete;
+
+    // Filter the entries again with "query", cancelling the query running
+    void submit(Query query);
+    // The entries changed: run the last query again from scratch
+    // Call while holding lockEntries() right after the change
+    void invalidate();
+    // Forget the last query and its results, before the file is closed or replaced
+    void cancel();
+
+    // Swap "result" with the latest finished results, if there are new ones
+    bool takeResults(std::vector<EntryFilter::Match>& result);
+    // Whether a query is waiting or running
+    bool isBusy();
+
+    std::unique_lock<std::mutex> lockEntries();
+
+private:
+    // Entries checked for each time the entries are locked
+    const static size_t CHUNK_SIZE = 16384;
+
+    std::mutex entriesMutex;
+
+    std::mutex stateMutex;
+    std::condition_variable queryAvailable;
+    std::optional<Query> query;
+    bool hasPendingQuery = false;
+    bool running = false;
+    bool stopping = false;
+    // Stops the query running when a newer one is submitted
+    std::stop_source stopSource;
+    // Changed by invalidate() and cancel(), results of older generations can't be refined
+    uint64_t generation = 0;
+
+    // Finished results waiting for takeResults()
+    std::vector<EntryFilter::Match> readyResults;
+    bool hasReadyResults = false;
+
+    // Only used by the worker thread
+    Query lastQuery;
+    uint64_t lastGeneration = 0;
+    bool hasLastResults = false;
+    std::vector<EntryFilter::Match> lastResults;
+
+    std::thread thread;
+
+    void workerLoop();
+    // Returns false if the query was cancelled
+    bool runQuery(const Query& _query, bool refine, std::stop_token stopToken, std::vector<EntryFilter::Match>& result);
+    bool canRefine(const Query& _query, uint64_t queryGeneration);
+    void stopQuery();
+};
@@ -0,0 +1,266 @@
+#include "FolderSearch.h"
+#include "ThreadPool.h"
+#include "Transcoder.h"
+#include "Utils.h"
+#include "YtxFile.h"
+#include <loguru.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+
+const size_t FolderSearch::MAX_RESULTS;
+
+namespace
+{
+    // Strings closer than this to each other are scanned as one region, the padding between them included
+    const size_t REGION_GAP = 64;
+
+    struct RawString
+    {
+        const char* begin;
+        const char* end;
+        uint32_t row;
+    };
+
+    bool isYtxFile(const std::filesystem::path& path)
+    {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), Utils::toLowerAscii);
+        return extension == ".ytx";
+    }
+}
+
+FolderSearch::~FolderSearch()
+{
+    cancel();
+}
+
+bool FolderSearch::start(const std::string& folder, const std::string& query)
+{
+    cancel();
+
+    std::vector<std::byte> encoded;
+    Transcoder::Result result = Transcoder::utf8ToUtf16Be(query, encoded);
+    if (encoded.empty() || !result.ok())
+    {
+        LOG_F(WARNING, "Invalid search query: %s", query.c_str());
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        pendingResults.clear();
+    }
+    filesFound = 0;
+    filesSearched = 0;
+    bytesSearched = 0;
+    resultCount = 0;
+    truncated = false;
+
+    stopSource = std::stop_source();
+    running = true;
+    thread = std::thread(&FolderSearch::run, this, folder, std::move(encoded), stopSource);
+    return true;
+}
+
+void FolderSearch::cancel()
+{
+    stopSource.request_stop();
+    wait();
+}
+
+void FolderSearch::wait()
+{
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+bool FolderSearch::isRunning()
+{
+    return running;
+}
+
+void FolderSearch::takeResults(std::vector<Result>& results)
+{
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    std::move(pendingResults.begin(), pendingResults.end(), std::back_inserter(results));
+    pendingResults.clear();
+}
+
+size_t FolderSearch::getFilesFound()
+{
+    return filesFound;
+}
+
+size_t FolderSearch::getFilesSearched()
+{
+    return filesSearched;
+}
+
+uint64_t FolderSearch::getBytesSearched()
+{
+    return bytesSearched;
+}
+
+bool FolderSearch::isTruncated()
+{
+    return truncated;
+}
+
+void FolderSearch::run(std::string folder, std::vector<std::byte> query, std::stop_source stop)
+{
+    LOG_F(INFO, "Searching folder: %s", folder.c_str());
+    {
+        // Files are searched while the rest of the folder is still being walked
+        ThreadPool pool;
+        std::stop_token stopToken = stop.get_token();
+
+        std::error_code error;
+        std::filesystem::recursive_directory_iterator iterator(
+            folder, std::filesystem::directory_options::skip_permission_denied, error);
+        std::filesystem::recursive_directory_iterator end;
+        for (; !error && iterator != end && !stopToken.stop_requested(); iterator.increment(error))
+        {
+            if (!iterator->is_regular_file(error) || !isYtxFile(iterator->path()))
+            {
+                continue;
+            }
+
+            filesFound++;
+            pool.submit([this, path = iterator->path().string(), &query, &stop, stopToken] {
+                if (stopToken.stop_requested())
+                {
+                    return;
+                }
+
+                searchFile(path, query, [this, &stop](Result&& result) {
+                    addResult(std::move(result), stop);
+                }, stopToken);
+
+                std::error_code sizeError;
+                uint64_t size = std::filesystem::file_size(path, sizeError);
+                bytesSearched += sizeError ? 0 : size;
+                filesSearched++;
+            });
+        }
+
+        if (error)
+        {
+            LOG_F(WARNING, "Failed to read folder %s: %s", folder.c_str(), error.message().c_str());
+        }
+        pool.wait();
+    }
+
+    LOG_F(INFO, "Folder search finished: %zu files, %zu results%s", filesSearched.load(), resultCount.load(),
+          stop.stop_requested() ? " (stopped)" : "");
+    running = false;
+}
+
+void FolderSearch::addResult(Result&& result, std::stop_source& stop)
+{
+    if (resultCount++ >= MAX_RESULTS)
+    {
+        truncated = true;
+        stop.request_stop();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    pendingResults.push_back(std::move(result));
+}
+
+bool FolderSearch::searchFile(const std::string& path, std::span<const std::byte> query,
+                              const std::function<void(Result&&)>& onResult, std::stop_token stopToken)
+{
+    // Only the tables are parsed, strings are left where they are in the mapped file
+    YtxFile file(path);
+    file.load(false);
+    if (!file.isValid())
+    {
+        LOG_F(WARNING, "Skipping file that could not be loaded: %s", path.c_str());
+        return false;
+    }
+
+    const char* queryBegin = reinterpret_cast<const char*>(query.data());
+    const char* queryEnd = queryBegin + query.size();
+    std::boyer_moore_horspool_searcher searcher(queryBegin, queryEnd);
+
+    std::vector<RawString> strings;
+    for (EntrySection& section : file.entrySections)
+    {
+        if (stopToken.stop_requested())
+        {
+            break;
+        }
+
+        EntryStore& entries = section.entries;
+        strings.clear();
+        for (size_t row = 0; row < entries.size(); row++)
+        {
+            std::span<const std::byte> rawString = entries.getRawString(row);
+            if (rawString.size() >= query.size())
+            {
+                const char* begin = reinterpret_cast<const char*>(rawString.data());
+                strings.push_back({begin, begin + rawString.size(), (uint32_t)row});
+            }
+        }
+        std::sort(strings.begin(), strings.end(), [](const RawString& a, const RawString& b) {
+            return a.begin < b.begin;
+        });
+
+        // Strings of a section are usually next to each other in the file, so a whole run of them
+        // is scanned at once and every hit is then matched to the string it is in
+        size_t first = 0;
+        while (first < strings.size())
+        {
+            size_t last = first + 1;
+            const char* regionEnd = strings[first].end;
+            while (last < strings.size() && strings[last].begin - regionEnd <= (ptrdiff_t)REGION_GAP)
+            {
+                regionEnd = std::max(regionEnd, strings[last].end);
+                last++;
+            }
+
+            auto regionStrings = strings.begin() + first;
+            auto regionStringsEnd = strings.begin() + last;
+            const char* position = strings[first].begin;
+            while (position < regionEnd)
+            {
+                const char* hit = searcher(position, regionEnd).first;
+                if (hit == regionEnd)
+                {
+                    break;
+                }
+
+                // Strings sharing the start of the last string starting at or before the hit
+                auto shared = std::upper_bound(regionStrings, regionStringsEnd, hit,
+                                               [](const char* _hit, const RawString& s) { return _hit < s.begin; });
+                const char* sharedBegin = (shared - 1)->begin;
+                auto string = std::lower_bound(regionStrings, shared, sharedBegin,
+                                               [](const RawString& s, const char* begin) { return s.begin < begin; });
+
+                const char* next = hit + 1;
+                if ((hit - sharedBegin) % 2 == 0)
+                {
+                    for (; string != shared; string++)
+                    {
+                        if (hit + query.size() <= string->end)
+                        {
+                            Result result{file.getPath(), section.id, entries.getId(string->row), ""};
+                            Transcoder::utf16BeToUtf8(entries.getRawString(string->row), result._string);
+                            onResult(std::move(result));
+                            // Each string is reported once, however many times it contains the query
+                            next = std::max(next, string->end);
+                        }
+                    }
+                }
+                position = next;
+            }
+
+            first = last;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Searches the strings of every .ytx file in a folder and its subfolders, several files at once,
+// on threads of its own. The query is encoded to UTF-16 big endian once and compared against the
+// strings where they are in the mapped files, only the strings that match are decoded.
+// Results can be taken while the search is still running.
+class FolderSearch
+{
+public:
+    struct Result
+    {
+        std::string path;
+        int sectionId;
+        int entryId;
+        std::string _string;
+    };
+
+    // The search stops once this many results were found
+    const static size_t MAX_RESULTS = 100000;
+
+    FolderSearch() = default;
+    // Cancels the search running
+    ~FolderSearch();
+
+    FolderSearch(const FolderSearch&) = delete;
+    FolderSearch& operator=(const FolderSearch&) = delete;
+
+    // Search the files in "folder" for "query", cancelling the search running and clearing its results
+    // Returns false if the query is empty or is not valid UTF-8
+    bool start(const std::string& folder, const std::string& query);
+    void cancel();
+    // Block until the search running finishes
+    void wait();
+    bool isRunning();
+
+    // Move the results found since the last call to the end of "results"
+    void takeResults(std::vector<Result>& results);
+
+    // .ytx files found in the folder so far, and files that were searched
+    size_t getFilesFound();
+    size_t getFilesSearched();
+    // Size of the files that were searched
+    uint64_t getBytesSearched();
+    // The search stopped at MAX_RESULTS
+    bool isTruncated();
+
+    // Search the strings of one file for "query", UTF-16 big endian bytes
+    // Returns false if the file could not be loaded
+    static bool searchFile(const std::string& path, std::span<const std::byte> query,
+                           const std::function<void(Result&&)>& onResult, std::stop_token stopToken = {});
+
+private:
+    std::thread thread;
+    std::stop_source stopSource;
+    std::atomic<bool> running = false;
+
+    std::mutex resultsMutex;
+    std::vector<Result> pendingResults;
+
+    std::atomic<size_t> filesFound = 0;
+    std::atomic<size_t> filesSearched = 0;
+    std::atomic<uint64_t> bytesSearched = 0;
+    std::atomic<size_t> resultCount = 0;
+    std::atomic<bool> truncated = false;
+
+    // Walk the folder and hand the files to a thread pool as they are found
+    void run(std::string folder, std::vector<std::byte> query, std::stop_source stop);
+    void addResult(Result&& result, std::stop_source& stop);
+};
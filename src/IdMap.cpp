@@ -0,0 +1,128 @@
+#include "IdMap.h"
+#include <algorithm>
+#include <bit>
+
+void IdMap::clear()
+{
+    slots.clear();
+    count = 0;
+    bits = 0;
+}
+
+void IdMap::reserve(size_t _count)
+{
+    if (_count * 2 > slots.size())
+    {
+        rehash(std::bit_ceil(std::max<size_t>(_count * 2, 16)));
+    }
+}
+
+bool IdMap::insert(int id, uint32_t index)
+{
+    reserve(count + 1);
+
+    size_t slot = findSlot(id);
+    if (slots[slot].index != NOT_FOUND)
+    {
+        return false;
+    }
+
+    slots[slot] = {id, index};
+    count++;
+    return true;
+}
+
+void IdMap::assign(int id, uint32_t index)
+{
+    reserve(count + 1);
+
+    size_t slot = findSlot(id);
+    if (slots[slot].index == NOT_FOUND)
+    {
+        count++;
+    }
+    slots[slot] = {id, index};
+}
+
+bool IdMap::erase(int id)
+{
+    if (count == 0)
+    {
+        return false;
+    }
+
+    size_t mask = slots.size() - 1;
+    size_t hole = findSlot(id);
+    if (slots[hole].index == NOT_FOUND)
+    {
+        return false;
+    }
+
+    // Move back the following IDs of the run that would no longer be found past the hole
+    slots[hole].index = NOT_FOUND;
+    for (size_t slot = (hole + 1) & mask; slots[slot].index != NOT_FOUND; slot = (slot + 1) & mask)
+    {
+        size_t home = getHomeSlot(slots[slot].id);
+        bool reachable = ((slot - home) & mask) < ((slot - hole) & mask);
+        if (!reachable)
+        {
+            slots[hole] = slots[slot];
+            slots[slot].index = NOT_FOUND;
+            hole = slot;
+        }
+    }
+
+    count--;
+    return true;
+}
+
+uint32_t IdMap::find(int id) const
+{
+    return count == 0 ? NOT_FOUND : slots[findSlot(id)].index;
+}
+
+bool IdMap::contains(int id) const
+{
+    return find(id) != NOT_FOUND;
+}
+
+size_t IdMap::size() const
+{
+    return count;
+}
+
+size_t IdMap::getMemoryUsage() const
+{
+    return slots.capacity() * sizeof(Slot);
+}
+
+size_t IdMap::getHomeSlot(int id) const
+{
+    return (size_t)(((uint64_t)(uint32_t)id * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+}
+
+size_t IdMap::findSlot(int id) const
+{
+    size_t mask = slots.size() - 1;
+    size_t slot = getHomeSlot(id);
+    while (slots[slot].index != NOT_FOUND && slots[slot].id != id)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void IdMap::rehash(size_t slotsCount)
+{
+    std::vector<Slot> previous = std::move(slots);
+    slots.assign(slotsCount, Slot{0, NOT_FOUND});
+    bits = std::countr_zero(slotsCount);
+
+    for (const Slot& slot : previous)
+    {
+        if (slot.index != NOT_FOUND)
+        {
+            slots[findSlot(slot.id)] = slot;
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Open addressing hash map from section or entry IDs to their position in a vector.
+// Slots are probed linearly and the table is kept at most half full.
+class IdMap
+{
+public:
+    // Returned by find() for IDs that are not in the map
+    const static uint32_t NOT_FOUND = UINT32_MAX;
+
+    void clear();
+    // Make room for "count" IDs without growing again
+    void reserve(size_t count);
+
+    // Returns false, leaving the map as it is, if "id" is already in it
+    bool insert(int id, uint32_t index);
+    // Returns false if "id" was not in the map
+    bool erase(int id);
+    // Point an ID to "index", inserting it if it is not in the map
+    void assign(int id, uint32_t index);
+
+    uint32_t find(int id) const;
+    bool contains(int id) const;
+    size_t size() const;
+    // Bytes allocated by the map
+    size_t getMemoryUsage() const;
+
+private:
+    struct Slot
+    {
+        int id;
+        uint32_t index; // NOT_FOUND for empty slots
+    };
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+    int bits = 0;
+
+    size_t getHomeSlot(int id) const;
+    // Slot holding "id", or the empty slot where it would go
+    size_t findSlot(int id) const;
+    void rehash(size_t slotsCount);
+};
@@ -0,0 +1,201 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : data(nullptr),
+      length(0),
+      opened(false),
+#ifdef _WIN32
+      fileHandle(INVALID_HANDLE_VALUE),
+      mappingHandle(nullptr)
+#else
+      fileDescriptor(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : MappedFile()
+{
+    takeFrom(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        takeFrom(other);
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    release();
+
+#ifdef _WIN32
+    // FILE_SHARE_DELETE lets the file be renamed while it is open, it still can't be replaced while it is mapped
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    length = (size_t)fileSize.QuadPart;
+    opened = true;
+
+    // Empty files cannot be mapped, they are exposed as an empty span instead
+    if (length == 0)
+    {
+        return true;
+    }
+
+    mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle == nullptr)
+    {
+        release();
+        return false;
+    }
+
+    data = static_cast<const std::byte*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (data == nullptr)
+    {
+        release();
+        return false;
+    }
+#else
+    int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0 || !S_ISREG(fileStat.st_mode))
+    {
+        ::close(file);
+        return false;
+    }
+
+    fileDescriptor = file;
+    length = (size_t)fileStat.st_size;
+    opened = true;
+
+    // Empty files cannot be mapped, they are exposed as an empty span instead
+    if (length == 0)
+    {
+        return true;
+    }
+
+    // MAP_SHARED keeps the mapping coherent with writes made to the file through other descriptors
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, file, 0);
+    if (mapped == MAP_FAILED)
+    {
+        release();
+        return false;
+    }
+    data = static_cast<const std::byte*>(mapped);
+
+    // The file is parsed mostly front to back
+    madvise(mapped, length, MADV_SEQUENTIAL);
+#endif
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    release();
+}
+
+bool MappedFile::isOpen() const
+{
+    return opened;
+}
+
+size_t MappedFile::size() const
+{
+    return length;
+}
+
+std::span<const std::byte> MappedFile::bytes() const
+{
+    return std::span<const std::byte>(data, length);
+}
+
+void MappedFile::release()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+    if (mappingHandle != nullptr)
+    {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(fileHandle);
+    }
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+#else
+    if (data != nullptr)
+    {
+        munmap(const_cast<std::byte*>(data), length);
+    }
+    if (fileDescriptor >= 0)
+    {
+        ::close(fileDescriptor);
+    }
+    fileDescriptor = -1;
+#endif
+
+    data = nullptr;
+    length = 0;
+    opened = false;
+}
+
+void MappedFile::takeFrom(MappedFile& other)
+{
+    data = other.data;
+    length = other.length;
+    opened = other.opened;
+#ifdef _WIN32
+    fileHandle = other.fileHandle;
+    mappingHandle = other.mappingHandle;
+    other.fileHandle = INVALID_HANDLE_VALUE;
+    other.mappingHandle = nullptr;
+#else
+    fileDescriptor = other.fileDescriptor;
+    other.fileDescriptor = -1;
+#endif
+    other.data = nullptr;
+    other.length = 0;
+    other.opened = false;
+}
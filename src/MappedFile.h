@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+// The mapped bytes stay valid until the object is closed or destroyed.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const;
+    size_t size() const;
+    std::span<const std::byte> bytes() const;
+
+private:
+    const std::byte* data;
+    size_t length;
+    bool opened;
+
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fileDescriptor;
+#endif
+
+    void release();
+    void takeFrom(MappedFile& other);
+};
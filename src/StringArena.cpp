@@ -0,0 +1,267 @@
+#include "StringArena.h"
+#include "Cpu.h"
+#include "ThreadPool.h"
+#include "Transcoder.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    inline int countTrailingZeros(uint32_t value)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return (int)index;
+#else
+        return __builtin_ctz(value);
+#endif
+    }
+
+    char toUpperAscii(char character)
+    {
+        return (character >= 'a' && character <= 'z') ? (char)(character - ('a' - 'A')) : character;
+    }
+
+    // Search of one query over a range of documents
+    struct Search
+    {
+        const char* data;
+        std::string_view query;
+        bool ignoreCase;
+        const uint32_t* offsets;
+        size_t firstDocument;
+        size_t lastDocument;
+        uint8_t* results;
+
+        // First and last byte of the query, in both cases if the case is ignored
+        char first[2];
+        char last[2];
+
+        Search(const char* _data, std::string_view _query, bool _ignoreCase, const uint32_t* _offsets,
+               size_t _firstDocument, size_t _lastDocument, uint8_t* _results)
+            : data(_data), query(_query), ignoreCase(_ignoreCase), offsets(_offsets),
+              firstDocument(_firstDocument), lastDocument(_lastDocument), results(_results)
+        {
+            first[0] = first[1] = query.front();
+            last[0] = last[1] = query.back();
+            if (ignoreCase)
+            {
+                first[0] = Utils::toLowerAscii(query.front());
+                first[1] = toUpperAscii(query.front());
+                last[0] = Utils::toLowerAscii(query.back());
+                last[1] = toUpperAscii(query.back());
+            }
+        }
+
+        bool isCandidate(size_t position) const
+        {
+            char firstByte = data[position];
+            char lastByte = data[position + query.size() - 1];
+            return (firstByte == first[0] || firstByte == first[1]) && (lastByte == last[0] || lastByte == last[1]);
+        }
+
+        // Compare the whole query at "position" and mark the document holding it
+        // Returns true with "next" set to the start of the following document if it matches
+        bool verify(size_t position, size_t& next) const
+        {
+            const char* candidate = data + position;
+            if (ignoreCase)
+            {
+                for (size_t i = 0; i < query.size(); i++)
+                {
+                    if (Utils::toLowerAscii(candidate[i]) != Utils::toLowerAscii(query[i]))
+                    {
+                        return false;
+                    }
+                }
+            }
+            else if (std::memcmp(candidate, query.data(), query.size()) != 0)
+            {
+                return false;
+            }
+
+            size_t document = std::upper_bound(offsets + firstDocument, offsets + lastDocument + 1, (uint32_t)position) - offsets - 1;
+            // The query must end before the separator of the document
+            if (position + query.size() >= offsets[document + 1])
+            {
+                return false;
+            }
+
+            results[document] = 1;
+            next = offsets[document + 1];
+            return true;
+        }
+    };
+
+#ifdef CPU_X86
+    const bool hasAvx2 = Cpu::hasAvx2();
+
+    // Search whole vectors from "position" and move it past them
+    CPU_TARGET_AVX2 void scanAvx2(const Search& search, size_t& position, size_t end)
+    {
+        size_t lastOffset = search.query.size() - 1;
+        __m256i first0 = _mm256_set1_epi8(search.first[0]);
+        __m256i first1 = _mm256_set1_epi8(search.first[1]);
+        __m256i last0 = _mm256_set1_epi8(search.last[0]);
+        __m256i last1 = _mm256_set1_epi8(search.last[1]);
+
+        while (end - position >= lastOffset + 32)
+        {
+            __m256i firstBytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(search.data + position));
+            __m256i lastBytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(search.data + position + lastOffset));
+            __m256i firstEqual = _mm256_or_si256(_mm256_cmpeq_epi8(firstBytes, first0), _mm256_cmpeq_epi8(firstBytes, first1));
+            __m256i lastEqual = _mm256_or_si256(_mm256_cmpeq_epi8(lastBytes, last0), _mm256_cmpeq_epi8(lastBytes, last1));
+            uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(firstEqual, lastEqual));
+
+            size_t next = position + 32;
+            while (mask != 0 && !search.verify(position + countTrailingZeros(mask), next))
+            {
+                mask &= mask - 1;
+            }
+            position = next;
+        }
+    }
+
+    void scanSse2(const Search& search, size_t& position, size_t end)
+    {
+        size_t lastOffset = search.query.size() - 1;
+        __m128i first0 = _mm_set1_epi8(search.first[0]);
+        __m128i first1 = _mm_set1_epi8(search.first[1]);
+        __m128i last0 = _mm_set1_epi8(search.last[0]);
+        __m128i last1 = _mm_set1_epi8(search.last[1]);
+
+        while (end - position >= lastOffset + 16)
+        {
+            __m128i firstBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(search.data + position));
+            __m128i lastBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(search.data + position + lastOffset));
+            __m128i firstEqual = _mm_or_si128(_mm_cmpeq_epi8(firstBytes, first0), _mm_cmpeq_epi8(firstBytes, first1));
+            __m128i lastEqual = _mm_or_si128(_mm_cmpeq_epi8(lastBytes, last0), _mm_cmpeq_epi8(lastBytes, last1));
+            uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(firstEqual, lastEqual));
+
+            size_t next = position + 16;
+            while (mask != 0 && !search.verify(position + countTrailingZeros(mask), next))
+            {
+                mask &= mask - 1;
+            }
+            position = next;
+        }
+    }
+#endif
+
+    ThreadPool& getSearchPool()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+}
+
+void StringArena::clear()
+{
+    bytes.clear();
+    offsets.assign(1, 0);
+}
+
+void StringArena::reserve(size_t _bytes, size_t documents)
+{
+    bytes.reserve(_bytes);
+    offsets.reserve(documents + 1);
+}
+
+void StringArena::add(std::string_view _string)
+{
+    bytes.append(_string);
+    bytes.push_back('\n');
+    offsets.push_back((uint32_t)bytes.size());
+}
+
+void StringArena::addUtf16Be(std::span<const std::byte> _string)
+{
+    Transcoder::utf16BeToUtf8(_string, bytes);
+    bytes.push_back('\n');
+    offsets.push_back((uint32_t)bytes.size());
+}
+
+void StringArena::find(std::string_view query, bool ignoreCase, std::vector<uint8_t>& results) const
+{
+    size_t documentsCount = getDocumentCount();
+    if (query.empty())
+    {
+        results.assign(documentsCount, 1);
+        return;
+    }
+
+    results.assign(documentsCount, 0);
+    if (bytes.size() < PARALLEL_SIZE)
+    {
+        findRange(query, ignoreCase, 0, documentsCount, results);
+        return;
+    }
+
+    // A few parts per thread so the ones finishing early can steal the rest
+    ThreadPool& pool = getSearchPool();
+    size_t partsCount = std::min(pool.size() * 4, bytes.size() / (PARALLEL_SIZE / 4));
+    size_t first = 0;
+    for (size_t part = 1; part <= partsCount; part++)
+    {
+        // Parts end on the first document starting after their share of the bytes
+        size_t last = documentsCount;
+        if (part < partsCount)
+        {
+            uint32_t target = (uint32_t)(bytes.size() / partsCount * part);
+            last = std::upper_bound(offsets.begin(), offsets.end() - 1, target) - offsets.begin();
+        }
+
+        if (last > first)
+        {
+            // Parts write to different documents of "results"
+            pool.submit([this, query, ignoreCase, first, last, &results] {
+                findRange(query, ignoreCase, first, last, results);
+            });
+            first = last;
+        }
+    }
+    pool.wait();
+}
+
+void StringArena::findRange(std::string_view query, bool ignoreCase, size_t first, size_t last,
+                            std::vector<uint8_t>& results) const
+{
+    Search search(bytes.data(), query, ignoreCase, offsets.data(), first, last, results.data());
+    size_t position = offsets[first];
+    size_t end = offsets[last];
+
+#ifdef CPU_X86
+    if (hasAvx2)
+    {
+        scanAvx2(search, position, end);
+    }
+    scanSse2(search, position, end);
+#endif
+
+    while (end - position >= query.size())
+    {
+        size_t next = position + 1;
+        position = search.isCandidate(position) && search.verify(position, next) ? next : position + 1;
+    }
+}
+
+size_t StringArena::getDocumentCount() const
+{
+    return offsets.size() - 1;
+}
+
+size_t StringArena::size() const
+{
+    return bytes.size();
+}
+
+size_t StringArena::getMemoryUsage() const
+{
+    return bytes.capacity() + offsets.capacity() * sizeof(uint32_t);
+}
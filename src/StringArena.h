@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Every string of a file as UTF-8, one after the other in a single buffer and separated by newlines.
+// Searching it reads memory in order instead of following a pointer per string, with a SIMD
+// kernel(SSE2/AVX2) comparing the first and last byte of the query at every position first.
+// Strings are documents numbered in the order they were added, like in TrigramIndex.
+class StringArena
+{
+public:
+    void clear();
+    void reserve(size_t bytes, size_t documents);
+
+    // Append a string as the next document
+    void add(std::string_view _string);
+    // Append a string of UTF-16 big endian bytes as the next document
+    void addUtf16Be(std::span<const std::byte> _string);
+
+    // Set "results[document]" to 1 for every document containing "query" and 0 for the others,
+    // "results" is resized to getDocumentCount()
+    // Large arenas are split across the threads of a pool
+    void find(std::string_view query, bool ignoreCase, std::vector<uint8_t>& results) const;
+
+    size_t getDocumentCount() const;
+    // Size of the arena in bytes, separators included
+    size_t size() const;
+    // Bytes allocated by the arena
+    size_t getMemoryUsage() const;
+
+private:
+    // Arenas smaller than this are searched on the calling thread
+    const static size_t PARALLEL_SIZE = 8 * 1024 * 1024;
+
+    std::string bytes;
+    // Where every document starts in "bytes", the last value is the size of "bytes"
+    std::vector<uint32_t> offsets = {0};
+
+    // Search the documents from "first" up to "last"(not included)
+    void findRange(std::string_view query, bool ignoreCase, size_t first, size_t last,
+                   std::vector<uint8_t>& results) const;
+};
@@ -0,0 +1,196 @@
+#include "StringScanner.h"
+#include "Cpu.h"
+#include <algorithm>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace StringScanner
+{
+    namespace
+    {
+        inline bool isNullUnit(const std::byte* unit)
+        {
+            return unit[0] == std::byte(0) && unit[1] == std::byte(0);
+        }
+
+        inline int countTrailingZeros(uint32_t value)
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long index;
+            _BitScanForward(&index, value);
+            return (int)index;
+#else
+            return __builtin_ctz(value);
+#endif
+        }
+
+#ifdef CPU_X86
+        const bool hasAvx2 = Cpu::hasAvx2();
+
+        // Bit mask with 2 bits set for every null code unit in the next 16 bytes
+        inline uint32_t nullUnitsSse2(const std::byte* source)
+        {
+            __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+            return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi16(units, _mm_setzero_si128()));
+        }
+
+        CPU_TARGET_AVX2 inline uint32_t nullUnitsAvx2(const std::byte* source)
+        {
+            __m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source));
+            return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi16(units, _mm256_setzero_si256()));
+        }
+
+        // Search whole vectors from "index", returns true with "index" set to the first null code unit if there is one
+        CPU_TARGET_AVX2 bool findAvx2(const std::byte* source, size_t size, size_t& index)
+        {
+            while (size - index >= 32)
+            {
+                uint32_t mask = nullUnitsAvx2(source + index);
+                if (mask != 0)
+                {
+                    index += countTrailingZeros(mask);
+                    return true;
+                }
+                index += 32;
+            }
+            return false;
+        }
+
+        bool findSse2(const std::byte* source, size_t size, size_t& index)
+        {
+            while (size - index >= 16)
+            {
+                uint32_t mask = nullUnitsSse2(source + index);
+                if (mask != 0)
+                {
+                    index += countTrailingZeros(mask);
+                    return true;
+                }
+                index += 16;
+            }
+            return false;
+        }
+
+        // Every other bit of the mask belongs to the same code unit, one is enough
+        inline void appendNullUnits(uint32_t mask, size_t base, std::vector<uint32_t>& terminators)
+        {
+            mask &= 0x55555555;
+            while (mask != 0)
+            {
+                terminators.push_back((uint32_t)(base + countTrailingZeros(mask)));
+                mask &= mask - 1;
+            }
+        }
+
+        // Search whole vectors from "index" and move it past them
+        CPU_TARGET_AVX2 void findAllAvx2(const std::byte* source, size_t size, size_t& index, std::vector<uint32_t>& terminators)
+        {
+            while (size - index >= 32)
+            {
+                appendNullUnits(nullUnitsAvx2(source + index), index, terminators);
+                index += 32;
+            }
+        }
+
+        void findAllSse2(const std::byte* source, size_t size, size_t& index, std::vector<uint32_t>& terminators)
+        {
+            while (size - index >= 16)
+            {
+                appendNullUnits(nullUnitsSse2(source + index), index, terminators);
+                index += 16;
+            }
+        }
+#endif
+    }
+
+    size_t findTerminatorUtf16(std::span<const std::byte> buffer, size_t offset)
+    {
+        if (offset >= buffer.size())
+        {
+            return offset;
+        }
+
+        const std::byte* source = buffer.data() + offset;
+        size_t size = buffer.size() - offset;
+        size_t index = 0;
+
+#ifdef CPU_X86
+        if ((hasAvx2 && findAvx2(source, size, index)) || findSse2(source, size, index))
+        {
+            return offset + index;
+        }
+#endif
+
+        while (index + 1 < size && !isNullUnit(source + index))
+        {
+            index += 2;
+        }
+
+        if (index + 1 >= size)
+        {
+            // No terminator, the string ends with the last whole code unit
+            return offset + size - (size % 2);
+        }
+        return offset + index;
+    }
+
+    void findAllTerminatorsUtf16(std::span<const std::byte> region, std::vector<uint32_t>& terminators)
+    {
+        const std::byte* source = region.data();
+        size_t size = region.size();
+        size_t index = 0;
+
+#ifdef CPU_X86
+        if (hasAvx2)
+        {
+            findAllAvx2(source, size, index, terminators);
+        }
+        findAllSse2(source, size, index, terminators);
+#endif
+
+        for (; index + 1 < size; index += 2)
+        {
+            if (isNullUnit(source + index))
+            {
+                terminators.push_back((uint32_t)index);
+            }
+        }
+    }
+}
+
+StringTable::StringTable()
+    : cursor(0)
+{
+}
+
+void StringTable::scan(std::span<const std::byte> _region)
+{
+    region = _region;
+    terminators.clear();
+    cursor = 0;
+
+    StringScanner::findAllTerminatorsUtf16(region, terminators);
+}
+
+std::optional<std::span<const std::byte>> StringTable::getString(size_t offset)
+{
+    if (offset >= region.size() || offset % 2 != 0)
+    {
+        return std::nullopt;
+    }
+
+    // Strings are usually stored in the same order as their entries
+    if (cursor > 0 && terminators.at(cursor - 1) >= offset)
+    {
+        cursor = std::lower_bound(terminators.begin(), terminators.end(), (uint32_t)offset) - terminators.begin();
+    }
+    while (cursor < terminators.size() && terminators[cursor] < offset)
+    {
+        cursor++;
+    }
+
+    size_t end = (cursor < terminators.size()) ? terminators[cursor] : region.size() - (region.size() % 2);
+    return region.subspan(offset, end - offset);
+}
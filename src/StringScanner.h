@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// SIMD search for the null terminators of UTF-16 strings.
+// Code units are 2 bytes wide and aligned to the position where the search starts.
+namespace StringScanner
+{
+    // Find the first null code unit at or after "offset"
+    // Returns the position right after the last whole code unit if there is none
+    size_t findTerminatorUtf16(std::span<const std::byte> buffer, size_t offset);
+
+    // Append the position of every null code unit of "region" to "terminators", in increasing order
+    void findAllTerminatorsUtf16(std::span<const std::byte> region, std::vector<uint32_t>& terminators);
+}
+
+// Region of a file holding UTF-16 strings one after the other.
+// The whole region is scanned once, so looking up each string afterwards is cheap.
+class StringTable
+{
+public:
+    StringTable();
+
+    void scan(std::span<const std::byte> region);
+
+    // Get the bytes of the string starting at "offset" in the region, without its null terminator
+    // Returns std::nullopt if offset is outside the region or not aligned to a code unit
+    std::optional<std::span<const std::byte>> getString(size_t offset);
+
+private:
+    std::span<const std::byte> region;
+    std::vector<uint32_t> terminators;
+    // Strings are usually looked up in order, so the search continues from the previous result
+    size_t cursor;
+};
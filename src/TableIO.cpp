@@ -0,0 +1,980 @@
+#include "TableIO.h"
+#include "IdMap.h"
+#include "Transcoder.h"
+#include "Utils.h"
+#include "YtxFile.h"
+#include <loguru.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+
+namespace TableIO
+{
+    namespace
+    {
+        // Written rows are gathered up to this size before they are sent to the file
+        const size_t WRITE_BUFFER_SIZE = 256 * 1024;
+        const char* UTF8_BOM = "\xEF\xBB\xBF";
+
+        const char* TSV_HEADER = "# section\tid\tstring\n";
+        const char* CSV_HEADER = "section,id,string\n";
+        const char* PO_HEADER = "msgid \"\"\nmsgstr \"\"\n\"Content-Type: text/plain; charset=UTF-8\\n\"\n\n";
+
+        bool parseHex(std::string_view text, int& value)
+        {
+            uint32_t parsed = 0;
+            std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), parsed, 16);
+            value = (int)parsed;
+            return !text.empty() && result.ec == std::errc() && result.ptr == text.data() + text.size();
+        }
+
+        void appendHex(std::string& output, int value)
+        {
+            char digits[16];
+            std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), (uint32_t)value, 16);
+            output.append(digits, result.ptr);
+        }
+
+        // Append a code point as UTF-8, returns false if it is not a valid one
+        bool appendCodePoint(std::string& output, uint32_t codePoint)
+        {
+            if (codePoint < 0x80)
+            {
+                output += (char)codePoint;
+            }
+            else if (codePoint < 0x800)
+            {
+                output += (char)(0xC0 | (codePoint >> 6));
+                output += (char)(0x80 | (codePoint & 0x3F));
+            }
+            else if (codePoint < 0x10000)
+            {
+                if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+                {
+                    return false;
+                }
+                output += (char)(0xE0 | (codePoint >> 12));
+                output += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                output += (char)(0x80 | (codePoint & 0x3F));
+            }
+            else if (codePoint < 0x110000)
+            {
+                output += (char)(0xF0 | (codePoint >> 18));
+                output += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+                output += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                output += (char)(0x80 | (codePoint & 0x3F));
+            }
+            else
+            {
+                return false;
+            }
+            return true;
+        }
+
+        void appendTsvEscaped(std::string& output, std::string_view _string)
+        {
+            for (char c : _string)
+            {
+                switch (c)
+                {
+                case '\\':
+                    output += "\\\\";
+                    break;
+                case '\t':
+                    output += "\\t";
+                    break;
+                case '\n':
+                    output += "\\n";
+                    break;
+                case '\r':
+                    output += "\\r";
+                    break;
+                default:
+                    output += c;
+                }
+            }
+        }
+
+        void appendCsvField(std::string& output, std::string_view _string)
+        {
+            // Only fields that need it are quoted, quotes inside them are doubled
+            if (_string.find_first_of(",\"\r\n") == std::string_view::npos)
+            {
+                output += _string;
+                return;
+            }
+
+            output += '"';
+            for (char c : _string)
+            {
+                if (c == '"')
+                {
+                    output += '"';
+                }
+                output += c;
+            }
+            output += '"';
+        }
+
+        // Escapes shared by JSON and PO strings, without the quotes around them
+        void appendQuotedEscaped(std::string& output, std::string_view _string, bool json)
+        {
+            for (char c : _string)
+            {
+                switch (c)
+                {
+                case '"':
+                    output += "\\\"";
+                    break;
+                case '\\':
+                    output += "\\\\";
+                    break;
+                case '\n':
+                    output += "\\n";
+                    break;
+                case '\r':
+                    output += "\\r";
+                    break;
+                case '\t':
+                    output += "\\t";
+                    break;
+                default:
+                    if (json && (unsigned char)c < 0x20)
+                    {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int)c);
+                        output += escaped;
+                    }
+                    else
+                    {
+                        output += c;
+                    }
+                }
+            }
+        }
+
+        std::string unescapeTsv(std::string_view _string)
+        {
+            std::string result;
+            result.reserve(_string.size());
+            for (size_t i = 0; i < _string.size(); i++)
+            {
+                if (_string[i] != '\\' || i + 1 == _string.size())
+                {
+                    result += _string[i];
+                    continue;
+                }
+
+                i++;
+                switch (_string[i])
+                {
+                case 't':
+                    result += '\t';
+                    break;
+                case 'n':
+                    result += '\n';
+                    break;
+                case 'r':
+                    result += '\r';
+                    break;
+                default:
+                    result += _string[i];
+                }
+            }
+            return result;
+        }
+
+        // Read a quoted string starting at "position", moving past its closing quote
+        // JSON strings also allow \uXXXX escapes, PO strings the escapes of C
+        bool parseQuoted(std::string_view text, size_t& position, std::string& result, bool json)
+        {
+            if (position >= text.size() || text[position] != '"')
+            {
+                return false;
+            }
+
+            for (position++; position < text.size(); position++)
+            {
+                char c = text[position];
+                if (c == '"')
+                {
+                    position++;
+                    return true;
+                }
+                if (c != '\\')
+                {
+                    result += c;
+                    continue;
+                }
+
+                if (++position == text.size())
+                {
+                    return false;
+                }
+                switch (text[position])
+                {
+                case 'n':
+                    result += '\n';
+                    break;
+                case 'r':
+                    result += '\r';
+                    break;
+                case 't':
+                    result += '\t';
+                    break;
+                case 'b':
+                    result += '\b';
+                    break;
+                case 'f':
+                    result += '\f';
+                    break;
+                case 'a':
+                    result += '\a';
+                    break;
+                case 'v':
+                    result += '\v';
+                    break;
+                case 'u':
+                {
+                    if (!json || text.size() - position < 5)
+                    {
+                        return false;
+                    }
+                    int unit;
+                    if (!parseHex(text.substr(position + 1, 4), unit))
+                    {
+                        return false;
+                    }
+                    position += 4;
+
+                    uint32_t codePoint = (uint32_t)unit;
+                    // Characters outside the BMP are escaped as a surrogate pair
+                    if (codePoint >= 0xD800 && codePoint <= 0xDBFF && text.size() - position >= 7 &&
+                        text.substr(position + 1, 2) == "\\u")
+                    {
+                        int low;
+                        if (parseHex(text.substr(position + 3, 4), low) && low >= 0xDC00 && low <= 0xDFFF)
+                        {
+                            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (uint32_t)(low - 0xDC00);
+                            position += 6;
+                        }
+                    }
+                    if (!appendCodePoint(result, codePoint))
+                    {
+                        return false;
+                    }
+                    break;
+                }
+                default:
+                    result += text[position];
+                }
+            }
+            return false;
+        }
+
+        void skipSpaces(std::string_view text, size_t& position)
+        {
+            while (position < text.size() && (text[position] == ' ' || text[position] == '\t'))
+            {
+                position++;
+            }
+        }
+    }
+
+    std::optional<Format> getFormat(const std::string& path)
+    {
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos || path.find_first_of("/\\", dot) != std::string::npos)
+        {
+            return std::nullopt;
+        }
+        return parseFormat(std::string_view(path).substr(dot + 1));
+    }
+
+    std::optional<Format> parseFormat(std::string_view name)
+    {
+        std::string lower(name);
+        std::transform(lower.begin(), lower.end(), lower.begin(), Utils::toLowerAscii);
+        if (lower == "tsv")
+        {
+            return Format::TSV;
+        }
+        if (lower == "csv")
+        {
+            return Format::CSV;
+        }
+        if (lower == "jsonl")
+        {
+            return Format::JSONL;
+        }
+        if (lower == "po" || lower == "pot")
+        {
+            return Format::PO;
+        }
+        return std::nullopt;
+    }
+
+    const char* getExtension(Format format)
+    {
+        switch (format)
+        {
+        case Format::TSV:
+            return ".tsv";
+        case Format::CSV:
+            return ".csv";
+        case Format::JSONL:
+            return ".jsonl";
+        case Format::PO:
+            return ".po";
+        }
+        return "";
+    }
+
+    bool Writer::open(const std::string& path, Format _format)
+    {
+        format = _format;
+        buffer.clear();
+        buffer.reserve(WRITE_BUFFER_SIZE + 4096);
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            return false;
+        }
+
+        switch (format)
+        {
+        case Format::TSV:
+            buffer += TSV_HEADER;
+            break;
+        case Format::CSV:
+            buffer += CSV_HEADER;
+            break;
+        case Format::JSONL:
+            break;
+        case Format::PO:
+            buffer += PO_HEADER;
+            break;
+        }
+        return true;
+    }
+
+    void Writer::write(int sectionId, int entryId, std::string_view _string)
+    {
+        switch (format)
+        {
+        case Format::TSV:
+            appendHex(buffer, sectionId);
+            buffer += '\t';
+            appendHex(buffer, entryId);
+            buffer += '\t';
+            appendTsvEscaped(buffer, _string);
+            buffer += '\n';
+            break;
+
+        case Format::CSV:
+            appendHex(buffer, sectionId);
+            buffer += ',';
+            appendHex(buffer, entryId);
+            buffer += ',';
+            appendCsvField(buffer, _string);
+            buffer += '\n';
+            break;
+
+        case Format::JSONL:
+            buffer += "{\"section\":\"";
+            appendHex(buffer, sectionId);
+            buffer += "\",\"id\":\"";
+            appendHex(buffer, entryId);
+            buffer += "\",\"string\":\"";
+            appendQuotedEscaped(buffer, _string, true);
+            buffer += "\"}\n";
+            break;
+
+        case Format::PO:
+            // Translations are filled in by the translators, entries left empty keep their string
+            buffer += "msgctxt \"";
+            appendHex(buffer, sectionId);
+            buffer += ':';
+            appendHex(buffer, entryId);
+            buffer += "\"\nmsgid \"";
+            appendQuotedEscaped(buffer, _string, false);
+            buffer += "\"\nmsgstr \"\"\n\n";
+            break;
+        }
+
+        if (buffer.size() >= WRITE_BUFFER_SIZE)
+        {
+            flush();
+        }
+    }
+
+    bool Writer::close()
+    {
+        flush();
+        out.close();
+        return !out.fail();
+    }
+
+    void Writer::flush()
+    {
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    bool Reader::open(const std::string& path, Format _format)
+    {
+        format = _format;
+        lineNumber = 0;
+        error.clear();
+        poEntry = PoEntry();
+        hasPendingLine = false;
+        // A reader can be opened again to read the same table twice
+        in.close();
+        in.clear();
+        in.open(path, std::ios::binary);
+        return (bool)in;
+    }
+
+    bool Reader::next(Row& row)
+    {
+        row._string.clear();
+        switch (format)
+        {
+        case Format::TSV:
+            return nextTsv(row);
+        case Format::CSV:
+            return nextCsv(row);
+        case Format::JSONL:
+            return nextJsonl(row);
+        case Format::PO:
+            return nextPo(row);
+        }
+        return false;
+    }
+
+    const std::string& Reader::getError() const
+    {
+        return error;
+    }
+
+    bool Reader::readLine()
+    {
+        if (!std::getline(in, line))
+        {
+            return false;
+        }
+
+        lineNumber++;
+        // Tables saved by spreadsheets and some editors start with a byte order mark
+        if (lineNumber == 1 && line.compare(0, 3, UTF8_BOM) == 0)
+        {
+            line.erase(0, 3);
+        }
+        return true;
+    }
+
+    bool Reader::fail(const std::string& message)
+    {
+        error = "Line " + std::to_string(lineNumber) + ": " + message;
+        return false;
+    }
+
+    bool Reader::nextTsv(Row& row)
+    {
+        while (readLine())
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (line.empty() || line.front() == '#')
+            {
+                continue;
+            }
+
+            std::string_view view = line;
+            size_t firstTab = view.find('\t');
+            size_t secondTab = firstTab == std::string_view::npos ? std::string_view::npos : view.find('\t', firstTab + 1);
+            if (secondTab == std::string_view::npos ||
+                !parseHex(view.substr(0, firstTab), row.sectionId) ||
+                !parseHex(view.substr(firstTab + 1, secondTab - firstTab - 1), row.entryId))
+            {
+                return fail("Expected section ID, entry ID and string separated by tabs");
+            }
+            row._string = unescapeTsv(view.substr(secondTab + 1));
+            return true;
+        }
+        return false;
+    }
+
+    bool Reader::nextCsv(Row& row)
+    {
+        std::string fields[3];
+        while (readLine())
+        {
+            int recordLine = lineNumber;
+            for (std::string& field : fields)
+            {
+                field.clear();
+            }
+
+            // A quoted field goes on over the next lines until its closing quote
+            size_t fieldIndex = 0;
+            bool quoted = false;
+            size_t position = 0;
+            while (true)
+            {
+                if (position == line.size())
+                {
+                    if (!quoted)
+                    {
+                        break;
+                    }
+                    if (!readLine())
+                    {
+                        lineNumber = recordLine;
+                        return fail("Quoted field is not closed");
+                    }
+                    if (fieldIndex < 3)
+                    {
+                        fields[fieldIndex] += '\n';
+                    }
+                    position = 0;
+                    continue;
+                }
+
+                char c = line[position++];
+                if (quoted)
+                {
+                    if (c == '"' && position < line.size() && line[position] == '"')
+                    {
+                        position++;
+                    }
+                    else if (c == '"')
+                    {
+                        quoted = false;
+                        continue;
+                    }
+                }
+                else if (c == '"')
+                {
+                    quoted = true;
+                    continue;
+                }
+                else if (c == ',')
+                {
+                    fieldIndex++;
+                    continue;
+                }
+                else if (c == '\r' && position == line.size())
+                {
+                    continue;
+                }
+
+                if (fieldIndex < 3)
+                {
+                    fields[fieldIndex] += c;
+                }
+            }
+
+            if (fieldIndex == 0 && fields[0].empty())
+            {
+                continue;
+            }
+            if (recordLine == 1 && fields[0] == "section")
+            {
+                continue;
+            }
+            if (fieldIndex != 2 || !parseHex(fields[0], row.sectionId) || !parseHex(fields[1], row.entryId))
+            {
+                lineNumber = recordLine;
+                return fail("Expected section ID, entry ID and string separated by commas");
+            }
+            row._string = std::move(fields[2]);
+            return true;
+        }
+        return false;
+    }
+
+    bool Reader::nextJsonl(Row& row)
+    {
+        std::string key;
+        std::string value;
+        while (readLine())
+        {
+            std::string_view view = line;
+            size_t position = 0;
+            skipSpaces(view, position);
+            if (position == view.size() || view[position] == '\r')
+            {
+                continue;
+            }
+            if (view[position++] != '{')
+            {
+                return fail("Expected a JSON object");
+            }
+
+            bool hasSection = false;
+            bool hasId = false;
+            bool hasString = false;
+            bool closed = false;
+            while (!closed)
+            {
+                skipSpaces(view, position);
+                key.clear();
+                value.clear();
+                if (!parseQuoted(view, position, key, true))
+                {
+                    return fail("Expected a quoted key");
+                }
+                skipSpaces(view, position);
+                if (position == view.size() || view[position++] != ':')
+                {
+                    return fail("Expected ':' after \"" + key + "\"");
+                }
+                skipSpaces(view, position);
+
+                // Values are strings, or numbers for the IDs of tools that write them as such
+                bool isString = position < view.size() && view[position] == '"';
+                if (isString)
+                {
+                    if (!parseQuoted(view, position, value, true))
+                    {
+                        return fail("Invalid string for \"" + key + "\"");
+                    }
+                }
+                else
+                {
+                    size_t end = view.find_first_of(",}", position);
+                    if (end == std::string_view::npos)
+                    {
+                        return fail("Object is not closed");
+                    }
+                    value = view.substr(position, end - position);
+                    Utils::trim(value);
+                    position = end;
+                }
+
+                bool validId = true;
+                if (key == "section" || key == "id")
+                {
+                    int& id = key == "section" ? row.sectionId : row.entryId;
+                    if (isString)
+                    {
+                        validId = parseHex(value, id);
+                    }
+                    else
+                    {
+                        std::from_chars_result result = std::from_chars(value.data(), value.data() + value.size(), id);
+                        validId = !value.empty() && result.ec == std::errc() && result.ptr == value.data() + value.size();
+                    }
+                    (key == "section" ? hasSection : hasId) = true;
+                }
+                else if (key == "string")
+                {
+                    if (!isString)
+                    {
+                        return fail("\"string\" must be a string");
+                    }
+                    row._string = std::move(value);
+                    hasString = true;
+                }
+                if (!validId)
+                {
+                    return fail("Invalid \"" + key + "\"");
+                }
+
+                skipSpaces(view, position);
+                if (position == view.size())
+                {
+                    return fail("Object is not closed");
+                }
+                char separator = view[position++];
+                if (separator == '}')
+                {
+                    closed = true;
+                }
+                else if (separator != ',')
+                {
+                    return fail("Expected ',' or '}'");
+                }
+            }
+
+            if (!hasSection || !hasId || !hasString)
+            {
+                return fail("Expected \"section\", \"id\" and \"string\"");
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool Reader::nextPo(Row& row)
+    {
+        // Field the next continuation line is added to
+        std::string* field = nullptr;
+        while (hasPendingLine || readLine())
+        {
+            hasPendingLine = false;
+            std::string trimmed = line;
+            Utils::trim(trimmed);
+
+            if (trimmed.empty())
+            {
+                field = nullptr;
+                if (finishPoEntry(row))
+                {
+                    return true;
+                }
+                continue;
+            }
+
+            if (trimmed.front() == '#')
+            {
+                // Flags come before the entry they apply to, after the previous one ended
+                if (poEntry.hasTranslation)
+                {
+                    hasPendingLine = true;
+                    field = nullptr;
+                    if (finishPoEntry(row))
+                    {
+                        return true;
+                    }
+                    continue;
+                }
+                if (trimmed.compare(0, 2, "#,") == 0 && trimmed.find("fuzzy") != std::string::npos)
+                {
+                    poEntry.fuzzy = true;
+                }
+                continue;
+            }
+
+            if (trimmed.front() == '"')
+            {
+                size_t position = 0;
+                if (field != nullptr && !parseQuoted(trimmed, position, *field, false))
+                {
+                    return fail("Invalid string");
+                }
+                continue;
+            }
+
+            size_t space = trimmed.find_first_of(" \t");
+            std::string keyword = trimmed.substr(0, space);
+            bool startsEntry = keyword == "msgctxt" || keyword == "msgid";
+            if (startsEntry && poEntry.hasTranslation)
+            {
+                // The next entry starts without a blank line before it
+                hasPendingLine = true;
+                field = nullptr;
+                if (finishPoEntry(row))
+                {
+                    return true;
+                }
+                continue;
+            }
+            if (startsEntry && poEntry.hasId)
+            {
+                return fail("Entry has no msgstr");
+            }
+
+            if (keyword == "msgctxt")
+            {
+                field = &poEntry.context;
+            }
+            else if (keyword == "msgid")
+            {
+                field = &poEntry.id;
+                poEntry.hasId = true;
+            }
+            else if (keyword == "msgstr" || keyword == "msgstr[0]")
+            {
+                field = &poEntry.translation;
+                poEntry.hasTranslation = true;
+            }
+            else if (keyword == "msgid_plural" || keyword.compare(0, 7, "msgstr[") == 0)
+            {
+                // Plural forms are read and ignored
+                field = nullptr;
+                continue;
+            }
+            else
+            {
+                return fail("Unknown keyword " + keyword);
+            }
+
+            field->clear();
+            size_t position = space == std::string::npos ? trimmed.size() : space;
+            skipSpaces(trimmed, position);
+            if (!parseQuoted(trimmed, position, *field, false))
+            {
+                return fail("Invalid string after " + keyword);
+            }
+        }
+
+        return error.empty() && finishPoEntry(row);
+    }
+
+    bool Reader::finishPoEntry(Row& row)
+    {
+        PoEntry entry = std::move(poEntry);
+        poEntry = PoEntry();
+        if (!entry.hasTranslation)
+        {
+            return false;
+        }
+
+        // The header, entries of other catalogs and the ones left to translate have nothing to apply
+        size_t separator = entry.context.find(':');
+        if (separator == std::string::npos ||
+            !parseHex(std::string_view(entry.context).substr(0, separator), row.sectionId) ||
+            !parseHex(std::string_view(entry.context).substr(separator + 1), row.entryId))
+        {
+            if (!entry.id.empty())
+            {
+                LOG_F(WARNING, "Skipping PO entry without a \"section:id\" context before line %d", lineNumber);
+            }
+            return false;
+        }
+        if (entry.fuzzy || entry.translation.empty())
+        {
+            return false;
+        }
+
+        row._string = std::move(entry.translation);
+        return true;
+    }
+
+    bool exportFile(YtxFile& file, const std::string& path, Format format, size_t* rowsCount)
+    {
+        Writer writer;
+        if (!writer.open(path, format))
+        {
+            LOG_F(ERROR, "Failed to create table: %s", path.c_str());
+            return false;
+        }
+
+        size_t rows = 0;
+        std::string decoded;
+        for (EntrySection& section : file.entrySections)
+        {
+            EntryStore& entries = section.entries;
+            for (size_t row = 0; row < entries.size(); row++)
+            {
+                if (entries.isDecoded(row))
+                {
+                    writer.write(section.id, entries.getId(row), entries.getString(row));
+                }
+                else
+                {
+                    decoded.clear();
+                    Transcoder::utf16BeToUtf8(entries.getRawString(row), decoded);
+                    writer.write(section.id, entries.getId(row), decoded);
+                }
+                rows++;
+            }
+        }
+
+        if (rowsCount != nullptr)
+        {
+            *rowsCount = rows;
+        }
+        if (!writer.close())
+        {
+            LOG_F(ERROR, "Failed to write table: %s", path.c_str());
+            return false;
+        }
+
+        LOG_F(INFO, "Exported %d entries of %s to: %s", (int)rows, file.getName().c_str(), path.c_str());
+        return true;
+    }
+
+    ImportResult importFile(YtxFile& file, const std::string& path, Format format)
+    {
+        ImportResult result;
+        Reader reader;
+        Row row;
+        std::vector<std::byte> encoded;
+
+        // Nothing is changed until every row was read, invalid UTF-8 is caught here too
+        if (!reader.open(path, format))
+        {
+            result.error = "Could not read " + path;
+            return result;
+        }
+        while (reader.next(row))
+        {
+            encoded.clear();
+            if (!Transcoder::utf8ToUtf16Be(row._string, encoded).ok())
+            {
+                char message[128];
+                std::snprintf(message, sizeof(message), ": Invalid UTF-8 in the string of entry %x of section %x",
+                              (unsigned int)row.entryId, (unsigned int)row.sectionId);
+                result.error = path + message;
+                return result;
+            }
+        }
+        if (!reader.getError().empty())
+        {
+            result.error = path + ": " + reader.getError();
+            return result;
+        }
+
+        // Sections sharing an ID are found by the first one, as everywhere else
+        IdMap sectionIndexes;
+        for (size_t i = 0; i < file.entrySections.size(); i++)
+        {
+            sectionIndexes.insert(file.entrySections[i].id, (uint32_t)i);
+        }
+
+        if (!reader.open(path, format))
+        {
+            result.error = "Could not read " + path;
+            return result;
+        }
+        while (reader.next(row))
+        {
+            result.rows++;
+            uint32_t sectionIndex = sectionIndexes.find(row.sectionId);
+            EntrySection* section = sectionIndex == IdMap::NOT_FOUND ? nullptr : &file.entrySections[sectionIndex];
+            uint32_t entryRow = section == nullptr ? IdMap::NOT_FOUND : section->entryIndexes.find(row.entryId);
+            if (entryRow == IdMap::NOT_FOUND)
+            {
+                result.notFound++;
+                continue;
+            }
+
+            // Strings that were not decoded are compared as they are in the file, so unchanged ones stay that way
+            EntryStore& entries = section->entries;
+            bool same;
+            if (entries.isDecoded(entryRow))
+            {
+                same = entries.getString(entryRow) == row._string;
+            }
+            else
+            {
+                encoded.clear();
+                Transcoder::utf8ToUtf16Be(row._string, encoded);
+                std::span<const std::byte> raw = entries.getRawString(entryRow);
+                same = std::equal(raw.begin(), raw.end(), encoded.begin(), encoded.end());
+            }
+
+            if (!same)
+            {
+                file.setEntryString(*section, entryRow, row._string);
+                result.changed++;
+            }
+        }
+
+        result.ok = reader.getError().empty();
+        if (!result.ok)
+        {
+            // The file changed on disk between both passes
+            result.error = path + ": " + reader.getError();
+        }
+        LOG_F(INFO, "Imported %s: %d rows, %d changed, %d not found", path.c_str(), (int)result.rows,
+              (int)result.changed, (int)result.notFound);
+        return result;
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class YtxFile;
+
+// Moves the strings of a file in and out of the formats translation tools work with, as rows of
+// section ID, entry ID and string. IDs are written in hex, as the editor shows them.
+// Tables are written through a fixed size buffer and read a line at a time, so neither holds more
+// than a row in memory whatever the size of the file.
+namespace TableIO
+{
+    enum class Format
+    {
+        TSV,   // Tab separated, tabs and line breaks escaped with a backslash
+        CSV,   // Comma separated, RFC 4180 quoting
+        JSONL, // One JSON object per line: {"section": "1a", "id": "2f", "string": "..."}
+        PO     // gettext catalog, "section:id" as context, the string as msgid and the translation as msgstr
+    };
+
+    struct Row
+    {
+        int sectionId = 0;
+        int entryId = 0;
+        std::string _string;
+    };
+
+    // Format of a table from the extension of its path, std::nullopt if it is not one of them
+    std::optional<Format> getFormat(const std::string& path);
+    // Format from its name("tsv", "csv", "jsonl" or "po")
+    std::optional<Format> parseFormat(std::string_view name);
+    // Extension of the format with its dot
+    const char* getExtension(Format format);
+
+    class Writer
+    {
+    public:
+        // Returns false if the file could not be created
+        bool open(const std::string& path, Format format);
+        void write(int sectionId, int entryId, std::string_view _string);
+        // Returns false if anything could not be written
+        bool close();
+
+    private:
+        std::ofstream out;
+        Format format = Format::TSV;
+        std::string buffer;
+
+        void flush();
+    };
+
+    class Reader
+    {
+    public:
+        // Returns false if the file could not be opened
+        bool open(const std::string& path, Format format);
+        // Read the next row, returns false at the end of the table or if a row is invalid
+        // PO entries that are not translated or are marked as fuzzy are skipped
+        bool next(Row& row);
+        // Why next() stopped before the end of the table, empty if it did not
+        const std::string& getError() const;
+
+    private:
+        std::ifstream in;
+        Format format = Format::TSV;
+        std::string line;
+        int lineNumber = 0;
+        std::string error;
+
+        // Entry of a PO catalog being read, its fields can span several lines
+        struct PoEntry
+        {
+            std::string context;
+            std::string id;
+            std::string translation;
+            bool fuzzy = false;
+            bool hasId = false;
+            bool hasTranslation = false;
+        };
+        PoEntry poEntry;
+        // The line read last starts the next PO entry and was not handled yet
+        bool hasPendingLine = false;
+
+        bool readLine();
+        bool nextTsv(Row& row);
+        bool nextCsv(Row& row);
+        bool nextJsonl(Row& row);
+        bool nextPo(Row& row);
+        // Turn the PO entry read into a row, returns false if it has nothing to apply
+        bool finishPoEntry(Row& row);
+        bool fail(const std::string& message);
+    };
+
+    // Write every entry of a file to a table
+    // Strings that were not decoded are converted one at a time and not kept
+    // Returns false if the table could not be written, "rowsCount" is set to the rows written
+    bool exportFile(YtxFile& file, const std::string& path, Format format, size_t* rowsCount = nullptr);
+
+    struct ImportResult
+    {
+        bool ok = false;
+        size_t rows = 0;
+        size_t changed = 0;
+        // Rows whose entry is not in the file
+        size_t notFound = 0;
+        std::string error;
+    };
+
+    // Replace the strings of the entries listed in a table, matched by section and entry ID
+    // The table is read twice: checked first, then applied in a single pass, so nothing changes if a row is invalid
+    ImportResult importFile(YtxFile& file, const std::string& path, Format format);
+}
@@ -0,0 +1,150 @@
+#include "ThreadPool.h"
+
+namespace
+{
+    // Pool and queue index of the worker running on the current thread, if any
+    thread_local const ThreadPool* currentPool = nullptr;
+    thread_local size_t currentIndex = 0;
+}
+
+ThreadPool::ThreadPool(size_t threadCount)
+    : queuedTasks(0),
+      pendingTasks(0),
+      nextQueue(0),
+      stopping(false)
+{
+    if (threadCount == 0)
+    {
+        threadCount = getDefaultThreadCount();
+    }
+
+    queues.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    threads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    size_t index = (currentPool == this)
+                       ? currentIndex
+                       : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+    pendingTasks.fetch_add(1);
+    queuedTasks.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+
+    // Taking the lock makes sure a worker about to sleep sees the new task
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+    }
+    workAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allDone.wait(lock, [this] { return pendingTasks.load() == 0; });
+}
+
+size_t ThreadPool::size() const
+{
+    return threads.size();
+}
+
+size_t ThreadPool::getDefaultThreadCount()
+{
+    unsigned int count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+    currentPool = this;
+    currentIndex = index;
+
+    std::function<void()> task;
+    while (true)
+    {
+        if (popTask(index, task) || stealTask(index, task))
+        {
+            queuedTasks.fetch_sub(1);
+            task();
+            task = nullptr;
+
+            if (pendingTasks.fetch_sub(1) == 1)
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                allDone.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(stateMutex);
+        workAvailable.wait(lock, [this] { return stopping || queuedTasks.load() > 0; });
+        if (stopping && queuedTasks.load() == 0)
+        {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::popTask(size_t index, std::function<void()>& task)
+{
+    WorkQueue& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+    {
+        return false;
+    }
+
+    // Newest first, its data is the most likely to still be in cache
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::stealTask(size_t index, std::function<void()>& task)
+{
+    for (size_t offset = 1; offset < queues.size(); offset++)
+    {
+        WorkQueue& queue = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+        {
+            continue;
+        }
+
+        // Oldest first, away from the end its owner works on
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
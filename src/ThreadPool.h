@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads with one task queue per worker.
+// Workers take their own tasks newest first and, once out of work, steal the oldest
+// tasks of the others, so a few slow tasks don't leave the rest of the pool idle.
+class ThreadPool
+{
+public:
+    // 0 threads uses one per hardware thread
+    explicit ThreadPool(size_t threadCount = 0);
+    // Waits for every submitted task to finish
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task. Tasks submitted from a worker go to that worker's own queue
+    void submit(std::function<void()> task);
+    // Block until every submitted task has finished. Must not be called from a task
+    void wait();
+
+    size_t size() const;
+
+    static size_t getDefaultThreadCount();
+
+private:
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> threads;
+
+    // Tasks waiting in a queue, and tasks waiting or running
+    std::atomic<size_t> queuedTasks;
+    std::atomic<size_t> pendingTasks;
+    std::atomic<size_t> nextQueue;
+
+    std::mutex stateMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    bool stopping;
+
+    void workerLoop(size_t index);
+    bool popTask(size_t index, std::function<void()>& task);
+    bool stealTask(size_t index, std::function<void()>& task);
+};
@@ -0,0 +1,632 @@
+#include "Transcoder.h"
+#include "Cpu.h"
+#include <cstdint>
+#include <cstring>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace Transcoder
+{
+    namespace
+    {
+        const char16_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+        void setError(Result& result, Error error, size_t position)
+        {
+            if (result.ok())
+            {
+                result.error = error;
+                result.position = position;
+            }
+        }
+
+        // Code units are read either as big endian bytes or in the machine's own byte order
+        template <bool BigEndian>
+        inline char16_t loadUnit(const unsigned char* source, size_t index)
+        {
+            if constexpr (BigEndian)
+            {
+                return (char16_t)(source[index * 2] << 8 | source[index * 2 + 1]);
+            }
+            else
+            {
+                char16_t unit;
+                std::memcpy(&unit, source + index * 2, sizeof(unit));
+                return unit;
+            }
+        }
+
+        template <bool BigEndian>
+        inline void storeUnit(unsigned char* destination, size_t index, char16_t unit)
+        {
+            if constexpr (BigEndian)
+            {
+                destination[index * 2] = (unsigned char)(unit >> 8);
+                destination[index * 2 + 1] = (unsigned char)(unit & 0xFF);
+            }
+            else
+            {
+                std::memcpy(destination + index * 2, &unit, sizeof(unit));
+            }
+        }
+
+        inline bool isSurrogate(char16_t unit)
+        {
+            return (unit & 0xF800) == 0xD800;
+        }
+
+        // Encode a code point that is not a surrogate, returns the amount of bytes written
+        inline size_t encodeUtf8(char* destination, char32_t codePoint)
+        {
+            if (codePoint < 0x80)
+            {
+                destination[0] = (char)codePoint;
+                return 1;
+            }
+            if (codePoint < 0x800)
+            {
+                destination[0] = (char)(0xC0 | (codePoint >> 6));
+                destination[1] = (char)(0x80 | (codePoint & 0x3F));
+                return 2;
+            }
+            if (codePoint < 0x10000)
+            {
+                destination[0] = (char)(0xE0 | (codePoint >> 12));
+                destination[1] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                destination[2] = (char)(0x80 | (codePoint & 0x3F));
+                return 3;
+            }
+            destination[0] = (char)(0xF0 | (codePoint >> 18));
+            destination[1] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+            destination[2] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+            destination[3] = (char)(0x80 | (codePoint & 0x3F));
+            return 4;
+        }
+
+        // Decode the UTF-8 sequence starting at "index" and move past it
+        // Invalid sequences decode to U+FFFD and only consume their first byte
+        inline char32_t decodeUtf8(const unsigned char* source, size_t count, size_t& index, Result& result)
+        {
+            unsigned char lead = source[index];
+            if (lead < 0x80)
+            {
+                index++;
+                return lead;
+            }
+
+            // Fast paths for valid 2 and 3 byte sequences
+            size_t available = count - index;
+            if ((lead & 0xE0) == 0xC0 && lead >= 0xC2 && available >= 2 && (source[index + 1] & 0xC0) == 0x80)
+            {
+                char32_t codePoint = ((char32_t)(lead & 0x1F) << 6) | (source[index + 1] & 0x3F);
+                index += 2;
+                return codePoint;
+            }
+            if ((lead & 0xF0) == 0xE0 && available >= 3 &&
+                (source[index + 1] & 0xC0) == 0x80 && (source[index + 2] & 0xC0) == 0x80)
+            {
+                char32_t codePoint = ((char32_t)(lead & 0x0F) << 12) |
+                                     ((char32_t)(source[index + 1] & 0x3F) << 6) |
+                                     (source[index + 2] & 0x3F);
+                if (codePoint >= 0x800 && (codePoint < 0xD800 || codePoint > 0xDFFF))
+                {
+                    index += 3;
+                    return codePoint;
+                }
+            }
+
+            size_t length;
+            char32_t codePoint;
+            char32_t minimum;
+            if ((lead & 0xE0) == 0xC0)
+            {
+                length = 2;
+                codePoint = lead & 0x1F;
+                minimum = 0x80;
+            }
+            else if ((lead & 0xF0) == 0xE0)
+            {
+                length = 3;
+                codePoint = lead & 0x0F;
+                minimum = 0x800;
+            }
+            else if ((lead & 0xF8) == 0xF0)
+            {
+                length = 4;
+                codePoint = lead & 0x07;
+                minimum = 0x10000;
+            }
+            else
+            {
+                setError(result, Error::INVALID_UTF8, index);
+                index++;
+                return REPLACEMENT_CHARACTER;
+            }
+
+            if (count - index < length)
+            {
+                setError(result, Error::INVALID_UTF8, index);
+                index++;
+                return REPLACEMENT_CHARACTER;
+            }
+
+            for (size_t i = 1; i < length; i++)
+            {
+                unsigned char continuation = source[index + i];
+                if ((continuation & 0xC0) != 0x80)
+                {
+                    setError(result, Error::INVALID_UTF8, index);
+                    index++;
+                    return REPLACEMENT_CHARACTER;
+                }
+                codePoint = (codePoint << 6) | (continuation & 0x3F);
+            }
+
+            if (codePoint < minimum || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+            {
+                setError(result, Error::INVALID_UTF8, index);
+                index++;
+                return REPLACEMENT_CHARACTER;
+            }
+
+            index += length;
+            return codePoint;
+        }
+
+#ifdef CPU_X86
+        const bool hasAvx2 = Cpu::hasAvx2();
+
+        // x86 is little endian, big endian code units need their bytes swapped
+        template <bool BigEndian>
+        inline __m128i loadUnitsSse2(const unsigned char* source)
+        {
+            __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+            if constexpr (BigEndian)
+            {
+                units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+            }
+            return units;
+        }
+
+        // Convert blocks of 8 ASCII code units, returns how many code units were converted
+        template <bool BigEndian>
+        size_t utf16AsciiToUtf8Sse2(const unsigned char* source, size_t count, char* destination)
+        {
+            const __m128i nonAsciiBits = _mm_set1_epi16((short)0xFF80);
+            const __m128i zero = _mm_setzero_si128();
+
+            size_t index = 0;
+            while (count - index >= 8)
+            {
+                __m128i units = loadUnitsSse2<BigEndian>(source + index * 2);
+                __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(units, nonAsciiBits), zero);
+                if (_mm_movemask_epi8(ascii) != 0xFFFF)
+                {
+                    break;
+                }
+
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + index), _mm_packus_epi16(units, units));
+                index += 8;
+            }
+            return index;
+        }
+
+        // Check whether the next 8 code units are free of surrogates
+        template <bool BigEndian>
+        inline bool isBmpBlockSse2(const unsigned char* source)
+        {
+            __m128i units = loadUnitsSse2<BigEndian>(source);
+            __m128i surrogates = _mm_cmpeq_epi16(_mm_and_si128(units, _mm_set1_epi16((short)0xF800)),
+                                                 _mm_set1_epi16((short)0xD800));
+            return _mm_movemask_epi8(surrogates) == 0;
+        }
+
+        // Convert blocks of 16 ASCII bytes, returns how many bytes were converted
+        template <bool BigEndian>
+        size_t utf8AsciiToUtf16Sse2(const unsigned char* source, size_t count, unsigned char* destination)
+        {
+            const __m128i zero = _mm_setzero_si128();
+
+            size_t index = 0;
+            while (count - index >= 16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index));
+                if (_mm_movemask_epi8(bytes) != 0)
+                {
+                    break;
+                }
+
+                __m128i low;
+                __m128i high;
+                if constexpr (BigEndian)
+                {
+                    low = _mm_unpacklo_epi8(zero, bytes);
+                    high = _mm_unpackhi_epi8(zero, bytes);
+                }
+                else
+                {
+                    low = _mm_unpacklo_epi8(bytes, zero);
+                    high = _mm_unpackhi_epi8(bytes, zero);
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index * 2), low);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index * 2 + 16), high);
+                index += 16;
+            }
+            return index;
+        }
+
+        // Count leading ASCII bytes in blocks of 16
+        size_t countAsciiSse2(const unsigned char* source, size_t count)
+        {
+            size_t index = 0;
+            while (count - index >= 16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index));
+                if (_mm_movemask_epi8(bytes) != 0)
+                {
+                    break;
+                }
+                index += 16;
+            }
+            return index;
+        }
+
+        template <bool BigEndian>
+        CPU_TARGET_AVX2 size_t utf16AsciiToUtf8Avx2(const unsigned char* source, size_t count, char* destination)
+        {
+            const __m256i nonAsciiBits = _mm256_set1_epi16((short)0xFF80);
+            const __m256i zero = _mm256_setzero_si256();
+
+            size_t index = 0;
+            while (count - index >= 16)
+            {
+                __m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + index * 2));
+                if constexpr (BigEndian)
+                {
+                    units = _mm256_or_si256(_mm256_slli_epi16(units, 8), _mm256_srli_epi16(units, 8));
+                }
+
+                __m256i ascii = _mm256_cmpeq_epi16(_mm256_and_si256(units, nonAsciiBits), zero);
+                if (_mm256_movemask_epi8(ascii) != -1)
+                {
+                    break;
+                }
+
+                // Packing works per 128-bit lane, the two 8-byte halves are brought together afterwards
+                __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(units, units), 0xD8);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index), _mm256_castsi256_si128(packed));
+                index += 16;
+            }
+            return index;
+        }
+
+        template <bool BigEndian>
+        CPU_TARGET_AVX2 size_t utf8AsciiToUtf16Avx2(const unsigned char* source, size_t count, unsigned char* destination)
+        {
+            size_t index = 0;
+            while (count - index >= 32)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + index));
+                if (_mm256_movemask_epi8(bytes) != 0)
+                {
+                    break;
+                }
+
+                __m256i low = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes));
+                __m256i high = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1));
+                if constexpr (BigEndian)
+                {
+                    low = _mm256_slli_epi16(low, 8);
+                    high = _mm256_slli_epi16(high, 8);
+                }
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + index * 2), low);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + index * 2 + 32), high);
+                index += 32;
+            }
+            return index;
+        }
+
+        CPU_TARGET_AVX2 size_t countAsciiAvx2(const unsigned char* source, size_t count)
+        {
+            size_t index = 0;
+            while (count - index >= 32)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + index));
+                if (_mm256_movemask_epi8(bytes) != 0)
+                {
+                    break;
+                }
+                index += 32;
+            }
+            return index;
+        }
+#endif
+
+        template <bool BigEndian>
+        size_t utf16AsciiRun(const unsigned char* source, size_t count, char* destination)
+        {
+#ifdef CPU_X86
+            size_t index = 0;
+            if (hasAvx2)
+            {
+                index = utf16AsciiToUtf8Avx2<BigEndian>(source, count, destination);
+            }
+            return index + utf16AsciiToUtf8Sse2<BigEndian>(source + index * 2, count - index, destination + index);
+#else
+            size_t index = 0;
+            while (index < count && loadUnit<BigEndian>(source, index) < 0x80)
+            {
+                destination[index] = (char)loadUnit<BigEndian>(source, index);
+                index++;
+            }
+            return index;
+#endif
+        }
+
+        template <bool BigEndian>
+        size_t utf8AsciiRun(const unsigned char* source, size_t count, unsigned char* destination)
+        {
+#ifdef CPU_X86
+            size_t index = 0;
+            if (hasAvx2)
+            {
+                index = utf8AsciiToUtf16Avx2<BigEndian>(source, count, destination);
+            }
+            return index + utf8AsciiToUtf16Sse2<BigEndian>(source + index, count - index, destination + index * 2);
+#else
+            size_t index = 0;
+            while (index < count && source[index] < 0x80)
+            {
+                storeUnit<BigEndian>(destination, index, source[index]);
+                index++;
+            }
+            return index;
+#endif
+        }
+
+        size_t asciiRunLength(const unsigned char* source, size_t count)
+        {
+#ifdef CPU_X86
+            size_t index = 0;
+            if (hasAvx2)
+            {
+                index = countAsciiAvx2(source, count);
+            }
+            return index + countAsciiSse2(source + index, count - index);
+#else
+            size_t index = 0;
+            while (index < count && source[index] < 0x80)
+            {
+                index++;
+            }
+            return index;
+#endif
+        }
+
+        // UTF-16 -> UTF-8, "destination" must hold at least 3 bytes per code unit
+        template <bool BigEndian>
+        size_t utf16ToUtf8(const unsigned char* source, size_t count, char* destination, Result& result)
+        {
+            size_t index = 0;
+            char* output = destination;
+            while (index < count)
+            {
+                if (loadUnit<BigEndian>(source, index) < 0x80)
+                {
+                    size_t ascii = utf16AsciiRun<BigEndian>(source + index * 2, count - index, output);
+                    index += ascii;
+                    output += ascii;
+
+                    // Rest of a run too short to fill a block
+                    while (index < count && loadUnit<BigEndian>(source, index) < 0x80)
+                    {
+                        *output++ = (char)loadUnit<BigEndian>(source, index++);
+                    }
+                    continue;
+                }
+
+#ifdef CPU_X86
+                // Runs without surrogates skip the pairing logic
+                if (count - index >= 8 && isBmpBlockSse2<BigEndian>(source + index * 2))
+                {
+                    for (size_t end = index + 8; index < end; index++)
+                    {
+                        output += encodeUtf8(output, loadUnit<BigEndian>(source, index));
+                    }
+                    continue;
+                }
+#endif
+
+                char16_t unit = loadUnit<BigEndian>(source, index);
+                if (!isSurrogate(unit))
+                {
+                    output += encodeUtf8(output, unit);
+                    index++;
+                    continue;
+                }
+
+                // High surrogate followed by a low surrogate
+                if (unit < 0xDC00 && index + 1 < count)
+                {
+                    char16_t next = loadUnit<BigEndian>(source, index + 1);
+                    if (next >= 0xDC00 && next <= 0xDFFF)
+                    {
+                        char32_t codePoint = 0x10000 + (((char32_t)unit - 0xD800) << 10) + (next - 0xDC00);
+                        output += encodeUtf8(output, codePoint);
+                        index += 2;
+                        continue;
+                    }
+                }
+
+                setError(result, Error::UNPAIRED_SURROGATE, index);
+                output += encodeUtf8(output, REPLACEMENT_CHARACTER);
+                index++;
+            }
+            return output - destination;
+        }
+
+        // UTF-8 -> UTF-16, "destination" must hold at least one code unit per byte
+        template <bool BigEndian>
+        size_t utf8ToUtf16(const unsigned char* source, size_t count, unsigned char* destination, Result& result)
+        {
+            size_t index = 0;
+            size_t units = 0;
+            while (index < count)
+            {
+                if (source[index] < 0x80)
+                {
+                    size_t ascii = utf8AsciiRun<BigEndian>(source + index, count - index, destination + units * 2);
+                    index += ascii;
+                    units += ascii;
+
+                    // Rest of a run too short to fill a block
+                    while (index < count && source[index] < 0x80)
+                    {
+                        storeUnit<BigEndian>(destination, units++, source[index++]);
+                    }
+                    continue;
+                }
+
+                // Run of non-ASCII characters
+                while (index < count && source[index] >= 0x80)
+                {
+                    // Most text outside of ASCII is made of valid 3 byte sequences(CJK, kana, symbols)
+                    unsigned char lead = source[index];
+                    if ((lead & 0xF0) == 0xE0 && count - index >= 3)
+                    {
+                        unsigned int continuation = source[index + 1] | (source[index + 2] << 8);
+                        char16_t unit = (char16_t)(((lead & 0x0F) << 12) |
+                                                   ((continuation & 0x3F) << 6) |
+                                                   ((continuation >> 8) & 0x3F));
+                        if ((continuation & 0xC0C0) == 0x8080 && unit >= 0x800 && !isSurrogate(unit))
+                        {
+                            storeUnit<BigEndian>(destination, units++, unit);
+                            index += 3;
+                            continue;
+                        }
+                    }
+
+                    char32_t codePoint = decodeUtf8(source, count, index, result);
+                    if (codePoint < 0x10000)
+                    {
+                        storeUnit<BigEndian>(destination, units++, (char16_t)codePoint);
+                    }
+                    else
+                    {
+                        codePoint -= 0x10000;
+                        storeUnit<BigEndian>(destination, units++, (char16_t)(0xD800 + (codePoint >> 10)));
+                        storeUnit<BigEndian>(destination, units++, (char16_t)(0xDC00 + (codePoint & 0x3FF)));
+                    }
+                }
+            }
+            return units;
+        }
+    }
+
+    Result utf16BeToUtf8(std::span<const std::byte> source, std::string& destination)
+    {
+        Result result;
+        size_t count = source.size() / 2;
+        if (source.size() % 2 != 0)
+        {
+            setError(result, Error::ODD_BYTE_COUNT, count);
+        }
+
+        size_t start = destination.size();
+        destination.resize(start + count * 3);
+        size_t written = utf16ToUtf8<true>(reinterpret_cast<const unsigned char*>(source.data()), count,
+                                           destination.data() + start, result);
+        destination.resize(start + written);
+        return result;
+    }
+
+    Result utf16ToUtf8(std::u16string_view source, std::string& destination)
+    {
+        Result result;
+        size_t start = destination.size();
+        destination.resize(start + source.size() * 3);
+        size_t written = utf16ToUtf8<false>(reinterpret_cast<const unsigned char*>(source.data()), source.size(),
+                                            destination.data() + start, result);
+        destination.resize(start + written);
+        return result;
+    }
+
+    Result utf8ToUtf16Be(std::string_view source, std::vector<std::byte>& destination)
+    {
+        Result result;
+        size_t start = destination.size();
+        destination.resize(start + source.size() * 2);
+        size_t units = utf8ToUtf16<true>(reinterpret_cast<const unsigned char*>(source.data()), source.size(),
+                                         reinterpret_cast<unsigned char*>(destination.data() + start), result);
+        destination.resize(start + units * 2);
+        return result;
+    }
+
+    Result utf8ToUtf16(std::string_view source, std::u16string& destination)
+    {
+        Result result;
+        size_t start = destination.size();
+        destination.resize(start + source.size());
+        size_t units = utf8ToUtf16<false>(reinterpret_cast<const unsigned char*>(source.data()), source.size(),
+                                          reinterpret_cast<unsigned char*>(destination.data() + start), result);
+        destination.resize(start + units);
+        return result;
+    }
+
+    size_t utf16Length(std::string_view source)
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(source.data());
+        size_t count = source.size();
+
+        Result ignored;
+        size_t index = 0;
+        size_t units = 0;
+        while (index < count)
+        {
+            if (bytes[index] < 0x80)
+            {
+                size_t ascii = asciiRunLength(bytes + index, count - index);
+                index += ascii;
+                units += ascii;
+
+                // Rest of a run too short to fill a block
+                while (index < count && bytes[index] < 0x80)
+                {
+                    index++;
+                    units++;
+                }
+                continue;
+            }
+
+            units += (decodeUtf8(bytes, count, index, ignored) < 0x10000) ? 1 : 2;
+        }
+        return units;
+    }
+
+    const char* getImplementationName()
+    {
+#ifdef CPU_X86
+        return hasAvx2 ? "avx2" : "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+    const char* getErrorName(Error error)
+    {
+        switch (error)
+        {
+        case Error::NONE:
+            return "None";
+        case Error::UNPAIRED_SURROGATE:
+            return "Unpaired surrogate";
+        case Error::INVALID_UTF8:
+            return "Invalid UTF-8";
+        case Error::ODD_BYTE_COUNT:
+            return "Odd byte count";
+        }
+        return "Unknown";
+    }
+}
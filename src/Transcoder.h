@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// UTF-16 <-> UTF-8 conversion with SIMD fast paths(SSE2/AVX2) for ASCII and BMP runs.
+// Conversions never throw: invalid sequences are replaced with U+FFFD and the first
+// error found is reported in the returned Result.
+namespace Transcoder
+{
+    enum class Error
+    {
+        NONE,
+        UNPAIRED_SURROGATE, // UTF-16 surrogate without its other half
+        INVALID_UTF8,       // Invalid, overlong or truncated UTF-8 sequence
+        ODD_BYTE_COUNT      // UTF-16 bytes that do not make a whole number of code units
+    };
+
+    struct Result
+    {
+        Error error = Error::NONE;
+        size_t position = 0; // Offset in the source(in code units) where the first error was found
+
+        bool ok() const { return error == Error::NONE; }
+    };
+
+    // Convert UTF-16 big endian bytes to UTF-8, appending the result to "destination"
+    Result utf16BeToUtf8(std::span<const std::byte> source, std::string& destination);
+    // Convert a native UTF-16 string to UTF-8, appending the result to "destination"
+    Result utf16ToUtf8(std::u16string_view source, std::string& destination);
+
+    // Convert UTF-8 to UTF-16 big endian bytes, appending the result to "destination"
+    Result utf8ToUtf16Be(std::string_view source, std::vector<std::byte>& destination);
+    // Convert UTF-8 to a native UTF-16 string, appending the result to "destination"
+    Result utf8ToUtf16(std::string_view source, std::u16string& destination);
+
+    // Number of UTF-16 code units a UTF-8 string converts to, replacement characters included
+    size_t utf16Length(std::string_view source);
+
+    // Name of the fastest code path available on this CPU("avx2", "sse2" or "scalar")
+    const char* getImplementationName();
+
+    const char* getErrorName(Error error);
+}
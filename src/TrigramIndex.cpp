@@ -0,0 +1,213 @@
+#include "TrigramIndex.h"
+#include <algorithm>
+#include <bit>
+
+const uint32_t TrigramIndex::NO_DOCUMENT;
+
+namespace
+{
+    // Posting list of a bucket: documents from build() followed by the ones added after it
+    struct PostingList
+    {
+        uint32_t bucket;
+        std::span<const uint32_t> built;
+        std::span<const uint32_t> added;
+
+        size_t size() const { return built.size() + added.size(); }
+    };
+
+    // Call "function" with every trigram of "_string"
+    template <typename Function>
+    void forEachTrigram(std::u16string_view _string, Function function)
+    {
+        for (size_t i = 2; i < _string.size(); i++)
+        {
+            function(_string[i - 2], _string[i - 1], _string[i]);
+        }
+    }
+
+    // Whether the sorted "list" holds "document", searching from "cursor" which is moved forward
+    bool containsFrom(std::span<const uint32_t> list, size_t& cursor, uint32_t document)
+    {
+        cursor = std::lower_bound(list.begin() + cursor, list.end(), document) - list.begin();
+        return cursor < list.size() && list[cursor] == document;
+    }
+}
+
+void TrigramIndex::clear()
+{
+    documents.clear();
+    bucketOffsets.clear();
+    bucketBits = DEFAULT_BUCKET_BITS;
+    addedDocuments.clear();
+    alive.clear();
+    removedCount = 0;
+}
+
+uint32_t TrigramIndex::getBucket(char16_t first, char16_t second, char16_t third) const
+{
+    uint64_t trigram = ((uint64_t)first << 32) | ((uint64_t)second << 16) | (uint64_t)third;
+    return (uint32_t)((trigram * 0x9E3779B97F4A7C15ull) >> (64 - bucketBits));
+}
+
+void TrigramIndex::build(size_t count, const GetDocument& getDocument)
+{
+    clear();
+
+    // Around 4 buckets per string, enough for collisions to stay rare without wasting memory
+    bucketBits = std::clamp((int)std::bit_width(count * 4), 10, 22);
+    size_t bucketsCount = (size_t)1 << bucketBits;
+
+    // Counting sort of the (bucket, document) pairs: count the documents of every bucket first,
+    // then fill the lists, documents come in increasing order so every list ends up sorted
+    std::vector<uint32_t> lastDocument(bucketsCount, NO_DOCUMENT);
+    bucketOffsets.assign(bucketsCount + 1, 0);
+    std::u16string buffer;
+    for (size_t document = 0; document < count; document++)
+    {
+        forEachTrigram(getDocument(document, buffer), [&](char16_t first, char16_t second, char16_t third) {
+            uint32_t bucket = getBucket(first, second, third);
+            if (lastDocument[bucket] != (uint32_t)document)
+            {
+                lastDocument[bucket] = (uint32_t)document;
+                bucketOffsets[bucket + 1]++;
+            }
+        });
+    }
+
+    for (size_t bucket = 0; bucket < bucketsCount; bucket++)
+    {
+        bucketOffsets[bucket + 1] += bucketOffsets[bucket];
+    }
+
+    documents.resize(bucketOffsets.back());
+    // Reused as the position where the next document of each bucket goes
+    std::vector<uint32_t>& nextPosition = lastDocument;
+    std::copy(bucketOffsets.begin(), bucketOffsets.end() - 1, nextPosition.begin());
+    for (size_t document = 0; document < count; document++)
+    {
+        forEachTrigram(getDocument(document, buffer), [&](char16_t first, char16_t second, char16_t third) {
+            uint32_t bucket = getBucket(first, second, third);
+            uint32_t& position = nextPosition[bucket];
+            if (position == bucketOffsets[bucket] || documents[position - 1] != (uint32_t)document)
+            {
+                documents[position++] = (uint32_t)document;
+            }
+        });
+    }
+
+    alive.assign(count, 1);
+}
+
+uint32_t TrigramIndex::add(std::u16string_view _string)
+{
+    uint32_t document = (uint32_t)alive.size();
+    alive.push_back(1);
+
+    forEachTrigram(_string, [&](char16_t first, char16_t second, char16_t third) {
+        std::vector<uint32_t>& list = addedDocuments[getBucket(first, second, third)];
+        // IDs only grow, so a trigram repeated in the string is already at the back
+        if (list.empty() || list.back() != document)
+        {
+            list.push_back(document);
+        }
+    });
+    return document;
+}
+
+void TrigramIndex::remove(uint32_t document)
+{
+    if (document < alive.size() && alive[document])
+    {
+        alive[document] = 0;
+        removedCount++;
+    }
+}
+
+bool TrigramIndex::findCandidates(std::u16string_view query, std::vector<uint8_t>& candidates) const
+{
+    if (query.size() < MIN_QUERY_LENGTH)
+    {
+        return false;
+    }
+
+    candidates.assign(alive.size(), 0);
+
+    std::vector<PostingList> lists;
+    bool missing = false;
+    forEachTrigram(query, [&](char16_t first, char16_t second, char16_t third) {
+        PostingList list{getBucket(first, second, third), {}, {}};
+        if (!bucketOffsets.empty())
+        {
+            list.built = std::span<const uint32_t>(documents).subspan(
+                bucketOffsets[list.bucket], bucketOffsets[list.bucket + 1] - bucketOffsets[list.bucket]);
+        }
+        auto added = addedDocuments.find(list.bucket);
+        if (added != addedDocuments.end())
+        {
+            list.added = added->second;
+        }
+        missing = missing || list.size() == 0;
+        lists.push_back(list);
+    });
+
+    if (missing)
+    {
+        // No string has one of the trigrams
+        return true;
+    }
+
+    // Start from the rarest trigram so the intersection stays small
+    std::sort(lists.begin(), lists.end(), [](const PostingList& a, const PostingList& b) {
+        return a.size() != b.size() ? a.size() < b.size() : a.bucket < b.bucket;
+    });
+    lists.erase(std::unique(lists.begin(), lists.end(), [](const PostingList& a, const PostingList& b) {
+        return a.bucket == b.bucket;
+    }), lists.end());
+
+    std::vector<uint32_t> result(lists.front().built.begin(), lists.front().built.end());
+    result.insert(result.end(), lists.front().added.begin(), lists.front().added.end());
+    for (size_t i = 1; i < lists.size() && !result.empty(); i++)
+    {
+        size_t builtCursor = 0;
+        size_t addedCursor = 0;
+        size_t kept = 0;
+        for (uint32_t document : result)
+        {
+            if (containsFrom(lists[i].built, builtCursor, document) ||
+                containsFrom(lists[i].added, addedCursor, document))
+            {
+                result[kept++] = document;
+            }
+        }
+        result.resize(kept);
+    }
+
+    for (uint32_t document : result)
+    {
+        candidates[document] = alive[document];
+    }
+    return true;
+}
+
+size_t TrigramIndex::getDocumentCount() const
+{
+    return alive.size();
+}
+
+bool TrigramIndex::needsRebuild() const
+{
+    return removedCount > 1024 && removedCount > alive.size() / 2;
+}
+
+size_t TrigramIndex::getMemoryUsage() const
+{
+    size_t usage = documents.capacity() * sizeof(uint32_t) +
+                   bucketOffsets.capacity() * sizeof(uint32_t) +
+                   alive.capacity();
+    for (const auto& [bucket, list] : addedDocuments)
+    {
+        usage += sizeof(bucket) + sizeof(list) + list.capacity() * sizeof(uint32_t);
+    }
+    return usage;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Posting lists of every 3 UTF-16 code unit sequence found in a set of strings.
+// A string containing a query contains every trigram of the query, so intersecting their
+// posting lists gives the few strings worth checking with a full substring search.
+// Trigrams are hashed into buckets: lists may hold a few extra strings, never miss one.
+// Strings added after the index was built get new document IDs, IDs of removed or edited
+// strings are only marked as removed until the index is built again.
+class TrigramIndex
+{
+public:
+    // ID of strings that are not in the index
+    const static uint32_t NO_DOCUMENT = UINT32_MAX;
+    // Queries shorter than this can not use the index
+    const static size_t MIN_QUERY_LENGTH = 3;
+
+    // Function giving the string of a document, "buffer" can be used to hold it
+    using GetDocument = std::function<std::u16string_view(size_t document, std::u16string& buffer)>;
+
+    void clear();
+    // Index "count" strings, giving them the document IDs 0 to count - 1
+    void build(size_t count, const GetDocument& getDocument);
+
+    // Index one more string and return its document ID
+    uint32_t add(std::u16string_view _string);
+    void remove(uint32_t document);
+
+    // Set "candidates[document]" to 1 for every live document containing all the trigrams of "query",
+    // "candidates" is resized to getDocumentCount()
+    // Returns false if the query is too short for the index to be used
+    bool findCandidates(std::u16string_view query, std::vector<uint8_t>& candidates) const;
+
+    // Amount of document IDs given so far, removed ones included
+    size_t getDocumentCount() const;
+    // Whether enough strings were removed that building the index again would be worth it
+    bool needsRebuild() const;
+    // Bytes allocated by the index
+    size_t getMemoryUsage() const;
+
+private:
+    const static int DEFAULT_BUCKET_BITS = 16;
+
+    // Posting lists of the documents indexed by build(), one after the other
+    std::vector<uint32_t> documents;
+    // Where the list of each bucket starts in "documents", the last value is the end of the last list
+    std::vector<uint32_t> bucketOffsets;
+    int bucketBits = DEFAULT_BUCKET_BITS;
+
+    // Posting lists of the documents added after build()
+    std::unordered_map<uint32_t, std::vector<uint32_t>> addedDocuments;
+
+    std::vector<uint8_t> alive;
+    size_t removedCount = 0;
+
+    uint32_t getBucket(char16_t first, char16_t second, char16_t third) const;
+};
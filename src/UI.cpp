@@ -8,13 +8,21 @@
 #include <loguru.hpp>
 #include <optional>
 #include <sstream>
+#include <cstdio>
+#include <algorithm>
 #include <atomic>
+#include <filesystem>
 #include <thread>
 
 #include "UI.h"
 #include "YtxFile.h"
 #include "App;h"
 #include "Utils.h"
+#include "EntryFilter.h"
+#include "FilterWorker.h"
+#include "FolderSearch.h"
+#include "FileLoader.h"
+#include "TableIO.h"
 
 namespace UI
 {
@@ -24,7 +32,20 @@ namespace UI
 
     const int MAX_PATH = 256;
 
-    std::vector<Entry*> displayEntries = {};
+    // Entries shown in the table along with the section they belong to
+    std::vector<EntryFilter::Match> displayEntries = {};
+    // Copy of a string for its input box, reused by every row
+    std::string editBuffer;
+    // Entry being typed in, its edits are undone at once until its box loses focus
+    EntrySection* editingSection = nullptr;
+    EntryStore::Handle editingHandle = 0;
+    // Filters the entries on its own thread, displayEntries is swapped with its results once they are ready
+    FilterWorker filterWorker;
+    // Loads files on a thread of its own, they are only shown once fully loaded
+    FileLoader fileLoader;
+    // Searches every file of a folder on threads of its own, its results are added as they are found
+    FolderSearch folderSearch;
+    std::vector<FolderSearch::Result> folderSearchResults;
     std::vector<std::string> sectionOptions = {"All sections"};
     int selectedSection = 0;
 
@@ -33,6 +54,7 @@ namespace UI
     const int STRING_FILTER = 1;
     const int ADDRESS_FILTER = 2;
     int selectedFilter = STRING_FILTER;
+    bool filterIgnoreCase = false;
 
     SDL_Window* window;
     SDL_Renderer* renderer;
@@ -41,9 +63,13 @@ namespace UI
     std::string filePathBuffer;
 
     std::atomic<bool> isSavingFile = false;
-    std::atomic<bool> isLoadingFile = false;
+    // Snapshots written by the save thread, merged back into their files by finishSaving()
+    std::mutex savedSnapshotsMutex;
+    std::vector<std::unique_ptr<YtxFile::SaveSnapshot>> savedSnapshots;
+    int failedSaves = 0;
     bool isFileOpen = false;
     bool hasFailedToOpen = false;
+    int memoryBudgetMb = (int)(Workspace::DEFAULT_MEMORY_BUDGET / (1024 * 1024));
 
     namespace PopUp
     {
@@ -76,7 +102,7 @@ namespace UI
             {
                 if (!errorMessage.empty())
                 {
-                    ImGui::TextColored(ImVec4(1, 0, 0, 1), errorMessage.c_str());
+                    ImGui::TextColored(ImVec4(1, 0, 0, 1), "%s", errorMessage.c_str());
                 }
             }
 
@@ -95,6 +121,12 @@ namespace UI
                 errorMessage.clear();
             }
         }
+
+        namespace SearchFolder
+        {
+            std::string folderBuffer;
+            std::string queryBuffer;
+        }
     };
 
     int init()
@@ -164,22 +196,43 @@ namespace UI
             }
 
             renderPopUpAddEntry();
+            renderPopUpFolderSearch();
             renderMessagePopUp();
 
-            if (ImGui::Button("Load file") && !isLoadingFile)
+            if (ImGui::Button("Load file"))
             {
                 loadFileButton();
             }
 
+            ImGui::SameLine();
+            if (ImGui::Button("Search Folder"))
+            {
+                ImGui::OpenPopup("Search folder");
+            }
+
+            takeLoadedFile();
+            finishSaving();
+            updateSearchIndex();
+            App::workspace.syncJournals();
             if (hasFailedToOpen)
             {
                 PopUp::Message::newPopUp("Error", "Failed to open file: Invalid path.");
                 hasFailedToOpen = false;
             }
             
-            if (isLoadingFile)
+            if (fileLoader.isLoading())
             {
-                ImGui::Text("Loading file ...");
+                const YtxFile::LoadProgress& progress = fileLoader.getProgress();
+                size_t total = progress.total;
+                float fraction = total == 0 ? 0.0f : std::min(1.0f, (float)progress.done / total);
+                ImGui::Text("Loading file: %s ...", YtxFile::getLoadStageName(progress.stage));
+                ImGui::SameLine();
+                ImGui::ProgressBar(fraction, ImVec2(WINDOW_WIDTH * 0.2f, 0));
+                ImGui::SameLine();
+                if (ImGui::Button("Cancel##loading"))
+                {
+                    fileLoader.cancel();
+                }
             }
 
             if (isSavingFile)
@@ -187,14 +240,26 @@ namespace UI
                 ImGui::Text("Saving file ...");
             }
 
-            if (isFileOpen && !isLoadingFile && !isSavingFile)
+            // The file shown stays usable while another one loads and while files are saved
+            if (isFileOpen)
             {
-                ImGui::SameLine();
-                if (ImGui::Button("Save Changes"))
+                if (!isSavingFile)
                 {
-                    saveFileButton();
+                    ImGui::SameLine();
+                    if (ImGui::Button("Save Changes"))
+                    {
+                        saveFileButton();
+                    }
+
+                    ImGui::SameLine();
+                    if (ImGui::Button("Save All"))
+                    {
+                        saveAllButton();
+                    }
                 }
 
+                renderDocumentTabs();
+
                 renderFilterBox();
                 renderSectionSelect();
 
@@ -204,6 +269,37 @@ namespace UI
                     ImGui::OpenPopup("Add a new entry");
                 }
 
+                // Text boxes undo their own typing while they have focus
+                bool isTyping = ImGui::GetIO().WantTextInput;
+                ImGui::SameLine();
+                ImGui::BeginDisabled(!App::file->canUndo());
+                if (ImGui::Button("Undo") || (!isTyping && ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Z)))
+                {
+                    undoButton();
+                }
+                ImGui::EndDisabled();
+
+                ImGui::SameLine();
+                ImGui::BeginDisabled(!App::file->canRedo());
+                if (ImGui::Button("Redo") || (!isTyping && (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Y) ||
+                                                            ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiMod_Shift | ImGuiKey_Z))))
+                {
+                    redoButton();
+                }
+                ImGui::EndDisabled();
+
+                ImGui::SameLine();
+                if (ImGui::Button("Export"))
+                {
+                    exportButton();
+                }
+
+                ImGui::SameLine();
+                if (ImGui::Button("Import"))
+                {
+                    importButton();
+                }
+
                 renderTable();
             }
 
@@ -228,6 +324,10 @@ namespace UI
         const int COLUMNS_COUNT = 4;
         const char* headers[] = {"ID", "String", "Address"};
 
+        // The filter worker reads the entries while the table is not drawn
+        std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+        filterWorker.takeResults(displayEntries);
+
         if (ImGui::BeginTable("main_table",
                               COLUMNS_COUNT,
                               ImGuiTableFlags_Resizable | ImGuiTableFlags_Reorderable | ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg,
@@ -240,8 +340,6 @@ namespace UI
 
             ImGui::TableHeadersRow();
 
-            int selectedId = std::stoul(sectionOptions.at(selectedSection), nullptr, 16);
-
             ImGuiListClipper clipper;
             clipper.Begin(displayEntries.size());
 
@@ -249,33 +347,47 @@ namespace UI
             {
                 for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
                 {
-                    Entry* entry = displayEntries.at(row);
+                    EntrySection* section = displayEntries.at(row).section;
+                    uint32_t entryRow = section->entries.getRow(displayEntries.at(row).handle);
                     ImGui::TableNextRow();
+                    if (entryRow == EntryStore::NO_ROW)
+                    {
+                        // Removed since the filter ran
+                        continue;
+                    }
 
                     // Row Index
+                    // Numbers are formatted by ImGui into its own buffer, nothing is allocated per row
                     ImGui::TableSetColumnIndex(0);
-                    ImGui::Text(std::to_string(row + 1).c_str());
+                    ImGui::Text("%d", row + 1);
 
                     // String ID
-                    std::stringstream stringId;
-                    stringId << std::hex << entry->id;
-
                     ImGui::TableSetColumnIndex(1);
-                    ImGui::Text(stringId.str().c_str());
+                    ImGui::Text("%x", (unsigned int)section->entries.getId(entryRow));
 
                     // String
                     ImGui::TableSetColumnIndex(2);
                     ImGui::SetNextItemWidth(-FLT_MIN);
                     ImGui::PushID(row);
-                    ImGui::InputText("##", &entry->_string);
+                    editBuffer.assign(section->entries.getString(entryRow));
+                    if (ImGui::InputText("##", &editBuffer))
+                    {
+                        EntryStore::Handle handle = displayEntries.at(row).handle;
+                        bool merge = editingSection == section && editingHandle == handle;
+                        App::file->setEntryString(*section, entryRow, editBuffer, merge);
+                        editingSection = section;
+                        editingHandle = handle;
+                        filterWorker.invalidate();
+                    }
+                    if (ImGui::IsItemDeactivated())
+                    {
+                        editingSection = nullptr;
+                    }
                     ImGui::PopID();
 
                     // Address
-                    std::stringstream address;
-                    address << std::hex << entry->stringAddress;
-
                     ImGui::TableSetColumnIndex(3);
-                    ImGui::Text(address.str().c_str());
+                    ImGui::Text("%x", (unsigned int)section->entries.getStringAddress(entryRow));
                 }
             }
 
@@ -283,6 +395,64 @@ namespace UI
         }
     }
 
+    void renderDocumentTabs()
+    {
+        std::string openPath;
+        std::string closePath;
+
+        if (ImGui::BeginTabBar("documents", ImGuiTabBarFlags_Reorderable | ImGuiTabBarFlags_FittingPolicyScroll))
+        {
+            for (const Workspace::Document& document : App::workspace.getDocuments())
+            {
+                bool isActive = document.file.get() == App::file;
+
+                // The tab of the file shown always stays selected, clicking another one opens its file
+                ImGuiTabItemFlags flags = isActive ? ImGuiTabItemFlags_SetSelected : ImGuiTabItemFlags_None;
+                if (document.file && document.file->hasUnsavedChanges())
+                {
+                    flags |= ImGuiTabItemFlags_UnsavedDocument;
+                }
+
+                // The path keeps tabs of files sharing a name apart
+                std::string label = document.name + "###" + document.path;
+                bool open = true;
+                if (ImGui::BeginTabItem(label.c_str(), &open, flags))
+                {
+                    ImGui::EndTabItem();
+                }
+                if (ImGui::IsItemClicked() && !isActive)
+                {
+                    openPath = document.path;
+                }
+                if (!open)
+                {
+                    closePath = document.path;
+                }
+            }
+            ImGui::EndTabBar();
+        }
+
+        ImGui::Text("Memory: %.1f MB, budget:", App::workspace.getMemoryUsage() / (1024.0 * 1024.0));
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(WINDOW_WIDTH * 0.1f);
+        if (ImGui::InputInt("MB##memory_budget", &memoryBudgetMb, 64, 256))
+        {
+            memoryBudgetMb = std::max(memoryBudgetMb, 16);
+            std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+            App::workspace.setMemoryBudget((size_t)memoryBudgetMb * 1024 * 1024);
+        }
+
+        // Documents are only changed once they are no longer being drawn
+        if (!closePath.empty())
+        {
+            closeDocument(closePath);
+        }
+        else if (!openPath.empty())
+        {
+            openDocument(openPath);
+        }
+    }
+
     void renderSectionSelect()
     {
         if (!isFileOpen)
@@ -332,16 +502,30 @@ namespace UI
                 if (ImGui::Selectable(filterOptions.at(i).c_str()))
                 {
                     selectedFilter = i;
+                    updateDisplayEntries();
                 }
                 
             }
             ImGui::EndCombo();
         }
         
-        if (ImGui::InputText("##filter", &filterBuffer))
+        const char* filterHint = selectedFilter == STRING_FILTER ? "" : "Hex prefix or range: 1f, 100-1ff";
+        if (ImGui::InputTextWithHint("##filter", filterHint, &filterBuffer))
+        {
+            updateDisplayEntries();
+        }
+
+        ImGui::SameLine();
+        if (ImGui::Checkbox("Ignore case", &filterIgnoreCase))
         {
             updateDisplayEntries();
         }
+
+        if (filterWorker.isBusy())
+        {
+            ImGui::SameLine();
+            ImGui::Text("Filtering ...");
+        }
     }
 
     void renderPopUpAddEntry()
@@ -365,6 +549,19 @@ namespace UI
             // Prevent ID from being over 4 bytes
             PopUp::AddEntry::entryIdBuffer.resize(8);
         }
+        ImGui::SameLine();
+        if (ImGui::Button("Free ID") && PopUp::AddEntry::selectedSection != 0)
+        {
+            int sectionId = std::stoul(sectionOptions.at(PopUp::AddEntry::selectedSection), nullptr, 16);
+            std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+            std::optional<int> entryId = App::file->getFreeEntryId(sectionId);
+            if (entryId)
+            {
+                std::stringstream stringId;
+                stringId << std::hex << *entryId;
+                PopUp::AddEntry::entryIdBuffer = stringId.str();
+            }
+        }
 
         ImGui::Text("Section:");
         if (ImGui::BeginCombo("##section_popup", sectionOptions.at(PopUp::AddEntry::selectedSection).c_str()))
@@ -409,76 +606,140 @@ namespace UI
         ImGui::EndPopup();
     }
 
-    void updateDisplayEntries()
+    void renderPopUpFolderSearch()
     {
-        displayEntries.clear();
+        ImGui::SetNextWindowSize(ImVec2(WINDOW_WIDTH * 0.8f, WINDOW_HEIGHT * 0.8f));
+        if (!ImGui::BeginPopupModal("Search folder", NULL))
+        {
+            return;
+        }
+
+        ImGui::Text("Folder:");
+        ImGui::InputText("##folder_popup", &PopUp::SearchFolder::folderBuffer);
+        ImGui::SameLine();
+        if (ImGui::Button("Browse##folder_popup"))
+        {
+            getFolderPath(PopUp::SearchFolder::folderBuffer);
+        }
 
-        // All sections
-        if (selectedSection == 0)
+        ImGui::Text("String:");
+        bool submitted = ImGui::InputText("##query_popup", &PopUp::SearchFolder::queryBuffer, ImGuiInputTextFlags_EnterReturnsTrue);
+        ImGui::SameLine();
+        if ((ImGui::Button("Search") || submitted) &&
+            !PopUp::SearchFolder::folderBuffer.empty() && !PopUp::SearchFolder::queryBuffer.empty())
         {
-            for (EntrySection& section : App::file->entrySections)
+            folderSearchResults.clear();
+            folderSearch.start(PopUp::SearchFolder::folderBuffer, PopUp::SearchFolder::queryBuffer);
+        }
+
+        if (folderSearch.isRunning())
+        {
+            ImGui::SameLine();
+            if (ImGui::Button("Stop"))
             {
-                for (Entry &entry : section.entries)
-                {
-                    if (isEntryDisplayed(entry))
-                    {
-                        displayEntries.push_back(&entry);
-                    }
-                }
+                folderSearch.cancel();
             }
         }
-        else
+
+        folderSearch.takeResults(folderSearchResults);
+        ImGui::Text("%zu results, %zu of %zu files searched (%.1f MB)%s",
+                    folderSearchResults.size(), folderSearch.getFilesSearched(), folderSearch.getFilesFound(),
+                    folderSearch.getBytesSearched() / (1024.0 * 1024.0), folderSearch.isRunning() ? " ..." : "");
+        if (folderSearch.isTruncated())
         {
-            int selectedSectionId = std::stoul(sectionOptions.at(selectedSection), nullptr, 16);
-            for (EntrySection& section : App::file->entrySections)
+            ImGui::TextColored(ImVec4(1, 0, 0, 1), "Only the first %zu results are shown.", FolderSearch::MAX_RESULTS);
+        }
+
+        const FolderSearch::Result* openResult = nullptr;
+        if (ImGui::BeginTable("folder_search_table",
+                              4,
+                              ImGuiTableFlags_Resizable | ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg,
+                              ImVec2(0, WINDOW_HEIGHT * 0.5f)))
+        {
+            ImGui::TableSetupColumn("File", ImGuiTableColumnFlags_WidthStretch, 0.2f);
+            ImGui::TableSetupColumn("Section", ImGuiTableColumnFlags_WidthStretch, 0.1f);
+            ImGui::TableSetupColumn("ID", ImGuiTableColumnFlags_WidthStretch, 0.1f);
+            ImGui::TableSetupColumn("String");
+            ImGui::TableHeadersRow();
+
+            ImGuiListClipper clipper;
+            clipper.Begin(folderSearchResults.size());
+
+            while (clipper.Step())
             {
-                if (section.id == selectedSectionId)
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
                 {
-                    for (Entry &entry : section.entries)
+                    const FolderSearch::Result& result = folderSearchResults.at(row);
+                    ImGui::TableNextRow();
+
+                    // Clicking anywhere on the row opens the entry
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::PushID(row);
+                    std::string name = std::filesystem::path(result.path).filename().string();
+                    if (ImGui::Selectable(name.c_str(), false, ImGuiSelectableFlags_SpanAllColumns))
+                    {
+                        openResult = &result;
+                    }
+                    if (ImGui::IsItemHovered())
                     {
-                        if (isEntryDisplayed(entry))
-                        {
-                            displayEntries.push_back(&entry);
-                        }
+                        ImGui::SetTooltip("%s", result.path.c_str());
                     }
-                    break;
+                    ImGui::PopID();
+
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%x", (unsigned int)result.sectionId);
+
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%x", (unsigned int)result.entryId);
+
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::TextUnformatted(result._string.c_str());
                 }
             }
+
+            ImGui::EndTable();
         }
-        
-    }
 
-    bool isEntryDisplayed(Entry entry)
-    {
-        if (filterBuffer.size() == 0)
+        if (openResult != nullptr)
         {
-            return true;
+            // The entry is shown alone by filtering the file on its ID
+            char idRange[32];
+            std::snprintf(idRange, sizeof(idRange), "%x-%x", (unsigned int)openResult->entryId, (unsigned int)openResult->entryId);
+            selectedFilter = ID_FILTER;
+            filterBuffer = idRange;
+            if (isFileOpen && App::file->comparePath(openResult->path))
+            {
+                updateDisplayEntries();
+            }
+            else
+            {
+                openDocument(openResult->path);
+            }
+            ImGui::CloseCurrentPopup();
         }
 
-        size_t filterString = std::string::npos;
-        switch (selectedFilter)
-        {
-        case ID_FILTER:
+        if (ImGui::Button("Close"))
         {
-            std::stringstream compareString;
-            compareString << std::hex << entry.id;
-            filterString = compareString.str().find(filterBuffer);
-            break;
+            ImGui::CloseCurrentPopup();
         }
-        case STRING_FILTER:
-            filterString = entry._string.find(filterBuffer);
-            break;
 
-        case ADDRESS_FILTER:
+        ImGui::EndPopup();
+    }
+
+    void updateDisplayEntries()
+    {
+        std::optional<int> sectionId;
+        if (selectedSection != 0)
         {
-            std::stringstream compareString;
-            compareString << std::hex << entry.stringAddress;
-            filterString = compareString.str().find(filterBuffer);
-            break;
-        }
+            sectionId = (int)std::stoul(sectionOptions.at(selectedSection), nullptr, 16);
         }
 
-        return filterString != std::string::npos;
+        filterWorker.submit({App::file, sectionId, (EntryFilter::Field)selectedFilter, filterBuffer, filterIgnoreCase});
+    }
+
+    bool isEntryDisplayed(EntrySection& section, size_t row)
+    {
+        return EntryFilter::matches(section.entries, row, (EntryFilter::Field)selectedFilter, filterBuffer);
     }
 
     void getFilePath(std::string& buffer)
@@ -501,25 +762,143 @@ namespace UI
         }
     }
 
-    void loadFile(std::string path)
+    void getFolderPath(std::string& buffer)
     {
-        selectedSection = 0;
-        sectionOptions.resize(1);
+        NFD_Init();
 
-        App::file.emplace(path);
-        App::file->load();
+        char *outPath;
+        nfdresult_t result = NFD_PickFolderU8(&outPath, NULL);
 
-        if (App::file->isValid())
+        if (result == NFD_OKAY)
         {
-            updateDisplayEntries();
-            isFileOpen = true;
+            buffer = outPath;
+            NFD_FreePathU8(outPath);
+        }
+
+        NFD_Quit();
+    }
+
+    void getTablePath(std::string& buffer, bool save)
+    {
+        NFD_Init();
+
+        char *outPath;
+        nfdu8filteritem_t filters[1] = {{"Tables", "tsv,csv,jsonl,po"}};
+        nfdresult_t result;
+        if (save)
+        {
+            std::string defaultName = App::file->getName() + ".csv";
+            result = NFD_SaveDialogU8(&outPath, filters, 1, NULL, defaultName.c_str());
         }
         else
+        {
+            nfdopendialogu8args_t args = {};
+            args.filterList = filters;
+            args.filterCount = 1;
+            result = NFD_OpenDialogU8_With(&outPath, &args);
+        }
+
+        if (result == NFD_OKAY)
+        {
+            buffer = outPath;
+            NFD_FreePathU8(outPath);
+        }
+
+        NFD_Quit();
+    }
+
+    void showFile(YtxFile* file)
+    {
+        {
+            // Results of the previous file point to its entries
+            std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+            filterWorker.cancel();
+            displayEntries.clear();
+            App::file = file;
+            editingSection = nullptr;
+        }
+
+        selectedSection = 0;
+        sectionOptions.resize(1);
+        isFileOpen = true;
+        updateDisplayEntries();
+    }
+
+    void takeLoadedFile()
+    {
+        // The previous file stays shown if the new one could not be opened
+        if (fileLoader.takeFailure())
         {
             hasFailedToOpen = true;
-            isFileOpen = false;
         }
-        isLoadingFile = false;
+
+        std::unique_ptr<YtxFile> file = fileLoader.takeFile();
+        if (!file)
+        {
+            return;
+        }
+
+        YtxFile* added;
+        {
+            // Adding a file may evict the others, the shown one included, so the filter must not be reading it
+            std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+            filterWorker.cancel();
+            added = App::workspace.add(std::move(file));
+        }
+        showFile(added);
+
+        size_t recovered = added->takeRecoveredChanges();
+        if (recovered > 0)
+        {
+            PopUp::Message::newPopUp("Edits recovered", "Recovered " + std::to_string(recovered) +
+                                                            " unsaved edit(s) of " + added->getName() + " from its journal.");
+        }
+    }
+
+    void openDocument(std::string path)
+    {
+        // Files that are already loaded are shown right away, the others once they are fully loaded
+        YtxFile* file = App::workspace.find(path);
+        if (file == nullptr)
+        {
+            fileLoader.start(path);
+        }
+        else if (file != App::file)
+        {
+            showFile(file);
+        }
+    }
+
+    void closeDocument(std::string path)
+    {
+        const std::vector<Workspace::Document>& documents = App::workspace.getDocuments();
+        bool isActive = App::file != nullptr && App::file->comparePath(path);
+        {
+            std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+            if (!App::workspace.close(path))
+            {
+                PopUp::Message::newPopUp("Unsaved changes", "Save the changes of the file before closing it.");
+                return;
+            }
+
+            if (isActive)
+            {
+                filterWorker.cancel();
+                displayEntries.clear();
+                App::file = nullptr;
+                isFileOpen = false;
+            }
+        }
+
+        // Show the most recently used of the other files
+        if (isActive && !documents.empty())
+        {
+            auto next = std::max_element(documents.begin(), documents.end(),
+                                         [](const Workspace::Document& a, const Workspace::Document& b) {
+                                             return a.lastUsed < b.lastUsed;
+                                         });
+            openDocument(next->path);
+        }
     }
 
     void loadFileButton()
@@ -532,44 +911,199 @@ namespace UI
             return;
         }
 
-        if (isFileOpen)
+        // Prevent opening the file that's already shown
+        if (isFileOpen && App::file->comparePath(filePathBuffer))
+        {
+            return;
+        }
+
+        openDocument(filePathBuffer);
+    }
+
+    void saveFiles(std::vector<std::unique_ptr<YtxFile::SaveSnapshot>> snapshots)
+    {
+        int failed = Workspace::writeSnapshots(snapshots);
+
+        std::lock_guard<std::mutex> lock(savedSnapshotsMutex);
+        savedSnapshots = std::move(snapshots);
+        failedSaves = failed;
+    }
+
+    void startSaving(std::vector<std::unique_ptr<YtxFile::SaveSnapshot>> snapshots)
+    {
+        if (snapshots.empty())
+        {
+            return;
+        }
+
+        isSavingFile = true;
+        std::thread saveFileThread(saveFiles, std::move(snapshots));
+        saveFileThread.detach();
+    }
+
+    void finishSaving()
+    {
+        std::vector<std::unique_ptr<YtxFile::SaveSnapshot>> snapshots;
+        int failed;
         {
-            // Prevent opening a file that's already open file
-            if (!(App::file->comparePath(filePathBuffer)))
+            std::lock_guard<std::mutex> lock(savedSnapshotsMutex);
+            if (savedSnapshots.empty())
             {
-                isLoadingFile = true;
+                return;
+            }
+            snapshots.swap(savedSnapshots);
+            failed = failedSaves;
+        }
+
+        {
+            std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+            failed += App::workspace.finishSaves(snapshots);
+            // Saved entries may have new addresses
+            filterWorker.invalidate();
+        }
+        isSavingFile = false;
 
-                std::thread loadFileThread(loadFile, filePathBuffer);
-                loadFileThread.detach();
+        if (failed > 0)
+        {
+            PopUp::Message::newPopUp("Error", "Failed to save " + std::to_string(failed) + " file(s), see the log for details.");
+        }
+    }
+
+    void saveFileButton()
+    {
+        // Only the snapshot is taken here, the file keeps being editable while it is written
+        std::vector<std::unique_ptr<YtxFile::SaveSnapshot>> snapshots;
+        {
+            std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+            if (App::file->hasUnsavedChanges())
+            {
+                snapshots.push_back(App::file->createSaveSnapshot());
             }
+        }
+        startSaving(std::move(snapshots));
+    }
+
+    void saveAllButton()
+    {
+        std::vector<std::unique_ptr<YtxFile::SaveSnapshot>> snapshots;
+        {
+            std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+            snapshots = App::workspace.snapshotChanges();
+        }
+        startSaving(std::move(snapshots));
+    }
+
+    void updateSearchIndex()
+    {
+        // The entries are only locked once there is an index to swap in
+        if (App::file == nullptr || !App::file->isSearchIndexRebuilt())
+        {
             return;
         }
 
-        isLoadingFile = true;
+        std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+        if (App::file->updateSearchIndex())
+        {
+            // Every entry has a new search ID
+            filterWorker.invalidate();
+        }
+    }
 
-        std::thread loadFileThread(loadFile, filePathBuffer);
-        loadFileThread.detach();
+    void undoButton()
+    {
+        std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+        if (App::file->undo())
+        {
+            // Entries added back get new handles, the filter finds them again
+            filterWorker.invalidate();
+        }
+        editingSection = nullptr;
     }
 
-    void saveFile()
+    void redoButton()
     {
-        App::file->saveChanges();
-        isSavingFile = false;
+        std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+        if (App::file->redo())
+        {
+            filterWorker.invalidate();
+        }
+        editingSection = nullptr;
     }
 
-    void saveFileButton()
+    void exportButton()
     {
-        isSavingFile = true;
+        std::string path;
+        getTablePath(path, true);
+        if (path.empty())
+        {
+            return;
+        }
 
-        std::thread saveFileThread(saveFile);
-        saveFileThread.detach();
+        std::optional<TableIO::Format> format = TableIO::getFormat(path);
+        if (!format)
+        {
+            PopUp::Message::newPopUp("Error", "Tables must end in .tsv, .csv, .jsonl or .po.");
+            return;
+        }
+
+        bool exported;
+        {
+            std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+            exported = TableIO::exportFile(*App::file, path, *format);
+        }
+        if (!exported)
+        {
+            PopUp::Message::newPopUp("Error", "Failed to write " + path + ".");
+        }
+    }
+
+    void importButton()
+    {
+        std::string path;
+        getTablePath(path, false);
+        if (path.empty())
+        {
+            return;
+        }
+
+        std::optional<TableIO::Format> format = TableIO::getFormat(path);
+        if (!format)
+        {
+            PopUp::Message::newPopUp("Error", "Tables must end in .tsv, .csv, .jsonl or .po.");
+            return;
+        }
+
+        TableIO::ImportResult result;
+        {
+            // The whole import is undone at once
+            std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
+            App::file->beginChange();
+            result = TableIO::importFile(*App::file, path, *format);
+            App::file->endChange();
+            if (result.changed > 0)
+            {
+                filterWorker.invalidate();
+            }
+        }
+
+        if (!result.ok)
+        {
+            PopUp::Message::newPopUp("Error", "Failed to import: " + result.error);
+            return;
+        }
+        PopUp::Message::newPopUp("Import", std::to_string(result.changed) + " of " + std::to_string(result.rows) +
+                                               " entries changed, " + std::to_string(result.notFound) +
+                                               " not found in the file.");
     }
 
     bool addEntryButton(std::string _string, int entryId, int sectionId)
     {
+        std::unique_lock<std::mutex> entriesLock = filterWorker.lockEntries();
         int result = App::file->addEntry(_string, entryId, sectionId);
         if (result == 0)
         {
+            // Displayed entries are kept by handle and stay valid, the filter only has to run again
+            filterWorker.invalidate();
             return true;
         }
 
@@ -590,7 +1124,7 @@ namespace UI
 
     void fillSectionOptions()
     {
-        for (EntrySection section : App::file->entrySections)
+        for (const EntrySection& section : App::file->entrySections)
         {
             std::stringstream sstream;
             sstream << std::hex << section.id;
@@ -603,7 +1137,7 @@ namespace UI
     {
         if (ImGui::BeginPopupModal(PopUp::Message::title.c_str(), NULL, ImGuiWindowFlags_AlwaysAutoResize))
         {
-            ImGui::Text(PopUp::Message::message.c_str());
+            ImGui::TextUnformatted(PopUp::Message::message.c_str());
             if (ImGui::Button("OK"))
             {
                 ImGui::CloseCurrentPopup();
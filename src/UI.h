@@ -16,20 +16,43 @@ namespace UI
 
     void renderLoop();
     void renderTable();
+    void renderDocumentTabs();
     void renderSectionSelect();
     void renderFilterBox();
     void renderPopUpAddEntry();
+    void renderPopUpFolderSearch();
     void renderMessagePopUp();
 
     void getFilePath(std::string &buffer);
+    void getFolderPath(std::string &buffer);
+    // Pick a table to export to("save") or import from
+    void getTablePath(std::string &buffer, bool save);
 
-    void loadFile(std::string path);
-    void saveFile();
+    // Show a file of the workspace
+    void showFile(YtxFile* file);
+    // Show the file the loader finished loading, if there is one
+    void takeLoadedFile();
+    // Write snapshots of files, run on a thread of its own
+    void saveFiles(std::vector<std::unique_ptr<YtxFile::SaveSnapshot>> snapshots);
+    void startSaving(std::vector<std::unique_ptr<YtxFile::SaveSnapshot>> snapshots);
+    // Merge the snapshots back into their files once they are written
+    void finishSaving();
+    // Swap in the search index of the shown file once it is rebuilt
+    void updateSearchIndex();
+    // Show a file, loading it on another thread first if it is not loaded
+    void openDocument(std::string path);
+    // Files with unsaved changes are not closed
+    void closeDocument(std::string path);
 
     void loadFileButton();
     void saveFileButton();
+    void saveAllButton();
+    void undoButton();
+    void redoButton();
+    void exportButton();
+    void importButton();
 
-    bool isEntryDisplayed(Entry entry);
+    bool isEntryDisplayed(EntrySection& section, size_t row);
 
     void updateDisplayEntries();
     void fillSectionOptions();
@@ -57,5 +80,11 @@ namespace UI
             void addError(std::string message);
             void reset();
         };
+
+        namespace SearchFolder
+        {
+            extern std::string folderBuffer;
+            extern std::string queryBuffer;
+        };
     };
 }
\ No newline at end of file
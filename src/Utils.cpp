@@ -1,41 +1,13 @@
 #include "Utils.h"
+#include "ByteStream.h"
+#include "Transcoder.h"
+#include "StringScanner.h"
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
-#include <locale>
-#include <codecvt>
 
 namespace Utils
 {
-    int bytesToIntBigEndian(std::vector<std::byte> bytes)
-    {
-        if (bytes.size() != 4)
-        {
-            return 0;
-        }
-
-        return 
-            std::to_integer<int>(bytes.at(0)) << 24 |
-            std::to_integer<int>(bytes.at(1)) << 16 |
-            std::to_integer<int>(bytes.at(2)) << 8 |
-            std::to_integer<int>(bytes.at(3));
-    }
-
-    std::vector<std::byte> intToByteBigEndian(int value)
-    {
-        std::vector<std::byte> result;
-        
-        result.push_back(std::byte((value & 0xFF000000) >> 24));
-        result.push_back(std::byte((value & 0x00FF0000) >> 16));
-        result.push_back(std::byte((value & 0x0000FF00) >> 8));
-        result.push_back(std::byte(value & 0x000000FF));
-
-        return result;
-    }
-
-    std::vector<std::byte> getIntegerFromBuffer(std::vector<std::byte> buffer, long offset)
-    {
-        return std::vector<std::byte>(buffer.begin() + offset, buffer.begin() + offset + 4);
-    }
-
     std::vector<std::string> splitString(std::string _string, std::string delimiter)
     {
         std::vector<std::string> result;
@@ -69,13 +41,23 @@ namespace Utils
 
     void ltrim(std::string& _string)
     {
-        int index = _string.find_first_not_of(" \t\n\r\f\v");
+        size_t index = _string.find_first_not_of(" \t\n\r\f\v");
+        if (index == std::string::npos)
+        {
+            _string.clear();
+            return;
+        }
         _string = _string.substr(index, _string.size() - index);
     }
 
     void rtrim(std::string& _string)
     {
-        int end = _string.find_last_not_of(" \t\n\r\f\v");
+        size_t end = _string.find_last_not_of(" \t\n\r\f\v");
+        if (end == std::string::npos)
+        {
+            _string.clear();
+            return;
+        }
         _string = _string.substr(0, end + 1);
     }
 
@@ -85,80 +67,160 @@ namespace Utils
         rtrim(_string);
     }
 
-    std::u16string readStringUtf16(std::vector<std::byte> buffer, long offset)
+    char toLowerAscii(char character)
+    {
+        return (character >= 'A' && character <= 'Z') ? (char)(character + ('a' - 'A')) : character;
+    }
+
+    size_t findIgnoreCaseAscii(std::string_view _string, std::string_view search)
+    {
+        auto found = std::search(_string.begin(), _string.end(), search.begin(), search.end(),
+                                 [](char a, char b) { return toLowerAscii(a) == toLowerAscii(b); });
+        return found == _string.end() && !search.empty() ? std::string::npos : (size_t)(found - _string.begin());
+    }
+
+    std::optional<std::span<const std::byte>> getStringBytesUtf16(std::span<const std::byte> buffer, long offset)
     {
-        if (buffer.size() <= offset)
+        if (offset < 0 || buffer.size() <= (size_t)offset)
         {
-            return nullptr;
+            return std::nullopt;
         }
 
-        std::u16string result;
+        size_t end = StringScanner::findTerminatorUtf16(buffer, offset);
+        return buffer.subspan(offset, end - offset);
+    }
 
-        uint16_t utf16Char = (uint16_t)(buffer.at(offset) << 8 | buffer.at(offset + 1));
-        while (utf16Char != 0)
+    std::optional<std::u16string> readStringUtf16(std::span<const std::byte> buffer, long offset)
+    {
+        std::optional<std::span<const std::byte>> bytes = getStringBytesUtf16(buffer, offset);
+        if (!bytes)
         {
-            result.push_back(utf16Char);
+            return std::nullopt;
+        }
 
-            offset += 2;
-            utf16Char = (uint16_t)(buffer.at(offset) << 8 | buffer.at(offset + 1));
+        // Copied in one go, then swapped to the machine's byte order
+        std::u16string result(bytes->size() / 2, u'\0');
+        const std::byte* source = bytes->data();
+        for (size_t index = 0; index < result.size(); index++)
+        {
+            result[index] = ByteStream::load<char16_t, std::endian::big>(source + index * 2);
         }
 
         return result;
     }
 
-    int getIntValueFromBuffer(std::vector<std::byte> buffer, long offset)
+    std::string convertUtf16ToUtf8(std::u16string_view sourceString)
     {
-        return bytesToIntBigEndian(getIntegerFromBuffer(buffer, offset));
+        std::string result;
+        Transcoder::utf16ToUtf8(sourceString, result);
+        return result;
     }
 
-    std::string convertUtf16ToUtf8(std::u16string sourceString)
+    std::u16string convertUtf8ToUtf16(std::string_view sourceString)
     {
-        std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
-        return convert.to_bytes(sourceString);
+        std::u16string result;
+        Transcoder::utf8ToUtf16(sourceString, result);
+        return result;
     }
-
-    std::u16string convertUtf8ToUtf16(std::string sourceString)
+    
+    int getStringSizeUtf16(size_t length)
     {
-        std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
-        return convert.from_bytes(sourceString);
+        // Null terminator
+        size_t size = (length + 1) * 2;
+
+        // Every string's size must be divisible by 4
+        if (size % 4 != 0)
+        {
+            size += 2;
+        }
+
+        return (int)size;
     }
-    
-    std::vector<std::byte> stringToBytes(std::u16string _string)
+
+    namespace
     {
-        std::vector<std::byte> result;
-        for (char16_t _char : _string)
+        const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+        const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+        const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+        const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+        const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+        inline uint64_t rotateLeft(uint64_t value, int count)
         {
-            result.push_back(std::byte((_char & 0xFF00) >> 8));
-            result.push_back(std::byte(_char & 0x00FF));
+            return (value << count) | (value >> (64 - count));
         }
-        // Null terminator
-        result.push_back(std::byte(0));
-        result.push_back(std::byte(0));
 
-        // Everu string's size must be divisible by 4
-        if (result.size() % 4 != 0)
+        inline uint64_t hashRound(uint64_t accumulator, uint64_t input)
         {
-            result.push_back(std::byte(0));
-            result.push_back(std::byte(0));
+            accumulator += input * PRIME64_2;
+            accumulator = rotateLeft(accumulator, 31);
+            return accumulator * PRIME64_1;
         }
 
-        return result;
+        inline uint64_t mergeRound(uint64_t accumulator, uint64_t value)
+        {
+            accumulator ^= hashRound(0, value);
+            return accumulator * PRIME64_1 + PRIME64_4;
+        }
     }
 
-    void writeIntToBuffer(std::vector<std::byte> &buffer, unsigned int value, int offset)
+    uint64_t hashBytes(std::span<const std::byte> bytes, uint64_t seed)
     {
-        if (offset > buffer.size())
+        const std::byte* data = bytes.data();
+        size_t length = bytes.size();
+        size_t index = 0;
+
+        uint64_t hash;
+        if (length >= 32)
         {
-            return;
+            // Four independent lanes so the multiplications of a block can overlap
+            uint64_t lane1 = seed + PRIME64_1 + PRIME64_2;
+            uint64_t lane2 = seed + PRIME64_2;
+            uint64_t lane3 = seed;
+            uint64_t lane4 = seed - PRIME64_1;
+            for (; index + 32 <= length; index += 32)
+            {
+                lane1 = hashRound(lane1, ByteStream::load<uint64_t, std::endian::little>(data + index));
+                lane2 = hashRound(lane2, ByteStream::load<uint64_t, std::endian::little>(data + index + 8));
+                lane3 = hashRound(lane3, ByteStream::load<uint64_t, std::endian::little>(data + index + 16));
+                lane4 = hashRound(lane4, ByteStream::load<uint64_t, std::endian::little>(data + index + 24));
+            }
+
+            hash = rotateLeft(lane1, 1) + rotateLeft(lane2, 7) + rotateLeft(lane3, 12) + rotateLeft(lane4, 18);
+            hash = mergeRound(hash, lane1);
+            hash = mergeRound(hash, lane2);
+            hash = mergeRound(hash, lane3);
+            hash = mergeRound(hash, lane4);
         }
-        
-        std::vector<std::byte> valueBytes = intToByteBigEndian(value);
-        if (offset == buffer.size())
+        else
         {
-            buffer.insert(buffer.end(), valueBytes.begin(), valueBytes.end());
-            return;
+            hash = seed + PRIME64_5;
+        }
+        hash += length;
+
+        for (; index + 8 <= length; index += 8)
+        {
+            hash ^= hashRound(0, ByteStream::load<uint64_t, std::endian::little>(data + index));
+            hash = rotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+        }
+        if (index + 4 <= length)
+        {
+            hash ^= ByteStream::load<uint32_t, std::endian::little>(data + index) * PRIME64_1;
+            hash = rotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+            index += 4;
+        }
+        for (; index < length; index++)
+        {
+            hash ^= std::to_integer<uint64_t>(data[index]) * PRIME64_5;
+            hash = rotateLeft(hash, 11) * PRIME64_1;
         }
 
-        std::copy(valueBytes.begin(), valueBytes.end(), (buffer.begin() + offset));
+        // Final mix so every input bit affects every output bit
+        hash ^= hash >> 33;
+        hash *= PRIME64_2;
+        hash ^= hash >> 29;
+        hash *= PRIME64_3;
+        hash ^= hash >> 32;
+        return hash;
     }
-}
\ No newline at end of file
+}
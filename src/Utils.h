@@ -1,45 +1,53 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
 #include <vector>
 #include <string>
+#include <string_view>
 
 namespace Utils
 {
-    // Convert 4 bytes to integer in big endian
-    int bytesToIntBigEndian(std::vector<std::byte> value);
-
-    // Convert an integer to 4 bytes in big endian
-    std::vector<std::byte> intToByteBigEndian(int value);
-
-    // Retrieve a 4-byte value from a buffer at a given offset
-    std::vector<std::byte> getIntegerFromBuffer(std::vector<std::byte> buffer, long offset);
-
     // Just a regular split function for strings
     std::vector<std::string> splitString(std::string _string, std::string delimiter = " ");
 
     // Replace all ocurrences of "from" with "to" in a given string
     void replaceAll(std::string& _string, std::string from, std::string to);
 
+    // Lowercase ASCII letters, every other byte is left as is
+    char toLowerAscii(char character);
+    // Find "search" in a string ignoring the case of ASCII letters
+    // Returns std::string::npos if it is not found
+    size_t findIgnoreCaseAscii(std::string_view _string, std::string_view search);
+
     // Trim whitespaces
     void ltrim(std::string& _string); // Left
     void rtrim(std::string& _string); // RIght
     void trim(std::string& _string); // Left and Right
 
-    // Read a UTF-16 string from a buffer at a given offset
-    std::u16string readStringUtf16(std::vector<std::byte> buffer, long offset);
+    // Get the bytes of a UTF-16 string from a buffer at a given offset, without the null terminator
+    // The result stops at the end of the buffer if no null terminator is found
+    // Returns std::nullopt if offset is outside the buffer
+    std::optional<std::span<const std::byte>> getStringBytesUtf16(std::span<const std::byte> buffer, long offset);
 
-    // Same as getIntegerFromBuffer but returns an integer right away instead of bytes
-    int getIntValueFromBuffer(std::vector<std::byte> buffer, long offset);
+    // Read a big endian UTF-16 string from a buffer at a given offset
+    // Reading stops at the null terminator or at the end of the buffer, whichever comes first
+    // Returns std::nullopt if offset is outside the buffer
+    std::optional<std::u16string> readStringUtf16(std::span<const std::byte> buffer, long offset);
 
     // Convert a UTF-16 string to UTF-8
-    std::string convertUtf16ToUtf8(std::u16string _string);
+    // Invalid characters are replaced with U+FFFD, see Transcoder for error reporting
+    std::string convertUtf16ToUtf8(std::u16string_view _string);
     // Convert a UTF-8 string to UTF-16
-    std::u16string convertUtf8ToUtf16(std::string _string);
+    // Invalid characters are replaced with U+FFFD, see Transcoder for error reporting
+    std::u16string convertUtf8ToUtf16(std::string_view _string);
 
-    // Convert a string to bytes as UTF-16 and make its size in bytes divisible by 4(required in .ytx files)
-    std::vector<std::byte> stringToBytes(std::u16string _string);
+    // Size in bytes of a UTF-16 string of "length" code units once written to a file:
+    // null terminated and padded so it is divisible by 4(required in .ytx files)
+    int getStringSizeUtf16(size_t length);
 
-    // Write an integer to a buffer in big endian given an offset
-    void writeIntToBuffer(std::vector<std::byte> &buffer, unsigned int value, int offset);
-    
+    // 64 bit XXH64 hash of a block of bytes, used to tell file contents apart
+    uint64_t hashBytes(std::span<const std::byte> bytes, uint64_t seed = 0);
 }
\ No newline at end of file
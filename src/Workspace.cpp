@@ -0,0 +1,264 @@
+#include "Workspace.h"
+#include "ThreadPool.h"
+#include <loguru.hpp>
+#include <algorithm>
+#include <atomic>
+
+YtxFile* Workspace::open(const std::string& path)
+{
+    YtxFile* file = find(path);
+    if (file != nullptr)
+    {
+        return file;
+    }
+
+    std::unique_ptr<YtxFile> loaded = loadFile(path);
+    return loaded ? add(std::move(loaded)) : nullptr;
+}
+
+YtxFile* Workspace::find(const std::string& path)
+{
+    size_t index = findDocument(path);
+    if (index == documents.size() || !documents[index].file)
+    {
+        return nullptr;
+    }
+
+    documents[index].lastUsed = ++useCounter;
+    return documents[index].file.get();
+}
+
+YtxFile* Workspace::add(std::unique_ptr<YtxFile> file)
+{
+    size_t index = findDocument(file->getPath());
+    if (index == documents.size())
+    {
+        documents.push_back(Document{file->getPath(), file->getName(), nullptr, 0, 0});
+    }
+    else if (!documents[index].file)
+    {
+        LOG_F(INFO, "Loading evicted file again: %s", file->getName().c_str());
+    }
+
+    Document& document = documents[index];
+    if (!document.file)
+    {
+        document.file = std::move(file);
+    }
+    document.lastUsed = ++useCounter;
+    trim();
+    return document.file.get();
+}
+
+std::unique_ptr<YtxFile> Workspace::loadFile(const std::string& path, YtxFile::LoadProgress* progress)
+{
+    std::unique_ptr<YtxFile> file = std::make_unique<YtxFile>(path);
+    file->load(true, progress);
+    if (!file->isValid())
+    {
+        return nullptr;
+    }
+
+    // Built while the file is loading so typing in the filter box never waits for it
+    if (!file->buildSearchIndex(progress))
+    {
+        return nullptr;
+    }
+
+    // Edits that were not saved when the editor last stopped are applied again
+    file->openJournal(progress);
+    return file;
+}
+
+bool Workspace::close(const std::string& path, bool discardChanges)
+{
+    size_t index = findDocument(path);
+    if (index == documents.size())
+    {
+        return false;
+    }
+
+    Document& document = documents[index];
+    if (document.file && document.file->hasUnsavedChanges() && !discardChanges)
+    {
+        LOG_F(WARNING, "Not closing file with unsaved changes: %s", document.name.c_str());
+        return false;
+    }
+
+    if (document.file && discardChanges)
+    {
+        document.file->discardJournal();
+    }
+
+    memoryUsage -= document.memoryUsage;
+    documents.erase(documents.begin() + index);
+    return true;
+}
+
+const std::vector<Workspace::Document>& Workspace::getDocuments() const
+{
+    return documents;
+}
+
+void Workspace::setMemoryBudget(size_t bytes)
+{
+    memoryBudget = bytes;
+    trim();
+}
+
+size_t Workspace::getMemoryBudget() const
+{
+    return memoryBudget;
+}
+
+size_t Workspace::getMemoryUsage() const
+{
+    return memoryUsage;
+}
+
+void Workspace::trim()
+{
+    memoryUsage = 0;
+    uint64_t mostRecent = 0;
+    for (Document& document : documents)
+    {
+        document.memoryUsage = document.file ? document.file->getMemoryUsage() : 0;
+        memoryUsage += document.memoryUsage;
+        if (document.file)
+        {
+            mostRecent = std::max(mostRecent, document.lastUsed);
+        }
+    }
+
+    while (memoryUsage > memoryBudget)
+    {
+        Document* oldest = nullptr;
+        for (Document& document : documents)
+        {
+            if (document.file && document.lastUsed != mostRecent && !document.file->hasUnsavedChanges() &&
+                (oldest == nullptr || document.lastUsed < oldest->lastUsed))
+            {
+                oldest = &document;
+            }
+        }
+
+        if (oldest == nullptr)
+        {
+            // Everything left is in use or has unsaved changes
+            break;
+        }
+
+        LOG_F(INFO, "Evicting file: %s; Memory: %zu bytes", oldest->name.c_str(), oldest->memoryUsage);
+        memoryUsage -= oldest->memoryUsage;
+        oldest->memoryUsage = 0;
+        oldest->file.reset();
+    }
+}
+
+bool Workspace::hasUnsavedChanges()
+{
+    for (Document& document : documents)
+    {
+        if (document.file && document.file->hasUnsavedChanges())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Workspace::syncJournals(bool force)
+{
+    for (Document& document : documents)
+    {
+        if (document.file)
+        {
+            document.file->syncJournal(force);
+        }
+    }
+}
+
+int Workspace::saveAll()
+{
+    std::vector<std::unique_ptr<YtxFile::SaveSnapshot>> snapshots = snapshotChanges();
+    int failed = writeSnapshots(snapshots);
+    failed += finishSaves(snapshots);
+    return failed;
+}
+
+std::vector<std::unique_ptr<YtxFile::SaveSnapshot>> Workspace::snapshotChanges()
+{
+    std::vector<std::unique_ptr<YtxFile::SaveSnapshot>> snapshots;
+    for (Document& document : documents)
+    {
+        if (document.file && document.file->hasUnsavedChanges())
+        {
+            snapshots.push_back(document.file->createSaveSnapshot());
+        }
+    }
+    return snapshots;
+}
+
+int Workspace::writeSnapshots(std::vector<std::unique_ptr<YtxFile::SaveSnapshot>>& snapshots)
+{
+    if (snapshots.empty())
+    {
+        return 0;
+    }
+
+    // Snapshots don't share anything, each one is written by a single task
+    std::atomic<int> failed = 0;
+    {
+        ThreadPool pool(std::min(snapshots.size(), ThreadPool::getDefaultThreadCount()));
+        for (std::unique_ptr<YtxFile::SaveSnapshot>& snapshot : snapshots)
+        {
+            pool.submit([&snapshot, &failed] {
+                if (!YtxFile::writeSnapshot(*snapshot))
+                {
+                    failed++;
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    LOG_F(INFO, "Saved %d files, %d failed", (int)snapshots.size() - failed.load(), failed.load());
+    return failed;
+}
+
+int Workspace::finishSaves(std::vector<std::unique_ptr<YtxFile::SaveSnapshot>>& snapshots)
+{
+    int failed = 0;
+    for (std::unique_ptr<YtxFile::SaveSnapshot>& snapshot : snapshots)
+    {
+        bool written = snapshot->saved;
+        size_t index = findDocument(snapshot->path);
+        if (index < documents.size() && documents[index].file)
+        {
+            documents[index].file->finishSave(*snapshot);
+        }
+        else if (written && !snapshot->writtenPath.empty())
+        {
+            // Closed while it was saved, nothing maps it anymore
+            snapshot->saved = YtxFile::moveSavedFile(*snapshot);
+        }
+        failed += written && !snapshot->saved ? 1 : 0;
+    }
+    trim();
+    return failed;
+}
+
+size_t Workspace::findDocument(const std::string& path)
+{
+    // Cleans the path the same way the paths of the documents were
+    std::string cleanedPath = path;
+    YtxFile::cleanPath(cleanedPath);
+    for (size_t i = 0; i < documents.size(); i++)
+    {
+        if (documents[i].path == cleanedPath)
+        {
+            return i;
+        }
+    }
+    return documents.size();
+}
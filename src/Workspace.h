@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "YtxFile.h"
+
+// Files open in the editor at the same time, so switching between the files of a localization
+// doesn't parse them again. Once the loaded files use more memory than the budget, the least
+// recently used ones are evicted: their tab stays and they are loaded again when opened.
+// Files with unsaved changes and the most recently used file are never evicted.
+class Workspace
+{
+public:
+    struct Document
+    {
+        std::string path;
+        std::string name;
+        // nullptr while the file is evicted
+        std::unique_ptr<YtxFile> file;
+        // Memory used by the file when the documents were last trimmed
+        size_t memoryUsage = 0;
+        uint64_t lastUsed = 0;
+    };
+
+    const static size_t DEFAULT_MEMORY_BUDGET = 512 * 1024 * 1024;
+
+    // Get a file, loading it if it is not open or was evicted, and mark it as the most recently used
+    // Returns nullptr, without adding a document, if the file could not be loaded
+    YtxFile* open(const std::string& path);
+    // Get a file only if it is loaded, marking it as the most recently used
+    YtxFile* find(const std::string& path);
+    // Take a file loaded with loadFile() and mark it as the most recently used
+    // A copy of the file that is already loaded is kept instead of "file"
+    YtxFile* add(std::unique_ptr<YtxFile> file);
+
+    // Load a file, build its search index and recover its unsaved edits without adding it, can be called from any thread
+    // Returns nullptr if the file could not be loaded or the load was stopped through "progress"
+    static std::unique_ptr<YtxFile> loadFile(const std::string& path, YtxFile::LoadProgress* progress = nullptr);
+    // Returns false if the file is not open, or has unsaved changes and "discardChanges" is false
+    // Discarded changes are removed from the journal of the file too
+    bool close(const std::string& path, bool discardChanges = false);
+    // In the order the files were first opened
+    const std::vector<Document>& getDocuments() const;
+
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const;
+    // Memory used by the loaded files when the documents were last trimmed
+    size_t getMemoryUsage() const;
+    // Measure the loaded files and evict the least recently used ones until they fit in the budget
+    void trim();
+
+    bool hasUnsavedChanges();
+    // Sync the journals of the loaded files, see YtxFile::syncJournal()
+    void syncJournals(bool force = false);
+    // Save every file with unsaved changes, several at once
+    // Returns the amount of files that could not be saved
+    int saveAll();
+
+    // saveAll() in three steps, so the files can keep being edited while they are written:
+    // take a snapshot of every file with unsaved changes, write them on any thread, then merge them back
+    std::vector<std::unique_ptr<YtxFile::SaveSnapshot>> snapshotChanges();
+    // Returns the amount of snapshots that could not be saved
+    static int writeSnapshots(std::vector<std::unique_ptr<YtxFile::SaveSnapshot>>& snapshots);
+    // Merge the snapshots into their files, files that were closed since are skipped
+    // Returns the amount of files that were written but could not replace the original
+    int finishSaves(std::vector<std::unique_ptr<YtxFile::SaveSnapshot>>& snapshots);
+
+private:
+    std::vector<Document> documents;
+    size_t memoryBudget = DEFAULT_MEMORY_BUDGET;
+    size_t memoryUsage = 0;
+    uint64_t useCounter = 0;
+
+    // Returns documents.size() if the file is not open
+    size_t findDocument(const std::string& path);
+};
@@ -1,13 +1,61 @@
-#include <fstream>
 #include <vector>
 #include <filesystem>
 #include "YtxFile.h"
 #include "Utils.h"
+#include "ByteStream.h"
+#include "Transcoder.h"
+#include "StringScanner.h"
+#include "FileIO.h"
+#include "BackupStore.h"
 #include <loguru.hpp>
+#include <climits>
 #include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace
+{
+    // Entries or strings handled between two checks of the stop token
+    const size_t LOAD_CHUNK_SIZE = 65536;
+
+    // "YTXU", starts the file holding the bytes a patch overwrites
+    const uint32_t UNDO_MAGIC = 0x59545855;
+    // Magic, size of the file and amount of patches
+    const size_t UNDO_HEADER_SIZE = 16;
+    // Offset and size before the bytes of every patch
+    const size_t UNDO_PATCH_SIZE = 12;
+    // Hash of everything before it
+    const size_t UNDO_TRAILER_SIZE = 8;
+    const char* UNDO_EXTENSION = ".undo";
+
+#ifdef _WIN32
+    // Windows can't replace a file while a view of it is mapped, so the file a save writes only replaces
+    // the original in finishSave(), once the views are closed
+    const bool REPLACE_UNMAPPED = true;
+#else
+    const bool REPLACE_UNMAPPED = false;
+#endif
+
+    void setStage(YtxFile::LoadProgress* progress, YtxFile::LoadStage stage, size_t total = 0)
+    {
+        if (progress != nullptr)
+        {
+            progress->done = 0;
+            progress->total = total;
+            progress->stage = stage;
+        }
+    }
+
+    bool isStopped(YtxFile::LoadProgress* progress)
+    {
+        return progress != nullptr && progress->stopToken.stop_requested();
+    }
+}
 
 YtxFile::YtxFile(std::string _path)
-    : buffer{},
+    : header{},
       hasBackup(false),
       valid(false)
 {
@@ -23,7 +71,10 @@ YtxFile::YtxFile(std::string _path)
 
     valid = true;
 }
-YtxFile::~YtxFile() {}
+YtxFile::~YtxFile()
+{
+    cancelSearchIndexRebuild();
+}
 
 bool YtxFile::comparePath(std::string compare)
 {
@@ -40,12 +91,162 @@ void YtxFile::cleanPath(std::string& _path)
     Utils::replaceAll(_path, "\"", "");
 }
 
+const char* YtxFile::getLoadStageName(LoadStage stage)
+{
+    switch (stage)
+    {
+    case LoadStage::MAPPING:
+        return "Mapping file";
+    case LoadStage::HEADER:
+        return "Reading header";
+    case LoadStage::SECTIONS:
+        return "Reading sections";
+    case LoadStage::ENTRIES:
+        return "Reading entries";
+    case LoadStage::BACKUP:
+        return "Backing up";
+    case LoadStage::INDEXING:
+        return "Indexing strings";
+    case LoadStage::RECOVERING:
+        return "Recovering edits";
+    case LoadStage::DONE:
+        return "Done";
+    }
+    return "";
+}
+
 bool YtxFile::isValid()
 {
     return valid;
 }
 
-void YtxFile::load()
+const std::string& YtxFile::getPath()
+{
+    return path;
+}
+
+const std::string& YtxFile::getName()
+{
+    return name;
+}
+
+size_t YtxFile::getSize()
+{
+    return data.size();
+}
+
+std::vector<std::string> YtxFile::verify()
+{
+    std::vector<std::string> problems;
+    char message[256];
+    if (!valid)
+    {
+        problems.push_back("File could not be loaded");
+        return problems;
+    }
+
+    // Strings are checked without keeping them decoded
+    std::string decoded;
+    for (EntrySection& section : entrySections)
+    {
+        for (size_t row = 0; row < section.entries.size(); row++)
+        {
+            if (section.entries.isDecoded(row))
+            {
+                continue;
+            }
+
+            decoded.clear();
+            Transcoder::Result result = Transcoder::utf16BeToUtf8(section.entries.getRawString(row), decoded);
+            if (!result.ok())
+            {
+                std::snprintf(message, sizeof(message), "Entry %x of section %x: %s at character %d",
+                              section.entries.getId(row), section.id, Transcoder::getErrorName(result.error), (int)result.position);
+                problems.push_back(message);
+            }
+        }
+    }
+
+    // Sections, their strings and POF0 are expected to follow each other, every string in a slot of its own
+    // as the slots are on disk
+    long expectedAddress = entrySections.empty() ? (long)Offset::ENTRY_SECTIONS_INFO - 0x20 : entrySections.at(0).address;
+    std::vector<int> slotsSizes;
+    std::vector<std::pair<long, uint32_t>> strings;
+    for (size_t sectionIndex = 0; sectionIndex < entrySections.size(); sectionIndex++)
+    {
+        EntrySection& section = entrySections[sectionIndex];
+        EntryStore& entries = section.entries;
+        if (section.address != expectedAddress)
+        {
+            std::snprintf(message, sizeof(message), "Section %x at 0x%x, expected at 0x%lx",
+                          section.id, section.address, expectedAddress);
+            problems.push_back(message);
+        }
+
+        // Up to the next section or POF0
+        long stringsStart = section.address + 0x20L + (long)entries.size() * ENTRY_SIZE;
+        long stringsEnd = sectionIndex + 1 < entrySections.size() ? entrySections[sectionIndex + 1].address + 0x20L
+                                                                   : pofoAddress + 0x20L;
+        strings.clear();
+        for (size_t row = 0; row < entries.size(); row++)
+        {
+            strings.push_back({entries.getStringAddress(row) + 0x20L, (uint32_t)row});
+        }
+        std::sort(strings.begin(), strings.end());
+
+        long slotsSize = 0;
+        long previousEnd = stringsStart;
+        int previousId = 0;
+        for (size_t i = 0; i < strings.size(); i++)
+        {
+            auto [start, row] = strings[i];
+            long end = start + entries.getSlotSize(row);
+            if (start < stringsStart || end > stringsEnd)
+            {
+                std::snprintf(message, sizeof(message), "String of entry %x of section %x at 0x%lx is outside of its section",
+                              entries.getId(row), section.id, start - 0x20);
+                problems.push_back(message);
+                continue;
+            }
+            if (i > 0 && start < previousEnd)
+            {
+                std::snprintf(message, sizeof(message), "Strings of entries %x and %x of section %x overlap",
+                              previousId, entries.getId(row), section.id);
+                problems.push_back(message);
+            }
+
+            // Read from the file on disk, edits that were not saved are not in it
+            std::optional<std::span<const std::byte>> onDisk = Utils::getStringBytesUtf16(data, start);
+            if (!onDisk || start + (long)onDisk->size() + 2 > end)
+            {
+                std::snprintf(message, sizeof(message), "String of entry %x of section %x is not null terminated in its slot",
+                              entries.getId(row), section.id);
+                problems.push_back(message);
+            }
+
+            slotsSize += end - start;
+            previousEnd = std::max(previousEnd, end);
+            previousId = entries.getId(row);
+        }
+
+        slotsSizes.push_back((int)slotsSize);
+        expectedAddress = section.address + (long)entries.size() * ENTRY_SIZE + slotsSize;
+    }
+
+    if (pofoAddress != expectedAddress)
+    {
+        std::snprintf(message, sizeof(message), "POF0 at 0x%x, expected at 0x%lx", pofoAddress, expectedAddress);
+        problems.push_back(message);
+    }
+    if (buildPofo(entrySections, slotsSizes) != pofo)
+    {
+        problems.push_back("POF0 does not match the entry sections");
+    }
+
+    return problems;
+}
+
+void YtxFile::load(bool createBackup, LoadProgress* progress)
 {
     if (!valid)
     {
@@ -55,410 +256,1772 @@ void YtxFile::load()
     
 
     LOG_F(INFO, "Loading file: %s", path.c_str());
-    std::ifstream file(path, std::ios::binary);
+    setStage(progress, LoadStage::MAPPING);
+
+    // A save that stopped while patching the file is undone, its edits are still in the journal
+    std::string undoPath = getUndoPath(path);
+    std::error_code undoError;
+    if (createBackup && std::filesystem::exists(undoPath, undoError) && !rollBackPatch(path, undoPath))
+    {
+        LOG_F(ERROR, "Failed to undo an interrupted save, some strings may be from it: %s", path.c_str());
+    }
 
-    if (!file.good())
+    mapping = std::make_shared<MappedFile>();
+    if (!mapping->open(path))
     {
         LOG_F(ERROR, "Failed to open file: %s", path.c_str());
         valid = false;
         return;
     }
 
-    LOG_F(INFO, "File loaded: %s", name.c_str());
+    data = mapping->bytes();
+    LOG_F(INFO, "File mapped: %s; Size: 0x%x", name.c_str(), (int)data.size());
 
-    LOG_F(INFO, "Loading file into buffer: %s", name.c_str());
-    long size = std::filesystem::file_size(path);
-    buffer.resize(size);
+    // Every stage needs the one before it, the stop token is checked between them
+    setStage(progress, LoadStage::HEADER);
+    valid = !isStopped(progress) && loadHeaderValues() && loadPofo();
 
-    file.read(reinterpret_cast<char *>(buffer.data()), size);
-    LOG_F(INFO, "File loaded into buffer: %s", name.c_str());
+    setStage(progress, LoadStage::SECTIONS);
+    valid = valid && !isStopped(progress) && loadEntrySections();
+
+    size_t entriesCount = 0;
+    for (const EntrySection& section : entrySections)
+    {
+        entriesCount += std::max(section.entriesCount, 0);
+    }
+    setStage(progress, LoadStage::ENTRIES, entriesCount);
+    valid = valid && !isStopped(progress) && loadEntries(progress);
+
+    disjointSlots = valid && hasDisjointSlots();
+    if (valid && !disjointSlots)
+    {
+        LOG_F(WARNING, "Strings of the file overlap, it will be rewritten whole when saved: %s", name.c_str());
+    }
+
+    if (valid && createBackup)
+    {
+        setStage(progress, LoadStage::BACKUP);
+        backupFile();
+    }
 
-    LOG_F(INFO, "Closing file: %s", name.c_str());
-    file.close();
-    LOG_F(INFO, "File closed: %s", name.c_str());
+    if (isStopped(progress))
+    {
+        LOG_F(INFO, "Loading stopped: %s", path.c_str());
+        valid = false;
+    }
+}
 
-    loadHeaderValues();
-    loadPofo();
-    loadEntrySections();
-    loadEntries();
+bool YtxFile::getFileSpan(long offset, long size, std::span<const std::byte>& result)
+{
+    if (offset < 0 || size < 0 || offset > (long)data.size() || size > (long)data.size() - offset)
+    {
+        return false;
+    }
 
-    backupFile();
+    result = data.subspan(offset, size);
+    return true;
 }
 
-void YtxFile::loadHeaderValues()
+bool YtxFile::loadHeaderValues()
 {
     LOG_F(INFO, "Loading header values ...");
-    if (buffer.size() == 0)
+    if (data.size() == 0)
     {
         LOG_F(ERROR, "File was not properly loaded: Size = 0");
-        return;
+        return false;
     }
 
-    if (buffer.size() <= ((long)Offset::ENTRY_SECTIONS_COUNT + 4))
+    std::span<const std::byte> headerSpan;
+    if (!getFileSpan(0, (long)Offset::ENTRY_SECTIONS_INFO, headerSpan))
     {
         LOG_F(ERROR, "File is invalid or not compatible: Could not find Entry Sections count.");
-        return;
+        return false;
     }
 
+    // Only the header is kept in memory, everything after it is rebuilt when saving
+    header.assign(headerSpan.begin(), headerSpan.end());
+
+    ByteReader reader(headerSpan);
+
     LOG_F(INFO, "Loading entry sections count ...");
-    std::vector<std::byte> entrySectionsCountVec = Utils::getIntegerFromBuffer(buffer, (long)Offset::ENTRY_SECTIONS_COUNT);
-    entrySectionsCount = Utils::bytesToIntBigEndian(entrySectionsCountVec);
+    entrySectionsCount = reader.readAt<int32_t>((size_t)Offset::ENTRY_SECTIONS_COUNT);
     LOG_F(INFO, "Entry sections count loaded: %d", entrySectionsCount);
     
     LOG_F(INFO, "Loading POFO file address ...");
-    std::vector<std::byte> pofoAddressVec = Utils::getIntegerFromBuffer(buffer, (long)Offset::POFO_FILE_ADDRESS);
-    pofoAddress = Utils::bytesToIntBigEndian(pofoAddressVec);
+    pofoAddress = reader.readAt<int32_t>((size_t)Offset::POFO_FILE_ADDRESS);
     LOG_F(INFO, "POFO address loaded: 0x%x", pofoAddress);
 
     LOG_F(INFO, "Header values loaded.");
+    return true;
 }
 
-void YtxFile::loadPofo()
+bool YtxFile::loadPofo()
 {
     LOG_F(INFO, "Loading POFO file ...");
-    if (buffer.size() == 0)
-    {
-        LOG_F(ERROR, "File was not properly loaded. Size = 0");
-        return;
-    }
-
     if (pofoAddress <= 0)
     {
         LOG_F(ERROR, "Invalid POFO address: 0x%x. Unable to proceed.", pofoAddress);
-        return;
+        return false;
     }
 
-    if (buffer.size() <= pofoAddress)
+    std::span<const std::byte> pofoSpan;
+    if (!getFileSpan(pofoAddress + 0x20L, (long)data.size() - (pofoAddress + 0x20L), pofoSpan))
     {
         LOG_F(ERROR, "File is invalid or not compatible: POFO address not reached 0x%x", pofoAddress);
-        return;
+        return false;
     }
 
-    pofo = std::vector<std::byte>(buffer.begin() + pofoAddress + 0x20, buffer.end());
-    LOG_F(INFO, "POFO file loaded. Size: 0x%x", pofo.size());
+    pofo.assign(pofoSpan.begin(), pofoSpan.end());
+    LOG_F(INFO, "POFO file loaded. Size: 0x%x", (int)pofo.size());
+    return true;
 }
 
-void YtxFile::loadEntrySections()
+bool YtxFile::loadEntrySections()
 {
     LOG_F(INFO, "Loading entry sections ...");
-    for (int entrySectionIndex = 0; entrySectionIndex < entrySectionsCount; entrySectionIndex++)
+
+    std::span<const std::byte> sectionsInfo;
+    if (entrySectionsCount < 0 ||
+        !getFileSpan((long)Offset::ENTRY_SECTIONS_INFO, (long)entrySectionsCount * ENTRY_SECTION_INFO_SIZE, sectionsInfo))
     {
-        int bufferAddress = (int)Offset::ENTRY_SECTIONS_INFO + (entrySectionIndex * ENTRY_SECTION_INFO_SIZE);
+        LOG_F(ERROR, "File is invalid or not compatible: Entry sections info out of bounds: Count = %d", entrySectionsCount);
+        return false;
+    }
 
-        int id = Utils::getIntValueFromBuffer(buffer, bufferAddress);
-        int entriesCount = Utils::getIntValueFromBuffer(buffer, bufferAddress + 4);
-        int address = Utils::getIntValueFromBuffer(buffer, bufferAddress + 8);
+    ByteReader reader(sectionsInfo);
+    entrySections.reserve(entrySectionsCount);
+    sectionIndexes.clear();
+    sectionIndexes.reserve(entrySectionsCount);
+    for (int entrySectionIndex = 0; entrySectionIndex < entrySectionsCount; entrySectionIndex++)
+    {
+        int id = reader.read<int32_t>();
+        int entriesCount = reader.read<int32_t>();
+        int address = reader.read<int32_t>();
 
-        entrySections.push_back(EntrySection{id, entriesCount, address});
+        // Sections sharing an ID can only be found by the first one, as before
+        sectionIndexes.insert(id, (uint32_t)entrySections.size());
+        entrySections.push_back(EntrySection{id, entriesCount, address, EntryStore(), 0, IdMap(), 0});
         LOG_F(INFO, "Entry section loaded: ID = %x; Entries Count = %d; Address = 0x%x", id, entriesCount, address);
     }
     LOG_F(INFO, "All entry sections loaded.");
+    return true;
 }
 
-void YtxFile::loadEntries()
+bool YtxFile::loadEntries(LoadProgress* progress)
 {
+    // Strings of a section are stored between its entries and whatever comes next in the file
+    std::vector<long> boundaries = {pofoAddress + 0x20L, (long)data.size()};
+    for (EntrySection& section : entrySections)
+    {
+        boundaries.push_back(section.address + 0x20L);
+    }
+    std::sort(boundaries.begin(), boundaries.end());
+
+    StringTable strings;
     for (int sectionIndex = 0; sectionIndex < entrySections.size(); sectionIndex++)
     {
         EntrySection* section = &entrySections.at(sectionIndex);
-        int address = section->address + 0x20;
+        long address = section->address + 0x20L;
 
-        LOG_F(INFO, "Loading entries from 0x%x, Entry section ID = %x", address, section->id);
-        for (int entryIndex = 0; entryIndex < section->entriesCount; entryIndex++)
+        std::span<const std::byte> entriesTable;
+        if (section->entriesCount < 0 ||
+            !getFileSpan(address, (long)section->entriesCount * ENTRY_SIZE, entriesTable))
         {
-            int id = Utils::getIntValueFromBuffer(buffer, address + (entryIndex * ENTRY_SIZE));
-            int stringAddress = Utils::getIntValueFromBuffer(buffer, address + (entryIndex * ENTRY_SIZE) + 4) + 0x20;
-            std::u16string u16string = Utils::readStringUtf16(buffer, stringAddress);
-            std::string u8String = Utils::convertUtf16ToUtf8(u16string);
+            LOG_F(ERROR, "File is invalid or not compatible: Entries of section %x out of bounds: Address = 0x%x",
+                  section->id, (int)address);
+            return false;
+        }
 
-            Entry entry = {id, stringAddress, u8String};
-            section->entries.push_back(entry);
+        // All strings of the section are measured in a single pass
+        long stringsStart = address + entriesTable.size();
+        long stringsEnd = *std::upper_bound(boundaries.begin(), boundaries.end(), stringsStart - 1);
+        strings.scan(data.subspan(stringsStart, std::max(0L, stringsEnd - stringsStart)));
 
-            LOG_F(INFO, "Entry loaded: ID = %x, String address = 0x%x, String = %s", 
-                entry.id, 
-                entry.stringAddress, 
-                entry._string.c_str());
-        }
-        LOG_F(INFO, "All entries loaded.");
-    }
-}
+        LOG_F(INFO, "Loading entries from 0x%x, Entry section ID = %x", (int)address, section->id);
+        ByteReader reader(entriesTable);
+        section->entries.setSource(data);
+        section->entries.reserve(section->entriesCount);
+        for (int entryIndex = 0; entryIndex < section->entriesCount; entryIndex++)
+        {
+            if (progress != nullptr && (entryIndex + 1) % LOAD_CHUNK_SIZE == 0)
+            {
+                if (isStopped(progress))
+                {
+                    return false;
+                }
+                progress->done += LOAD_CHUNK_SIZE;
+            }
 
-void YtxFile::backupFile()
-{
-    LOG_F(INFO, "Creating a backup for file: %s", name.c_str());
+            int id = reader.read<int32_t>();
+            int stringAddress = reader.read<int32_t>();
+            long fileAddress = stringAddress + 0x20L;
+            if (stringAddress < 0 || fileAddress >= (long)data.size())
+            {
+                LOG_F(ERROR, "File is invalid or not compatible: String of entry %x out of bounds: Address = 0x%x",
+                      id, stringAddress);
+                return false;
+            }
 
-    std::ofstream out(path + ".backup", std::ios::binary);
-    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
-    out.close();
+            std::optional<std::span<const std::byte>> rawString = strings.getString(fileAddress - stringsStart);
+            if (!rawString)
+            {
+                // String stored outside of its section
+                rawString = Utils::getStringBytesUtf16(data, fileAddress);
+            }
 
-    hasBackup = true;
-    LOG_F(INFO, "Backup created at: %s", (path + ".backup").c_str());
+            // Strings are decoded later on, only when they are needed
+            int stringSize = Utils::getStringSizeUtf16(rawString->size() / 2);
+            section->entries.addRaw(id, stringAddress, (uint32_t)(rawString->data() - data.data()),
+                                    (uint32_t)rawString->size(), stringSize);
+            section->stringsSize += stringSize;
+        }
+        loadSlotSizes(section->entries, stringsStart, stringsEnd);
+        rebuildEntryIndexes(*section);
+        if (progress != nullptr)
+        {
+            progress->done += section->entriesCount % LOAD_CHUNK_SIZE;
+        }
+        LOG_F(INFO, "All entries loaded: Count = %d", section->entriesCount);
+    }
+    return true;
 }
 
-void YtxFile::saveFile()
+void YtxFile::loadSlotSizes(EntryStore& entries, long stringsStart, long stringsEnd)
 {
-    LOG_F(INFO, "Saving file: %s", name.c_str());
-    if (!hasBackup)
+    // A string saved in place keeps the slot of the longer string it replaced, padded with zeros, so the
+    // slot is the distance to the next string when only zeros are in between and the string size otherwise
+    stringsEnd = std::min(stringsEnd, (long)data.size());
+    std::vector<uint32_t> rows;
+    bool ordered = true;
+    for (size_t row = 1; row < entries.size() && ordered; row++)
     {
-        LOG_F(WARNING, "Saving file without a backup: %s", name.c_str());
+        ordered = entries.getStringAddress(row - 1) <= entries.getStringAddress(row);
+    }
+    if (!ordered)
+    {
+        rows.resize(entries.size());
+        for (size_t row = 0; row < rows.size(); row++)
+        {
+            rows[row] = (uint32_t)row;
+        }
+        std::sort(rows.begin(), rows.end(), [&entries](uint32_t a, uint32_t b) {
+            return entries.getStringAddress(a) < entries.getStringAddress(b);
+        });
     }
 
-    std::ofstream out(path, std::ios::binary);
-    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
-    out.close();
-
-    LOG_F(INFO, "File saved at: %s", path.c_str());
-}
+    // Walked backwards so the start of the next string is known, strings sharing an address share it too
+    long nextStart = stringsEnd;
+    long lastStart = stringsEnd;
+    for (size_t i = entries.size(); i-- > 0;)
+    {
+        size_t row = ordered ? i : rows[i];
+        long start = entries.getStringAddress(row) + 0x20L;
+        if (start < stringsStart || start >= stringsEnd)
+        {
+            // Stored outside of its section
+            continue;
+        }
+        if (start < lastStart)
+        {
+            nextStart = lastStart;
+            lastStart = start;
+        }
 
-void YtxFile::saveChanges()
-{
-    reassemble();
-    saveFile();
+        long slotSize = nextStart - start;
+        if (slotSize <= entries.getStringSize(row) || slotSize > INT_MAX)
+        {
+            continue;
+        }
+        long contentEnd = start + (long)entries.getRawString(row).size();
+        std::span<const std::byte> padding = data.subspan(contentEnd, nextStart - contentEnd);
+        if (std::all_of(padding.begin(), padding.end(), [](std::byte value) { return value == std::byte(0); }))
+        {
+            entries.setSlotSize(row, (int)slotSize);
+        }
+    }
 }
 
-void YtxFile::reassemble()
+void YtxFile::backupFile()
 {
-    LOG_F(INFO, "Reassembling file: %s", name.c_str());
-
-    buffer.resize(0x28);
-
-    rewriteEntrySectionsInfo();
-    rewriteEntrySections();
-    rewritePofo();
-
-    buffer.insert(buffer.end(), pofo.begin(), pofo.end());
+    LOG_F(INFO, "Creating a backup for file: %s", name.c_str());
 
-    LOG_F(INFO, "File reassembled: %s", name.c_str());
+    // Content that was already backed up is not stored again, so reopening a file is cheap
+    BackupStore backups;
+    hasBackup = backups.backup(path, data) != BackupStore::Method::NONE;
 }
 
-void YtxFile::rewriteEntrySectionsInfo()
+bool YtxFile::saveFile(SaveSnapshot& snapshot, size_t fileSize)
 {
-    LOG_F(INFO, "Rewriting entry sections info on buffer header.");
-    int sectionAddress = entrySections.at(0).address;
-    for (int sectionIndex = 0; sectionIndex < entrySections.size(); sectionIndex++)
+    LOG_F(INFO, "Saving file: %s; Size: 0x%x", snapshot.name.c_str(), (int)fileSize);
+    if (!snapshot.hasBackup)
     {
-        EntrySection* section = &entrySections.at(sectionIndex);
-
-        std::vector<std::byte> id = Utils::intToByteBigEndian(section->id);
-        buffer.insert(buffer.end(), id.begin(), id.end());
-
-        std::vector<std::byte> entriesCount = Utils::intToByteBigEndian(section->entriesCount);
-        buffer.insert(buffer.end(), entriesCount.begin(), entriesCount.end());
-
-        section->address = sectionAddress;
-        std::vector<std::byte> address = Utils::intToByteBigEndian(section->address);
-        buffer.insert(buffer.end(), address.begin(), address.end());
+        LOG_F(WARNING, "Saving file without a backup: %s", snapshot.name.c_str());
+    }
 
-        int stringBytes = getSectionStringsSize(sectionIndex);
-        sectionAddress += (section->entries.size() * ENTRY_SIZE) + stringBytes;
+    // The file is written next to the original and only replaces it once complete,
+    // so the original stays mapped and readable the whole time
+    FileIO::AtomicFileWriter out;
+    if (!out.open(snapshot.path, fileSize))
+    {
+        LOG_F(ERROR, "Failed to create a temporary file for: %s", snapshot.path.c_str());
+        return false;
     }
-    LOG_F(INFO, "Entry sections rewritten: Buffer size after entry sections info: 0x%x", buffer.size());
-}
 
-void YtxFile::rewriteEntrySections()
-{
-    // Rewriting entry sections
-    LOG_F(INFO, "Rewriting entry sections.");
+    out.write(snapshot.header);
+    writeEntrySectionsInfo(snapshot.sections, out);
+    writeEntrySections(snapshot.sections, out);
+    out.write(snapshot.pofo);
 
-    for (int sectionIndex = 0; sectionIndex < entrySections.size(); sectionIndex++)
+    if (!out.good() || out.position() != fileSize)
     {
-        EntrySection* section = &entrySections.at(sectionIndex);
-        LOG_F(INFO, "Rewriting entry section: ID = %x; Address = 0x%x", section->id, section->address);
+        LOG_F(ERROR, "File layout mismatch while saving: Written = 0x%x; Expected = 0x%x",
+              (int)out.position(), (int)fileSize);
+        out.abort();
+        return false;
+    }
 
-        int stringAddress = buffer.size() + (section->entriesCount * ENTRY_SIZE);
-        for (int entryIndex = 0; entryIndex < section->entries.size(); entryIndex++)
+    if (REPLACE_UNMAPPED)
+    {
+        if (!out.finish())
         {
-            Entry* entry = &section->entries.at(entryIndex);
-            entry->stringAddress = stringAddress - 0x20;
-
-            std::vector<std::byte> id = Utils::intToByteBigEndian(entry->id);
-            std::vector<std::byte> stringAddressBytes = Utils::intToByteBigEndian(entry->stringAddress);
-
-            buffer.insert(buffer.end(), id.begin(), id.end());
-            buffer.insert(buffer.end(), stringAddressBytes.begin(), stringAddressBytes.end());
-
-            int stringSize = getStringSize(entry->_string);
-            if (stringSize % 4 != 0)
-            {
-                LOG_F(WARNING,
-                      "String size is not divisible by 4: Section index: %d; Entry index: %d; String size: 0x%x",
-                      sectionIndex, entryIndex, stringSize);
-            }
-            stringAddress += stringSize;
+            LOG_F(ERROR, "Failed to write file: %s", snapshot.path.c_str());
+            return false;
         }
-        LOG_F(INFO, "Entry section rewritten: ID = %x; Buffer size = 0x%x", section->id, section->address, buffer.size());
-
-        LOG_F(INFO, "Rewriting strings from entry section: ID = %x", section->id);
-        for (int entryIndex = 0; entryIndex < section->entries.size(); entryIndex++)
-        {
-            Entry* entry = &section->entries.at(entryIndex);
-            LOG_F(INFO, "Rewriting entry: ID = 0x%x; Address = 0x%x; String = %s", entry->id, entry->stringAddress, entry->_string.c_str());
+        snapshot.writtenPath = out.getTempPath();
+        LOG_F(INFO, "File written at: %s", snapshot.writtenPath.c_str());
+        return true;
+    }
 
-            std::u16string u16String = Utils::convertUtf8ToUtf16(entry->_string);
-            std::vector<std::byte> stringBytes = Utils::stringToBytes(u16String);
-            
-            buffer.insert(buffer.end(), stringBytes.begin(), stringBytes.end());
-        }
-        LOG_F(INFO, "Strings rewritten from entry section: ID = %x; Buffer size = 0x%x", section->id, buffer.size());
+    if (!out.commit())
+    {
+        LOG_F(ERROR, "Failed to replace file: %s", snapshot.path.c_str());
+        return false;
     }
-    LOG_F(INFO, "Entry sections rewritten.");
+
+    LOG_F(INFO, "File saved at: %s", snapshot.path.c_str());
+    return true;
 }
 
-void YtxFile::rewritePofo()
+bool YtxFile::moveSavedFile(SaveSnapshot& snapshot)
 {
-    LOG_F(INFO, "Rewriting POF0 file.");
-    
-    pofo.clear();
-
-    // Update POFO's address at file header
-    pofoAddress = buffer.size() - 0x20;
-    Utils::writeIntToBuffer(buffer, pofoAddress, (int)Offset::POFO_FILE_ADDRESS);
-
-    // POFO Magic number
-    std::vector<std::byte> magic = {std::byte('P'), std::byte('O'), std::byte('F'), std::byte('0')};
-    pofo.insert(pofo.end(), magic.begin(), magic.end());
-
-    // Placeholder value for POFO size
-    Utils::writeIntToBuffer(pofo, 0, pofo.size());
-
-    std::vector<std::byte> sectionsInfo = {std::byte('A')};
-    for (int i = 0; i < entrySectionsCount; i++)
+    snapshot.mapping.reset();
+    bool moved = FileIO::replaceFile(snapshot.writtenPath, snapshot.path);
+    if (!moved)
+    {
+        LOG_F(ERROR, "Failed to replace file: %s", snapshot.path.c_str());
+        std::error_code error;
+        std::filesystem::remove(snapshot.writtenPath, error);
+    }
+    else
     {
-        sectionsInfo.push_back(std::byte('C'));
+        LOG_F(INFO, "File saved at: %s", snapshot.path.c_str());
     }
+    snapshot.writtenPath.clear();
+    return moved;
+}
 
-    pofo.insert(pofo.end(), sectionsInfo.begin(), sectionsInfo.end());
-    for (int sectionIndex = 0; sectionIndex < entrySectionsCount; sectionIndex++)
+bool YtxFile::replaceWithSavedFile(SaveSnapshot& snapshot)
+{
+    // The rebuilt search index, the snapshot and the file itself all map the file. Nothing reads the strings
+    // that were not decoded until remapFile() points them to the file on disk again
+    cancelSearchIndexRebuild();
+    mapping.reset();
+    data = {};
+    if (moveSavedFile(snapshot))
     {
-        EntrySection section = entrySections.at(sectionIndex);
+        return true;
+    }
 
-        std::vector<std::byte> entriesInfo;
-        int initialIndex = (sectionIndex > 0) ? 1 : 0;
-        for (int entry = initialIndex; entry < section.entriesCount; entry++)
+    // The strings were not saved, so they still are where they were in the original
+    remapFile();
+    return false;
+}
+
+void YtxFile::remapFile()
+{
+    std::shared_ptr<MappedFile> newMapping = std::make_shared<MappedFile>();
+    if (!newMapping->open(path))
+    {
+        if (mapping == nullptr)
         {
-            entriesInfo.push_back(std::byte('B'));
+            LOG_F(ERROR, "Failed to map saved file, its strings can no longer be read: %s", path.c_str());
+            valid = false;
+            return;
         }
-        pofo.insert(pofo.end(), entriesInfo.begin(), entriesInfo.end());
 
-        // Not the last section
-        if (sectionIndex < entrySectionsCount - 1)
+        // The previous mapping still holds the old version of the file, which the strings
+        // that were not decoded keep pointing to
+        LOG_F(WARNING, "Failed to map saved file, keeping the previous mapping: %s", path.c_str());
+        return;
+    }
+
+    std::span<const std::byte> newData = newMapping->bytes();
+    for (EntrySection& section : entrySections)
+    {
+        section.entries.setSource(newData);
+        for (size_t row = 0; row < section.entries.size(); row++)
         {
-            int stringsSize = getSectionStringsSize(sectionIndex);
-            int writeSize = stringsSize / 4;
-            if (writeSize < 0x7FFE)
-            {
-                unsigned int writeValue = writeSize + 0x8002;
-                std::vector<std::byte> writeValueBytes = {std::byte((writeValue & 0xFF00) >> 8), std::byte(writeValue & 0xFF)};
-                pofo.insert(pofo.end(), writeValueBytes.begin(), writeValueBytes.end());
-            }
-            else
+            if (!section.entries.isDecoded(row))
             {
-                unsigned int writeValue = writeSize + 0xC0000002;
-                Utils::writeIntToBuffer(pofo, writeValue, pofo.size());
+                section.entries.setRawOffset(row, section.entries.getStringAddress(row) + 0x20);
             }
         }
     }
-    // POF0 size without header
-    int pofoSize = pofo.size() - 8;
-    Utils::writeIntToBuffer(pofo, pofoSize, 4);
 
-    LOG_F(INFO, "POF0 file rewritten: Size: 0x%x", pofo.size());
+    mapping = std::move(newMapping);
+    data = newData;
 }
 
-int YtxFile::getStringSize(std::string _string)
+bool YtxFile::saveChanges(bool forceRewrite)
 {
-    return Utils::stringToBytes(Utils::convertUtf8ToUtf16(_string)).size();
+    std::unique_ptr<SaveSnapshot> snapshot = createSaveSnapshot(forceRewrite);
+    writeSnapshot(*snapshot);
+    finishSave(*snapshot);
+    return snapshot->saved;
 }
 
-int YtxFile::getSectionStringsSize(int sectionIndex)
+std::unique_ptr<YtxFile::SaveSnapshot> YtxFile::createSaveSnapshot(bool forceRewrite)
 {
-    EntrySection section = entrySections.at(sectionIndex);
+    std::unique_ptr<SaveSnapshot> snapshot = std::make_unique<SaveSnapshot>();
+    snapshot->path = path;
+    snapshot->name = name;
+    snapshot->hasBackup = hasBackup;
+    snapshot->rewrite = forceRewrite || !canPatchInPlace();
+    snapshot->header = header;
+    snapshot->pofo = pofo;
+    snapshot->pofoAddress = pofoAddress;
+    snapshot->mapping = mapping;
+    snapshot->layoutVersion = layoutVersion;
+    snapshot->hasJournal = journal.isOpen();
+    snapshot->journalPosition = journal.getPosition();
+
+    snapshot->sections.reserve(entrySections.size());
+    for (EntrySection& section : entrySections)
+    {
+        snapshot->sections.push_back(
+            EntrySection{section.id, section.entriesCount, section.address, section.entries.snapshot(), section.stringsSize,
+                         IdMap(), 0});
+    }
+    return snapshot;
+}
 
-    int sizeStrings = 0;
-    for (Entry entry : section.entries)
+bool YtxFile::writeSnapshot(SaveSnapshot& snapshot)
+{
+    if (!snapshot.rewrite)
     {
-        sizeStrings += getStringSize(entry._string);
+        snapshot.saved = patchChanges(snapshot);
+        if (snapshot.saved)
+        {
+            hashSavedFile(snapshot);
+            return true;
+        }
+        LOG_F(WARNING, "Failed to patch file, rewriting it instead: %s", snapshot.name.c_str());
+        snapshot.rewrite = true;
     }
 
-    if (sizeStrings % 4 != 0)
+    size_t fileSize = reassemble(snapshot);
+    snapshot.saved = saveFile(snapshot, fileSize);
+    if (!snapshot.saved)
     {
-        LOG_F(WARNING, "Size in bytes of strings not divisible by 4: Section index = %d; Size = 0x%x", sectionIndex, sizeStrings);
+        LOG_F(ERROR, "Failed to save file, the original was left untouched: %s", snapshot.path.c_str());
     }
-    
-    return sizeStrings;
+    hashSavedFile(snapshot);
+    return snapshot.saved;
 }
 
-int YtxFile::addEntry(std::string _string, int entryId, int sectionId)
+void YtxFile::hashSavedFile(SaveSnapshot& snapshot)
 {
-    LOG_F(INFO, "Adding new entry: String: %s; ID: %x; Entry Section ID: %x", _string.c_str(), entryId, sectionId);
-
-    EntrySection* targetEntry = findSection(sectionId);
-    if (targetEntry == nullptr)
+    if (!snapshot.saved || !snapshot.hasJournal)
     {
-        LOG_F(ERROR, "Failed to add new entry: Invalid section ID.");
-        return INVALID_SECTION_ID;
+        return;
     }
 
-    if (entryIdExists(entryId, *targetEntry))
+    // Done here rather than by finishSave() so the thread drawing the UI never reads the whole file
+    MappedFile saved;
+    if (!saved.open(snapshot.writtenPath.empty() ? snapshot.path : snapshot.writtenPath))
     {
-        LOG_F(ERROR, "Failed to add new entry: Entry ID %x already exists in Section %x.", entryId, sectionId);
-        return ENTRY_ID_TAKEN;
+        LOG_F(WARNING, "Failed to read saved file, its journal is kept as it was: %s", snapshot.path.c_str());
+        snapshot.hasJournal = false;
+        return;
     }
-
-    Entry entry = {entryId, 0, _string};
-    targetEntry->entries.push_back(entry);
-    targetEntry->entriesCount++;
-
-    LOG_F(INFO, "New entry added: String: %s; ID: %x; Entry Section ID: %x", _string.c_str(), entryId, sectionId);
-    return 0;
+    snapshot.savedSize = saved.size();
+    snapshot.savedHash = Utils::hashBytes(saved.bytes());
 }
 
-int YtxFile::removeEntry(int entryId, int sectionId)
+void YtxFile::finishSave(SaveSnapshot& snapshot)
 {
-    LOG_F(INFO, "Removing entry: ID: %x; Entry Section ID: %x", entryId, sectionId);
-
-    EntrySection* targetEntry = findSection(sectionId);
-    if (targetEntry == nullptr)
+    bool replaced = false;
+    if (snapshot.saved && !snapshot.writtenPath.empty())
     {
-        LOG_F(ERROR, "Failed to remove entry: Invalid section ID.");
-        return INVALID_SECTION_ID;
+        replaced = replaceWithSavedFile(snapshot);
+        snapshot.saved = replaced;
     }
 
-    for (int i = 0; i < targetEntry->entries.size(); i++)
+    // Addresses only change in the file when the snapshot was written to disk in full
+    bool rewritten = snapshot.saved && snapshot.rewrite;
+    stringsChanged = false;
+    for (size_t sectionIndex = 0; sectionIndex < entrySections.size(); sectionIndex++)
     {
-        if (targetEntry->entries.at(i).id == entryId)
+        EntrySection& section = entrySections[sectionIndex];
+        EntrySection& saved = snapshot.sections.at(sectionIndex);
+        if (section.entries.finishSave(saved.entries, snapshot.saved, rewritten))
         {
-            targetEntry->entries.erase(targetEntry->entries.begin() + i);
-            targetEntry->entriesCount--;
-
-            LOG_F(INFO, "Entry removed: ID: %x; Entry Section ID: %x", entryId, sectionId);
-            return 0;
+            stringsChanged = true;
         }
-    }
-
-    LOG_F(ERROR, "Failed to remove entry: Entry ID %x not found: Section ID: %x.", entryId, sectionId);
-    return INVALID_ENTRY_ID;
-}
-
-EntrySection* YtxFile::findSection(int id)
-{
-    for (EntrySection& section : entrySections)
-    {
-        if (section.id == id)
+        if (rewritten)
         {
-            return &section;
+            section.address = saved.address;
         }
     }
-    return nullptr;
-}
 
-bool YtxFile::entryIdExists(int entryId, EntrySection section)
-{
-    for (Entry entry : section.entries)
+    if (!snapshot.saved)
     {
-        if (entry.id == entryId)
+        return;
+    }
+
+    // Entries added or removed while saving still have to be laid out by the next save
+    savedLayoutVersion = snapshot.layoutVersion;
+    if (snapshot.hasJournal)
+    {
+        journal.checkpoint(snapshot.journalPosition, snapshot.savedSize, snapshot.savedHash);
+    }
+    if (rewritten)
+    {
+        // Laid out by the editor, every string has a slot of its own
+        disjointSlots = true;
+        header = std::move(snapshot.header);
+        pofo = std::move(snapshot.pofo);
+        pofoAddress = snapshot.pofoAddress;
+
+        // Strings that were never decoded are read from the new file from now on
+        remapFile();
+    }
+    if (replaced)
+    {
+        // Stopped while the file was replaced
+        compactSearchIndex();
+    }
+}
+
+bool YtxFile::hasUnsavedChanges()
+{
+    return layoutVersion != savedLayoutVersion || stringsChanged;
+}
+
+size_t YtxFile::getMemoryUsage()
+{
+    size_t usage = sizeof(YtxFile) + header.capacity() + pofo.capacity() +
+                   entrySections.capacity() * sizeof(EntrySection) +
+                   sectionIndexes.getMemoryUsage() +
+                   searchIndex.getMemoryUsage() + stringArena.getMemoryUsage() + journal.getMemoryUsage();
+    for (const EntrySection& section : entrySections)
+    {
+        usage += section.entries.getMemoryUsage() + section.entryIndexes.getMemoryUsage();
+    }
+    return usage;
+}
+
+bool YtxFile::hasDisjointSlots()
+{
+    // Files written by the editor hold the header, then every entries table followed by its strings,
+    // then the POFO, so they are checked in that order first and only sorted when they are not in it
+    auto forEachRegion = [this](auto&& visit) {
+        visit(0L, (long)Offset::ENTRY_SECTIONS_INFO + (long)entrySectionsCount * ENTRY_SECTION_INFO_SIZE);
+        for (const EntrySection& section : entrySections)
+        {
+            long tableStart = section.address + 0x20L;
+            visit(tableStart, tableStart + (long)section.entries.size() * ENTRY_SIZE);
+            for (size_t row = 0; row < section.entries.size(); row++)
+            {
+                long stringStart = section.entries.getStringAddress(row) + 0x20L;
+                visit(stringStart, stringStart + section.entries.getSlotSize(row));
+            }
+        }
+        visit(pofoAddress + 0x20L, (long)data.size());
+    };
+
+    long end = 0;
+    bool ordered = true;
+    forEachRegion([&](long start, long regionEnd) {
+        if (start < regionEnd)
+        {
+            ordered = ordered && start >= end;
+            end = regionEnd;
+        }
+    });
+    if (ordered)
+    {
+        return true;
+    }
+
+    std::vector<std::pair<long, long>> regions;
+    forEachRegion([&](long start, long regionEnd) {
+        if (start < regionEnd)
+        {
+            regions.push_back({start, regionEnd});
+        }
+    });
+    std::sort(regions.begin(), regions.end());
+    for (size_t i = 1; i < regions.size(); i++)
+    {
+        if (regions[i].first < regions[i - 1].second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool YtxFile::canPatchInPlace()
+{
+    if (layoutVersion != savedLayoutVersion || !disjointSlots)
+    {
+        return false;
+    }
+
+    // Writing into a file that shares its data with another hard link would change it too
+    if (FileIO::getLinkCount(path) > 1)
+    {
+        return false;
+    }
+
+    for (const EntrySection& section : entrySections)
+    {
+        for (size_t row = 0; row < section.entries.size(); row++)
+        {
+            if (section.entries.isDirty(row) && section.entries.getStringSize(row) > section.entries.getSlotSize(row))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool YtxFile::patchChanges(SaveSnapshot& snapshot)
+{
+    LOG_F(INFO, "Patching file in place: %s", snapshot.name.c_str());
+    if (!snapshot.hasBackup)
+    {
+        LOG_F(WARNING, "Saving file without a backup: %s", snapshot.name.c_str());
+    }
+
+    // Every edited string is written over its whole slot, so what is left of a longer
+    // previous string is cleared by the padding
+    std::vector<std::byte> bytes;
+    std::vector<std::pair<uint64_t, size_t>> slots;
+    for (EntrySection& section : snapshot.sections)
+    {
+        for (size_t row = 0; row < section.entries.size(); row++)
+        {
+            if (!section.entries.isDirty(row))
+            {
+                continue;
+            }
+
+            size_t start = bytes.size();
+            Transcoder::utf8ToUtf16Be(section.entries.getString(row), bytes);
+            bytes.resize(start + section.entries.getSlotSize(row), std::byte(0));
+            slots.push_back({section.entries.getStringAddress(row) + 0x20ULL, start});
+        }
+    }
+
+    if (slots.empty())
+    {
+        LOG_F(INFO, "No changes to save: %s", snapshot.name.c_str());
+        return true;
+    }
+
+    std::vector<FileIO::Patch> patches;
+    patches.reserve(slots.size());
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        size_t end = (i + 1 < slots.size()) ? slots.at(i + 1).second : bytes.size();
+        patches.push_back({slots.at(i).first, std::span<const std::byte>(bytes).subspan(slots.at(i).second, end - slots.at(i).second)});
+    }
+
+    // The bytes about to be overwritten are kept until the patch reached the disk, so a save that stops
+    // halfway is undone the next time the file is opened rather than leaving a mix of old and new strings
+    std::string undoPath = getUndoPath(snapshot.path);
+    if (!writeUndo(snapshot, patches, undoPath))
+    {
+        LOG_F(WARNING, "Failed to keep the strings a patch replaces: %s", undoPath.c_str());
+        return false;
+    }
+
+    if (!FileIO::patchFile(snapshot.path, patches))
+    {
+        if (!rollBackPatch(snapshot.path, undoPath))
+        {
+            LOG_F(ERROR, "Failed to undo a failed patch, it will be undone when the file is opened: %s",
+                  snapshot.path.c_str());
+        }
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::remove(undoPath, error);
+
+    LOG_F(INFO, "File patched: %s; Strings: %d; Bytes written: 0x%x", snapshot.name.c_str(), (int)patches.size(), (int)bytes.size());
+    return true;
+}
+
+std::string YtxFile::getUndoPath(const std::string& filePath)
+{
+    std::filesystem::path directory = BackupStore::getBackupDirectory(filePath);
+    return (directory / (std::filesystem::path(filePath).filename().string() + UNDO_EXTENSION)).string();
+}
+
+bool YtxFile::writeUndo(const SaveSnapshot& snapshot, std::span<const FileIO::Patch> patches, const std::string& undoPath)
+{
+    // The mapping shares its pages with the file, so it holds what is on disk right now
+    std::span<const std::byte> current = snapshot.mapping->bytes();
+    size_t size = UNDO_HEADER_SIZE + UNDO_TRAILER_SIZE;
+    for (const FileIO::Patch& patch : patches)
+    {
+        if (patch.offset > current.size() || patch.bytes.size() > current.size() - patch.offset)
+        {
+            return false;
+        }
+        size += UNDO_PATCH_SIZE + patch.bytes.size();
+    }
+
+    std::vector<std::byte> bytes(size);
+    ByteWriter writer(bytes);
+    writer.write<uint32_t>(UNDO_MAGIC);
+    writer.write<uint64_t>(current.size());
+    writer.write<uint32_t>((uint32_t)patches.size());
+    for (const FileIO::Patch& patch : patches)
+    {
+        writer.write<uint64_t>(patch.offset);
+        writer.write<uint32_t>((uint32_t)patch.bytes.size());
+        writer.writeBytes(current.subspan(patch.offset, patch.bytes.size()));
+    }
+    writer.write<uint64_t>(Utils::hashBytes(std::span<const std::byte>(bytes).first(size - UNDO_TRAILER_SIZE)));
+
+    std::error_code error;
+    std::filesystem::create_directories(BackupStore::getBackupDirectory(snapshot.path), error);
+    FileIO::AtomicFileWriter out;
+    if (!out.open(undoPath, size))
+    {
+        return false;
+    }
+    out.writeView(bytes);
+    return out.commit();
+}
+
+bool YtxFile::rollBackPatch(const std::string& filePath, const std::string& undoPath)
+{
+    std::vector<FileIO::Patch> patches;
+    MappedFile undo;
+    bool valid = undo.open(undoPath) && undo.size() >= UNDO_HEADER_SIZE + UNDO_TRAILER_SIZE;
+    std::error_code error;
+    if (valid)
+    {
+        std::span<const std::byte> bytes = undo.bytes();
+        size_t end = bytes.size() - UNDO_TRAILER_SIZE;
+        ByteReader reader(bytes.first(end));
+        valid = reader.read<uint32_t>() == UNDO_MAGIC &&
+                reader.read<uint64_t>() == std::filesystem::file_size(filePath, error) && !error &&
+                ByteReader(bytes).readAt<uint64_t>(end) == Utils::hashBytes(bytes.first(end));
+
+        uint32_t patchesCount = valid ? reader.read<uint32_t>() : 0;
+        for (uint32_t i = 0; valid && i < patchesCount; i++)
+        {
+            uint64_t offset = reader.read<uint64_t>();
+            std::span<const std::byte> original = reader.readBytes(reader.read<uint32_t>());
+            patches.push_back({offset, original});
+            valid = reader.good();
+        }
+        valid = valid && reader.remaining() == 0;
+    }
+
+    if (!valid)
+    {
+        // Written in one go, so it can only be damaged by something else
+        LOG_F(WARNING, "Ignoring invalid undo of an interrupted save: %s", undoPath.c_str());
+        undo.close();
+        std::filesystem::remove(undoPath, error);
+        return true;
+    }
+
+    LOG_F(WARNING, "Undoing a save that did not complete: %s; Strings: %d", filePath.c_str(), (int)patches.size());
+    if (!FileIO::patchFile(filePath, patches))
+    {
+        return false;
+    }
+    undo.close();
+    std::filesystem::remove(undoPath, error);
+    return true;
+}
+
+size_t YtxFile::reassemble(SaveSnapshot& snapshot)
+{
+    LOG_F(INFO, "Reassembling file: %s", snapshot.name.c_str());
+
+    // Everything is laid out first so the final size is known before anything is written
+    int sectionsEnd = layoutEntrySections(snapshot.sections);
+    snapshot.pofoAddress = sectionsEnd - 0x20;
+    snapshot.pofo = buildPofo(snapshot.sections);
+    LOG_F(INFO, "POF0 file rewritten: Size: 0x%x", (int)snapshot.pofo.size());
+
+    ByteWriter writer(snapshot.header);
+    writer.writeAt<int32_t>((size_t)Offset::POFO_FILE_ADDRESS, snapshot.pofoAddress);
+
+    size_t fileSize = sectionsEnd + snapshot.pofo.size();
+    LOG_F(INFO, "File reassembled: %s; Size: 0x%x", snapshot.name.c_str(), (int)fileSize);
+    return fileSize;
+}
+
+int YtxFile::layoutEntrySections(std::vector<EntrySection>& sections)
+{
+    LOG_F(INFO, "Laying out entry sections.");
+    int sectionAddress = sections.empty()
+                             ? (int)Offset::ENTRY_SECTIONS_INFO - 0x20
+                             : sections.at(0).address;
+    for (size_t sectionIndex = 0; sectionIndex < sections.size(); sectionIndex++)
+    {
+        EntrySection* section = &sections.at(sectionIndex);
+        section->address = sectionAddress;
+
+        int stringBytes = getSectionStringsSize(sections, (int)sectionIndex);
+        sectionAddress += (section->entries.size() * ENTRY_SIZE) + stringBytes;
+    }
+    return sectionAddress + 0x20;
+}
+
+void YtxFile::writeEntrySectionsInfo(const std::vector<EntrySection>& sections, FileIO::AtomicFileWriter& out)
+{
+    LOG_F(INFO, "Writing entry sections info.");
+    std::vector<std::byte> sectionsInfo(sections.size() * ENTRY_SECTION_INFO_SIZE);
+    ByteWriter writer(sectionsInfo);
+    for (const EntrySection& section : sections)
+    {
+        writer.write<int32_t>(section.id);
+        writer.write<int32_t>(section.entriesCount);
+        writer.write<int32_t>(section.address);
+    }
+    out.write(sectionsInfo);
+    LOG_F(INFO, "Entry sections info written: File size after entry sections info: 0x%x", (int)out.position());
+}
+
+void YtxFile::writeEntrySections(std::vector<EntrySection>& sections, FileIO::AtomicFileWriter& out)
+{
+    LOG_F(INFO, "Writing entry sections.");
+
+    // Reused by every section and string so writing doesn't allocate once they are large enough
+    std::vector<std::byte> entriesTable;
+    std::vector<std::byte> encoded;
+
+    for (size_t sectionIndex = 0; sectionIndex < sections.size(); sectionIndex++)
+    {
+        EntrySection* section = &sections.at(sectionIndex);
+        LOG_F(INFO, "Writing entry section: ID = %x; Address = 0x%x", section->id, section->address);
+
+        // Keep any gap between the header and the first section
+        size_t sectionStart = section->address + 0x20;
+        if (out.position() < sectionStart)
+        {
+            out.fill(std::byte(0), sectionStart - out.position());
+        }
+
+        EntryStore& entries = section->entries;
+        entriesTable.resize(entries.size() * ENTRY_SIZE);
+        ByteWriter writer(entriesTable);
+
+        size_t stringAddress = sectionStart + (entries.size() * ENTRY_SIZE);
+        for (size_t entryIndex = 0; entryIndex < entries.size(); entryIndex++)
+        {
+            entries.setStringAddress(entryIndex, (int)(stringAddress - 0x20));
+
+            writer.write<int32_t>(entries.getId(entryIndex));
+            writer.write<int32_t>((int32_t)(stringAddress - 0x20));
+
+            int stringSize = entries.getStringSize(entryIndex);
+            if (stringSize % 4 != 0)
+            {
+                LOG_F(WARNING,
+                      "String size is not divisible by 4: Section index: %zu; Entry index: %zu; String size: 0x%x",
+                      sectionIndex, entryIndex, stringSize);
+            }
+            stringAddress += stringSize;
+        }
+        out.write(entriesTable);
+        LOG_F(INFO, "Entry section written: ID = %x; File size = 0x%x", section->id, (int)out.position());
+
+        LOG_F(INFO, "Writing strings from entry section: ID = %x", section->id);
+        for (size_t entryIndex = 0; entryIndex < entries.size(); entryIndex++)
+        {
+            size_t stringBytes;
+            if (entries.isDecoded(entryIndex))
+            {
+                encoded.clear();
+                Transcoder::utf8ToUtf16Be(entries.getString(entryIndex), encoded);
+                out.write(encoded);
+                stringBytes = encoded.size();
+            }
+            else
+            {
+                // Strings that were never decoded are still in the file's encoding and
+                // are sent straight from the mapping without being copied
+                std::span<const std::byte> rawString = entries.getRawString(entryIndex);
+                out.writeView(rawString);
+                stringBytes = rawString.size();
+            }
+
+            // Null terminator and padding
+            int stringSize = Utils::getStringSizeUtf16(stringBytes / 2);
+            if (stringSize != entries.getStringSize(entryIndex))
+            {
+                LOG_F(ERROR, "Cached string size out of date: Entry ID = %x; Cached = 0x%x; Actual = 0x%x",
+                      entries.getId(entryIndex), entries.getStringSize(entryIndex), stringSize);
+            }
+            out.fill(std::byte(0), stringSize - stringBytes);
+        }
+        LOG_F(INFO, "Strings written from entry section: ID = %x; File size = 0x%x", section->id, (int)out.position());
+    }
+    LOG_F(INFO, "Entry sections written.");
+}
+
+std::vector<std::byte> YtxFile::buildPofo(const std::vector<EntrySection>& sections)
+{
+    std::vector<int> stringsSizes(sections.size());
+    for (size_t sectionIndex = 0; sectionIndex < sections.size(); sectionIndex++)
+    {
+        stringsSizes[sectionIndex] = getSectionStringsSize(sections, (int)sectionIndex);
+    }
+    return buildPofo(sections, stringsSizes);
+}
+
+std::vector<std::byte> YtxFile::buildPofo(const std::vector<EntrySection>& sections, const std::vector<int>& stringsSizes)
+{
+    // Each section after the first one ends with the size of the strings of the previous section,
+    // encoded in 2 bytes when it fits or 4 bytes otherwise
+    std::vector<unsigned int> sectionsEnd;
+    int entrySectionsCount = (int)sections.size();
+    int pofoSize = 4 + 4 + 1 + entrySectionsCount;
+    for (int sectionIndex = 0; sectionIndex < entrySectionsCount; sectionIndex++)
+    {
+        int initialIndex = (sectionIndex > 0) ? 1 : 0;
+        pofoSize += std::max(0, sections.at(sectionIndex).entriesCount - initialIndex);
+
+        // Not the last section
+        if (sectionIndex < entrySectionsCount - 1)
+        {
+            int writeSize = stringsSizes.at(sectionIndex) / 4;
+            if (writeSize < 0x7FFE)
+            {
+                sectionsEnd.push_back(writeSize + 0x8002);
+                pofoSize += 2;
+            }
+            else
+            {
+                sectionsEnd.push_back(writeSize + 0xC0000002);
+                pofoSize += 4;
+            }
+        }
+    }
+
+    std::vector<std::byte> result(pofoSize);
+    ByteWriter writer(result);
+
+    // POFO Magic number
+    writer.write<uint8_t>('P');
+    writer.write<uint8_t>('O');
+    writer.write<uint8_t>('F');
+    writer.write<uint8_t>('0');
+
+    // POF0 size without header
+    writer.write<int32_t>(pofoSize - 8);
+
+    writer.write<uint8_t>('A');
+    writer.fill(std::byte('C'), entrySectionsCount);
+
+    for (int sectionIndex = 0; sectionIndex < entrySectionsCount; sectionIndex++)
+    {
+        int initialIndex = (sectionIndex > 0) ? 1 : 0;
+        writer.fill(std::byte('B'), std::max(0, sections.at(sectionIndex).entriesCount - initialIndex));
+
+        if (sectionIndex < entrySectionsCount - 1)
+        {
+            unsigned int writeValue = sectionsEnd.at(sectionIndex);
+            if (writeValue < 0xC0000000)
+            {
+                writer.write<uint16_t>(writeValue);
+            }
+            else
+            {
+                writer.write<uint32_t>(writeValue);
+            }
+        }
+    }
+
+    return result;
+}
+
+int YtxFile::computeStringSize(std::string_view _string)
+{
+    return Utils::getStringSizeUtf16(Transcoder::utf16Length(_string));
+}
+
+int YtxFile::getSectionStringsSize(const std::vector<EntrySection>& sections, int sectionIndex)
+{
+    int sizeStrings = sections.at(sectionIndex).stringsSize;
+    if (sizeStrings % 4 != 0)
+    {
+        LOG_F(WARNING, "Size in bytes of strings not divisible by 4: Section index = %d; Size = 0x%x", sectionIndex, sizeStrings);
+    }
+    
+    return sizeStrings;
+}
+
+int YtxFile::addEntry(std::string _string, int entryId, int sectionId)
+{
+    LOG_F(INFO, "Adding new entry: String: %s; ID: %x; Entry Section ID: %x", _string.c_str(), entryId, sectionId);
+
+    EntrySection* targetEntry = findSection(sectionId);
+    if (targetEntry == nullptr)
+    {
+        LOG_F(ERROR, "Failed to add new entry: Invalid section ID.");
+        return INVALID_SECTION_ID;
+    }
+
+    if (entryIdExists(entryId, *targetEntry))
+    {
+        LOG_F(ERROR, "Failed to add new entry: Entry ID %x already exists in Section %x.", entryId, sectionId);
+        return ENTRY_ID_TAKEN;
+    }
+
+    int stringSize = computeStringSize(_string);
+    targetEntry->entryIndexes.insert(entryId, (uint32_t)targetEntry->entries.size());
+    targetEntry->entries.add(entryId, _string, stringSize);
+    indexEntry(targetEntry->entries, targetEntry->entries.size() - 1);
+    targetEntry->stringsSize += stringSize;
+    targetEntry->entriesCount++;
+    layoutVersion++;
+    recordChange(EditJournal::Change{
+        EditJournal::ChangeKind::DO, false, {EditJournal::Edit{EditJournal::EditType::ADD, sectionId, entryId, "", _string}}});
+
+    LOG_F(INFO, "New entry added: String: %s; ID: %x; Entry Section ID: %x", _string.c_str(), entryId, sectionId);
+    return 0;
+}
+
+int YtxFile::removeEntry(int entryId, int sectionId)
+{
+    LOG_F(INFO, "Removing entry: ID: %x; Entry Section ID: %x", entryId, sectionId);
+
+    EntrySection* targetEntry = findSection(sectionId);
+    if (targetEntry == nullptr)
+    {
+        LOG_F(ERROR, "Failed to remove entry: Invalid section ID.");
+        return INVALID_SECTION_ID;
+    }
+
+    uint32_t index = targetEntry->entryIndexes.find(entryId);
+    if (index == IdMap::NOT_FOUND)
+    {
+        LOG_F(ERROR, "Failed to remove entry: Entry ID %x not found: Section ID: %x.", entryId, sectionId);
+        return INVALID_ENTRY_ID;
+    }
+
+    EditJournal::Edit edit{EditJournal::EditType::REMOVE, sectionId, entryId, "", ""};
+    if (!applyingHistory)
+    {
+        edit.oldString = targetEntry->entries.getString(index);
+    }
+
+    targetEntry->stringsSize -= targetEntry->entries.getStringSize(index);
+    unindexEntry(targetEntry->entries, index);
+    targetEntry->entries.removeRow(index);
+    targetEntry->entriesCount--;
+
+    // Only the rows after the removed one move down, an ID repeated after it is now found at its next entry
+    IdMap& entryIndexes = targetEntry->entryIndexes;
+    entryIndexes.erase(entryId);
+    const std::vector<int>& ids = targetEntry->entries.getIds();
+    for (size_t row = index; row < ids.size(); row++)
+    {
+        uint32_t found = entryIndexes.find(ids[row]);
+        if (found == row + 1 || found == IdMap::NOT_FOUND)
+        {
+            entryIndexes.assign(ids[row], (uint32_t)row);
+        }
+    }
+    layoutVersion++;
+    compactSearchIndex();
+    recordChange(EditJournal::Change{EditJournal::ChangeKind::DO, false, {std::move(edit)}});
+
+    LOG_F(INFO, "Entry removed: ID: %x; Entry Section ID: %x", entryId, sectionId);
+    return 0;
+}
+
+int YtxFile::addEntries(std::vector<NewEntry> entries, size_t* invalidIndex)
+{
+    LOG_F(INFO, "Adding %d entries ...", (int)entries.size());
+
+    // IDs are added to the indexes while checking them so repeated ones are caught too,
+    // and taken out again if any entry is invalid
+    std::vector<EntrySection*> targets(entries.size());
+    std::vector<uint32_t> sectionSizes(entrySections.size());
+    for (size_t i = 0; i < entrySections.size(); i++)
+    {
+        sectionSizes[i] = (uint32_t)entrySections[i].entries.size();
+    }
+
+    int result = 0;
+    size_t checked = 0;
+    for (; checked < entries.size(); checked++)
+    {
+        const NewEntry& entry = entries[checked];
+        uint32_t sectionIndex = sectionIndexes.find(entry.sectionId);
+        if (sectionIndex == IdMap::NOT_FOUND)
+        {
+            LOG_F(ERROR, "Failed to add entries: Invalid section ID %x.", entry.sectionId);
+            result = INVALID_SECTION_ID;
+            break;
+        }
+
+        EntrySection& section = entrySections[sectionIndex];
+        if (!section.entryIndexes.insert(entry.entryId, sectionSizes[sectionIndex]))
+        {
+            LOG_F(ERROR, "Failed to add entries: Entry ID %x already exists in Section %x.", entry.entryId, entry.sectionId);
+            result = ENTRY_ID_TAKEN;
+            break;
+        }
+        sectionSizes[sectionIndex]++;
+        targets[checked] = &section;
+    }
+
+    if (result != 0)
+    {
+        for (size_t i = 0; i < checked; i++)
+        {
+            targets[i]->entryIndexes.erase(entries[i].entryId);
+        }
+        if (invalidIndex != nullptr)
+        {
+            *invalidIndex = checked;
+        }
+        return result;
+    }
+
+    for (size_t i = 0; i < entrySections.size(); i++)
+    {
+        entrySections[i].entries.reserve(sectionSizes[i]);
+    }
+
+    EditJournal::Change change{EditJournal::ChangeKind::DO, false, {}};
+    if (!applyingHistory)
+    {
+        change.edits.reserve(entries.size());
+    }
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        EntrySection& section = *targets[i];
+        int stringSize = computeStringSize(entries[i]._string);
+        section.entries.add(entries[i].entryId, entries[i]._string, stringSize);
+        indexEntry(section.entries, section.entries.size() - 1);
+        section.stringsSize += stringSize;
+        section.entriesCount++;
+
+        if (!applyingHistory)
+        {
+            change.edits.push_back(EditJournal::Edit{EditJournal::EditType::ADD, entries[i].sectionId, entries[i].entryId,
+                                                     "", std::move(entries[i]._string)});
+        }
+    }
+    if (!entries.empty())
+    {
+        layoutVersion++;
+        recordChange(std::move(change));
+    }
+
+    LOG_F(INFO, "%d entries added.", (int)entries.size());
+    return 0;
+}
+
+int YtxFile::removeEntries(const std::vector<EntryKey>& entries, size_t* invalidIndex)
+{
+    LOG_F(INFO, "Removing %d entries ...", (int)entries.size());
+
+    // Entries to remove of every section, only allocated for the sections that lose entries
+    std::vector<std::vector<uint8_t>> removed(entrySections.size());
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        uint32_t sectionIndex = sectionIndexes.find(entries[i].sectionId);
+        uint32_t entryIndex = sectionIndex == IdMap::NOT_FOUND
+                                  ? IdMap::NOT_FOUND
+                                  : entrySections[sectionIndex].entryIndexes.find(entries[i].entryId);
+        if (entryIndex == IdMap::NOT_FOUND)
+        {
+            LOG_F(ERROR, "Failed to remove entries: Entry ID %x not found: Section ID: %x.",
+                  entries[i].entryId, entries[i].sectionId);
+            if (invalidIndex != nullptr)
+            {
+                *invalidIndex = i;
+            }
+            return sectionIndex == IdMap::NOT_FOUND ? INVALID_SECTION_ID : INVALID_ENTRY_ID;
+        }
+
+        if (removed[sectionIndex].empty())
         {
-            return true;
+            removed[sectionIndex].resize(entrySections[sectionIndex].entries.size());
         }
+        removed[sectionIndex][entryIndex] = 1;
     }
-    return false;
+
+    EditJournal::Change change{EditJournal::ChangeKind::DO, false, {}};
+    for (size_t sectionIndex = 0; sectionIndex < entrySections.size(); sectionIndex++)
+    {
+        if (removed[sectionIndex].empty())
+        {
+            continue;
+        }
+
+        EntrySection& section = entrySections[sectionIndex];
+        for (size_t row = 0; row < section.entries.size(); row++)
+        {
+            if (removed[sectionIndex][row])
+            {
+                if (!applyingHistory)
+                {
+                    change.edits.push_back(EditJournal::Edit{EditJournal::EditType::REMOVE, section.id,
+                                                             section.entries.getId(row),
+                                                             std::string(section.entries.getString(row)), ""});
+                }
+                section.stringsSize -= section.entries.getStringSize(row);
+                unindexEntry(section.entries, row);
+            }
+        }
+
+        // Entries that stay are moved down over the removed ones, keeping their order
+        section.entries.remove(removed[sectionIndex]);
+        section.entriesCount = (int)section.entries.size();
+        rebuildEntryIndexes(section);
+        layoutVersion++;
+    }
+    compactSearchIndex();
+    if (!entries.empty())
+    {
+        recordChange(std::move(change));
+    }
+
+    LOG_F(INFO, "%d entries removed.", (int)entries.size());
+    return 0;
+}
+
+std::optional<int> YtxFile::getFreeEntryId(int sectionId)
+{
+    EntrySection* section = findSection(sectionId);
+    if (section == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    int id = section->nextFreeId;
+    while (section->entryIndexes.contains(id))
+    {
+        id = id == INT_MAX ? 0 : id + 1;
+    }
+    section->nextFreeId = id == INT_MAX ? 0 : id + 1;
+    return id;
+}
+
+void YtxFile::setEntryString(EntrySection& section, size_t row, std::string_view _string, bool merge)
+{
+    EditJournal::Edit edit{EditJournal::EditType::SET_STRING, section.id, section.entries.getId(row), "", ""};
+    if (!applyingHistory)
+    {
+        edit.oldString = section.entries.getString(row);
+        edit.newString = _string;
+    }
+
+    int stringSize = computeStringSize(_string);
+    section.stringsSize += stringSize - section.entries.getStringSize(row);
+    section.entries.setString(row, _string, stringSize);
+    stringsChanged = true;
+
+    unindexEntry(section.entries, row);
+    indexEntry(section.entries, row);
+    compactSearchIndex();
+    recordChange(EditJournal::Change{EditJournal::ChangeKind::DO, merge, {std::move(edit)}});
+}
+
+size_t YtxFile::openJournal(LoadProgress* progress)
+{
+    std::vector<EditJournal::Change> recovered;
+    journal.open(path, data, recovered);
+    setStage(progress, LoadStage::RECOVERING, recovered.size());
+
+    recoveredChanges = 0;
+    for (EditJournal::Change& change : recovered)
+    {
+        if (!applyEdits(change.edits))
+        {
+            // Later changes could depend on this one, the edits made from now on are written after the last one kept
+            LOG_F(ERROR, "Stopped recovering edits: Change %d of the journal does not apply to the file: %s",
+                  (int)recoveredChanges, name.c_str());
+            journal.dropRecovered(recoveredChanges);
+            break;
+        }
+        journal.replay(std::move(change));
+        recoveredChanges++;
+        if (progress != nullptr)
+        {
+            progress->done = recoveredChanges;
+        }
+    }
+
+    if (recoveredChanges > 0)
+    {
+        LOG_F(INFO, "Recovered %d changes from the journal of: %s", (int)recoveredChanges, name.c_str());
+    }
+    setStage(progress, LoadStage::DONE);
+    return recoveredChanges;
+}
+
+void YtxFile::discardJournal()
+{
+    journal.discard();
+}
+
+void YtxFile::syncJournal(bool force)
+{
+    journal.sync(force);
+}
+
+size_t YtxFile::takeRecoveredChanges()
+{
+    return std::exchange(recoveredChanges, 0);
+}
+
+bool YtxFile::canUndo()
+{
+    return journal.getUndoStep() != nullptr;
+}
+
+bool YtxFile::canRedo()
+{
+    return journal.getRedoStep() != nullptr;
+}
+
+bool YtxFile::undo()
+{
+    const std::vector<EditJournal::Edit>* step = journal.getUndoStep();
+    if (step == nullptr)
+    {
+        return false;
+    }
+
+    EditJournal::Change change = EditJournal::invert(*step, EditJournal::ChangeKind::UNDO);
+    if (!applyEdits(change.edits))
+    {
+        // The history no longer matches the entries
+        LOG_F(ERROR, "Failed to undo, the history of the file was cleared: %s", name.c_str());
+        journal.clearHistory();
+        return false;
+    }
+    journal.record(std::move(change));
+    return true;
+}
+
+bool YtxFile::redo()
+{
+    const std::vector<EditJournal::Edit>* step = journal.getRedoStep();
+    if (step == nullptr)
+    {
+        return false;
+    }
+
+    EditJournal::Change change{EditJournal::ChangeKind::REDO, false, *step};
+    if (!applyEdits(change.edits))
+    {
+        LOG_F(ERROR, "Failed to redo, the history of the file was cleared: %s", name.c_str());
+        journal.clearHistory();
+        return false;
+    }
+    journal.record(std::move(change));
+    return true;
+}
+
+void YtxFile::beginChange()
+{
+    changeDepth++;
+}
+
+void YtxFile::endChange()
+{
+    if (changeDepth == 0 || --changeDepth > 0)
+    {
+        return;
+    }
+
+    if (!groupedChange.edits.empty())
+    {
+        journal.record(std::move(groupedChange));
+    }
+    groupedChange = EditJournal::Change{EditJournal::ChangeKind::DO, false, {}};
+}
+
+bool YtxFile::applyEdits(const std::vector<EditJournal::Edit>& edits)
+{
+    applyingHistory = true;
+    int result = 0;
+    size_t first = 0;
+    while (first < edits.size())
+    {
+        EditJournal::EditType type = edits[first].type;
+        size_t last = first + 1;
+        if (type == EditJournal::EditType::SET_STRING)
+        {
+            EntrySection* section = findSection(edits[first].sectionId);
+            uint32_t row = section == nullptr ? IdMap::NOT_FOUND : section->entryIndexes.find(edits[first].entryId);
+            if (row == IdMap::NOT_FOUND)
+            {
+                result = INVALID_ENTRY_ID;
+                break;
+            }
+            setEntryString(*section, row, edits[first].newString);
+        }
+        else
+        {
+            while (last < edits.size() && edits[last].type == type)
+            {
+                last++;
+            }
+
+            if (type == EditJournal::EditType::ADD)
+            {
+                std::vector<NewEntry> entries;
+                entries.reserve(last - first);
+                for (size_t i = first; i < last; i++)
+                {
+                    entries.push_back(NewEntry{edits[i].entryId, edits[i].sectionId, edits[i].newString});
+                }
+                result = addEntries(std::move(entries));
+            }
+            else
+            {
+                std::vector<EntryKey> entries;
+                entries.reserve(last - first);
+                for (size_t i = first; i < last; i++)
+                {
+                    entries.push_back(EntryKey{edits[i].entryId, edits[i].sectionId});
+                }
+                result = removeEntries(entries);
+            }
+        }
+
+        if (result != 0)
+        {
+            break;
+        }
+        first = last;
+    }
+    applyingHistory = false;
+
+    if (result != 0)
+    {
+        LOG_F(ERROR, "Failed to apply edit %d of %d: Error %d", (int)first + 1, (int)edits.size(), result);
+        return false;
+    }
+    return true;
+}
+
+void YtxFile::recordChange(EditJournal::Change change)
+{
+    if (applyingHistory)
+    {
+        return;
+    }
+
+    if (changeDepth > 0)
+    {
+        std::move(change.edits.begin(), change.edits.end(), std::back_inserter(groupedChange.edits));
+        return;
+    }
+    journal.record(std::move(change));
+}
+
+bool YtxFile::buildSearchIndex(LoadProgress* progress)
+{
+    cancelSearchIndexRebuild();
+
+    // Section and row of every document
+    std::vector<std::pair<EntryStore*, uint32_t>> documents;
+    size_t stringsSize = 0;
+    for (EntrySection& section : entrySections)
+    {
+        for (size_t row = 0; row < section.entries.size(); row++)
+        {
+            section.entries.setSearchId(row, (uint32_t)documents.size());
+            documents.push_back({&section.entries, (uint32_t)row});
+            stringsSize += section.entries.getStringSize(row);
+        }
+    }
+
+    hasSearchIndex = false;
+    if (!indexDocuments(documents, stringsSize, searchIndex, stringArena, progress))
+    {
+        return false;
+    }
+    hasSearchIndex = true;
+    setStage(progress, LoadStage::DONE);
+    LOG_F(INFO, "Search index built: %d strings", (int)documents.size());
+    return true;
+}
+
+bool YtxFile::indexDocuments(const std::vector<std::pair<EntryStore*, uint32_t>>& documents, size_t stringsSize,
+                             TrigramIndex& index, StringArena& arena, LoadProgress* progress)
+{
+    // Every string is copied to the arena, then read twice by the index
+    setStage(progress, LoadStage::INDEXING, documents.size() * 3);
+    arena.clear();
+    arena.reserve(stringsSize, documents.size());
+    for (size_t document = 0; document < documents.size(); document++)
+    {
+        if (progress != nullptr && (document + 1) % LOAD_CHUNK_SIZE == 0)
+        {
+            if (isStopped(progress))
+            {
+                arena.clear();
+                return false;
+            }
+            progress->done += LOAD_CHUNK_SIZE;
+        }
+
+        auto [entries, row] = documents[document];
+        if (entries->isDecoded(row))
+        {
+            arena.add(entries->getString(row));
+        }
+        else
+        {
+            arena.addUtf16Be(entries->getRawString(row));
+        }
+    }
+
+    if (progress != nullptr)
+    {
+        progress->done = documents.size();
+    }
+    index.build(documents.size(), [&](size_t document, std::u16string& buffer) {
+        if (progress != nullptr && (document + 1) % LOAD_CHUNK_SIZE == 0)
+        {
+            progress->done += LOAD_CHUNK_SIZE;
+        }
+        // Once stopped the rest of the strings are skipped, the index is thrown away
+        if (isStopped(progress))
+        {
+            buffer.clear();
+            return std::u16string_view(buffer);
+        }
+        getSearchString(*documents[document].first, documents[document].second, buffer);
+        return std::u16string_view(buffer);
+    });
+
+    if (isStopped(progress))
+    {
+        index.clear();
+        arena.clear();
+        return false;
+    }
+    return true;
+}
+
+const TrigramIndex* YtxFile::getSearchIndex()
+{
+    return hasSearchIndex ? &searchIndex : nullptr;
+}
+
+const StringArena* YtxFile::getStringArena()
+{
+    return hasSearchIndex ? &stringArena : nullptr;
+}
+
+void YtxFile::indexEntry(EntryStore& entries, size_t row)
+{
+    if (!hasSearchIndex)
+    {
+        return;
+    }
+
+    std::u16string _string;
+    getSearchString(entries, row, _string);
+    entries.setSearchId(row, searchIndex.add(_string));
+}
+
+void YtxFile::getSearchString(EntryStore& entries, size_t row, std::u16string& result)
+{
+    result.clear();
+    if (entries.isDecoded(row))
+    {
+        Transcoder::utf8ToUtf16(entries.getString(row), result);
+        return;
+    }
+
+    // No need to decode the string, the index works on UTF-16
+    std::span<const std::byte> rawString = entries.getRawString(row);
+    result.resize(rawString.size() / 2);
+    for (size_t i = 0; i < result.size(); i++)
+    {
+        result[i] = (char16_t)(((unsigned int)rawString[i * 2] << 8) | (unsigned int)rawString[i * 2 + 1]);
+    }
+}
+
+void YtxFile::unindexEntry(EntryStore& entries, size_t row)
+{
+    if (!hasSearchIndex)
+    {
+        return;
+    }
+
+    searchIndex.remove(entries.getSearchId(row));
+    entries.setSearchId(row, EntryStore::NO_SEARCH_ID);
+}
+
+void YtxFile::compactSearchIndex()
+{
+    updateSearchIndex();
+    if (!hasSearchIndex || searchIndexRebuild != nullptr || !searchIndex.needsRebuild())
+    {
+        return;
+    }
+
+    // Building the index takes seconds on the largest files, so it is built from a copy of the entries
+    // while editing goes on, and the changes made in the meantime are applied to it when it is swapped in
+    std::unique_ptr<SearchIndexRebuild> rebuild = std::make_unique<SearchIndexRebuild>();
+    rebuild->mapping = mapping;
+    rebuild->previousCount = searchIndex.getDocumentCount();
+    rebuild->sections.reserve(entrySections.size());
+    for (EntrySection& section : entrySections)
+    {
+        rebuild->sections.push_back(section.entries.share());
+    }
+
+    LOG_F(INFO, "Rebuilding search index: %s", name.c_str());
+    searchIndexStop = std::stop_source();
+    searchIndexThread = std::thread(&YtxFile::rebuildSearchIndex, rebuild.get(), searchIndexStop.get_token());
+    searchIndexRebuild = std::move(rebuild);
+}
+
+void YtxFile::rebuildSearchIndex(SearchIndexRebuild* rebuild, std::stop_token stopToken)
+{
+    std::vector<std::pair<EntryStore*, uint32_t>> documents;
+    size_t stringsSize = 0;
+    rebuild->documents.assign(rebuild->previousCount, TrigramIndex::NO_DOCUMENT);
+    for (EntryStore& entries : rebuild->sections)
+    {
+        for (size_t row = 0; row < entries.size(); row++)
+        {
+            uint32_t searchId = entries.getSearchId(row);
+            if (searchId < rebuild->documents.size())
+            {
+                rebuild->documents[searchId] = (uint32_t)documents.size();
+            }
+            documents.push_back({&entries, (uint32_t)row});
+            stringsSize += entries.getStringSize(row);
+        }
+    }
+
+    LoadProgress progress;
+    progress.stopToken = stopToken;
+    rebuild->built = indexDocuments(documents, stringsSize, rebuild->index, rebuild->arena, &progress);
+    rebuild->done = true;
+}
+
+bool YtxFile::updateSearchIndex()
+{
+    if (!isSearchIndexRebuilt())
+    {
+        return false;
+    }
+
+    searchIndexThread.join();
+    std::unique_ptr<SearchIndexRebuild> rebuild = std::move(searchIndexRebuild);
+    if (!rebuild->built || !hasSearchIndex)
+    {
+        return false;
+    }
+
+    // Entries that kept the document they had when the copy was taken get its new ID, the ones edited or
+    // added since are indexed again, and the documents of the ones edited or removed since are dropped
+    TrigramIndex& index = rebuild->index;
+    std::vector<uint8_t> kept(index.getDocumentCount(), 0);
+    std::u16string _string;
+    for (EntrySection& section : entrySections)
+    {
+        EntryStore& entries = section.entries;
+        for (size_t row = 0; row < entries.size(); row++)
+        {
+            uint32_t searchId = entries.getSearchId(row);
+            uint32_t document = searchId < rebuild->documents.size() ? rebuild->documents[searchId] : TrigramIndex::NO_DOCUMENT;
+            if (document != TrigramIndex::NO_DOCUMENT)
+            {
+                kept[document] = 1;
+            }
+            else
+            {
+                getSearchString(entries, row, _string);
+                document = index.add(_string);
+            }
+            entries.setSearchId(row, document);
+        }
+    }
+    for (size_t document = 0; document < kept.size(); document++)
+    {
+        if (!kept[document])
+        {
+            index.remove((uint32_t)document);
+        }
+    }
+
+    searchIndex = std::move(rebuild->index);
+    stringArena = std::move(rebuild->arena);
+    LOG_F(INFO, "Search index rebuilt: %s; Strings: %d", name.c_str(), (int)kept.size());
+    return true;
+}
+
+bool YtxFile::isSearchIndexRebuilt() const
+{
+    return searchIndexRebuild != nullptr && searchIndexRebuild->done;
+}
+
+void YtxFile::cancelSearchIndexRebuild()
+{
+    searchIndexStop.request_stop();
+    if (searchIndexThread.joinable())
+    {
+        searchIndexThread.join();
+    }
+    searchIndexRebuild.reset();
+}
+
+EntrySection* YtxFile::findSection(int id)
+{
+    uint32_t index = sectionIndexes.find(id);
+    return index == IdMap::NOT_FOUND ? nullptr : &entrySections[index];
+}
+
+bool YtxFile::entryIdExists(int entryId, const EntrySection& section)
+{
+    return section.entryIndexes.contains(entryId);
+}
+
+void YtxFile::rebuildEntryIndexes(EntrySection& section)
+{
+    section.entryIndexes.clear();
+    section.entryIndexes.reserve(section.entries.size());
+
+    int maxId = -1;
+    const std::vector<int>& ids = section.entries.getIds();
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        // Repeated IDs in a file can only be found by their first entry, as before
+        int id = ids[i];
+        section.entryIndexes.insert(id, (uint32_t)i);
+        maxId = std::max(maxId, id);
+    }
+    section.nextFreeId = maxId == INT_MAX ? 0 : std::max(section.nextFreeId, maxId + 1);
 }
\ No newline at end of file
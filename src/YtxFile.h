@@ -1,29 +1,50 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stop_token>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <thread>
+#include "EditJournal.h"
+#include "EntryStore.h"
+#include "IdMap.h"
+#include "MappedFile.h"
+#include "StringArena.h"
+#include "TrigramIndex.h"
 
-struct Entry
+namespace FileIO
 {
-    int id;
-    int stringAddress; // Address of the string in the file - 0x20
-    std::string _string;
-};
+    class AtomicFileWriter;
+}
 
 struct EntrySection
 {
     int id;
     int entriesCount;
     int address;
-    std::vector<Entry> entries;
+    EntryStore entries;
+
+    // Sum of the string sizes of every entry in the section
+    int stringsSize = 0;
+
+    // Position in "entries" of every entry ID, kept up to date by YtxFile
+    IdMap entryIndexes;
+    // Where the search for a free entry ID starts
+    int nextFreeId = 0;
 };
 
 class YtxFile
 {
 // Size of an entry in bytes
-const int ENTRY_SIZE = 8;
+const static int ENTRY_SIZE = 8;
 // Size of an entry section info in bytes(EntrySection struct)
-const int ENTRY_SECTION_INFO_SIZE = 12;
+const static int ENTRY_SECTION_INFO_SIZE = 12;
 
 // Common offsets in .ytx files
 enum class Offset
@@ -40,7 +61,66 @@ public:
     const static int ENTRY_ID_TAKEN = 2;
     const static int INVALID_ENTRY_ID = 3;
 
-    std::vector<std::byte> buffer;
+    // Stages of loading a file, in the order they run
+    enum class LoadStage
+    {
+        MAPPING,
+        HEADER,
+        SECTIONS,
+        ENTRIES,
+        BACKUP,
+        INDEXING,   // buildSearchIndex()
+        RECOVERING, // openJournal()
+        DONE
+    };
+
+    // Lets another thread follow a load and stop it
+    struct LoadProgress
+    {
+        std::atomic<LoadStage> stage = LoadStage::MAPPING;
+        // Work done and to do in the current stage, entries or strings depending on the stage
+        std::atomic<size_t> done = 0;
+        std::atomic<size_t> total = 0;
+        // The load stops at the next check once a stop is requested, leaving the file invalid
+        std::stop_token stopToken;
+    };
+
+    static const char* getLoadStageName(LoadStage stage);
+    // Normalize a path the way the constructor does, so paths given in different forms can be compared
+    static void cleanPath(std::string& _path);
+
+    // Copy of everything a save writes, taken by createSaveSnapshot() in the time it takes to copy the
+    // entry columns. It is written by writeSnapshot() on any thread while the file keeps being edited,
+    // then merged back into the file by finishSave()
+    struct SaveSnapshot
+    {
+        std::string path;
+        std::string name;
+        bool hasBackup = false;
+        // The whole file is laid out and written again, otherwise only the changed strings are patched
+        bool rewrite = false;
+        std::vector<std::byte> header;
+        std::vector<std::byte> pofo;
+        int pofoAddress = 0;
+        // Entries share the string blocks of the file, the entry indexes are left empty
+        std::vector<EntrySection> sections;
+        // Keeps the bytes the strings that were not decoded point into mapped
+        std::shared_ptr<MappedFile> mapping;
+        uint64_t layoutVersion = 0;
+        // The journal starts over from the saved file, so writeSnapshot() hashes it
+        bool hasJournal = false;
+        EditJournal::Position journalPosition;
+        // Set by writeSnapshot()
+        bool saved = false;
+        uint64_t savedSize = 0;
+        uint64_t savedHash = 0;
+        // File written on Windows, where it can only replace the original once nothing maps it anymore,
+        // which finishSave() does
+        std::string writtenPath;
+    };
+
+    // First bytes of the file, everything after them is rebuilt from the entries when saving
+    std::vector<std::byte> header;
     std::vector<std::byte> pofo;
     std::vector<EntrySection> entrySections;
 
@@ -49,13 +129,104 @@ public:
 
     bool comparePath(std::string compare);
     bool isValid();
-    void load();
-    void saveChanges();
+    const std::string& getPath();
+    const std::string& getName();
+    // Size of the file on disk
+    size_t getSize();
+    // Files are backed up when loaded unless "createBackup" is false(for read only uses)
+    // "progress", if given, is updated as the load goes and can stop it
+    void load(bool createBackup = true, LoadProgress* progress = nullptr);
+    // Returns false if the file on disk could not be updated
+    // "forceRewrite" writes the whole file even when the changes could be patched in place
+    bool saveChanges(bool forceRewrite = false);
+    // saveChanges() in three steps, so the file can be edited while it is written
+    std::unique_ptr<SaveSnapshot> createSaveSnapshot(bool forceRewrite = false);
+    // Touches nothing but the snapshot, returns whether the file on disk was updated
+    static bool writeSnapshot(SaveSnapshot& snapshot);
+    // Give the entries saved the addresses they were written at and mark them as saved,
+    // unless they were changed again since the snapshot was taken
+    // The file written on Windows replaces the file on disk here, "saved" is cleared if it could not
+    void finishSave(SaveSnapshot& snapshot);
+    // Move the file a snapshot wrote over the file on disk, once nothing maps the file anymore
+    static bool moveSavedFile(SaveSnapshot& snapshot);
+    // Entries were edited, added or removed since the file was loaded or last saved
+    bool hasUnsavedChanges();
+    // Bytes allocated for the loaded file, the mapping of the file on disk is not counted
+    // as its pages are shared with the system's file cache
+    size_t getMemoryUsage();
+
+    struct NewEntry
+    {
+        int entryId;
+        int sectionId;
+        std::string _string;
+    };
+
+    struct EntryKey
+    {
+        int entryId;
+        int sectionId;
+    };
 
     int addEntry(std::string _string, int entryId, int sectionId);
     int removeEntry(int entryId, int sectionId);
 
+    // Add or remove many entries in a single pass, nothing changes if any of them is invalid
+    // Returns the error code of the first invalid entry and stores its position in "invalidIndex"
+    int addEntries(std::vector<NewEntry> entries, size_t* invalidIndex = nullptr);
+    int removeEntries(const std::vector<EntryKey>& entries, size_t* invalidIndex = nullptr);
+
+    // Get an ID no entry of the section uses, a different one on every call until it is added
+    // Returns std::nullopt if the section does not exist
+    std::optional<int> getFreeEntryId(int sectionId);
+
+    // Open the journal of the file and replay the changes it holds that were not saved, see EditJournal
+    // Returns the amount of changes recovered
+    size_t openJournal(LoadProgress* progress = nullptr);
+    // Remove the journal, when the changes of the file are discarded
+    void discardJournal();
+    // Sync the journal once its last changes waited long enough, or right away if "force"
+    void syncJournal(bool force = false);
+    // Amount of changes openJournal() recovered, only returned once
+    size_t takeRecoveredChanges();
+
+    bool canUndo();
+    bool canRedo();
+    // Revert the last step of the history, or apply again the last one reverted
+    // Returns false if there is none
+    bool undo();
+    bool redo();
+    // Edits made until the matching endChange() are undone in a single step
+    void beginChange();
+    void endChange();
+
+    // Check that the parts of the loaded file on disk follow each other without overlapping, that POF0 matches
+    // them and that its strings are valid. Strings saved in place may be followed by the padding of their slot
+    // Returns a description of every problem found
+    std::vector<std::string> verify();
+
+    // Replace the string of the entry at "row" of the section, keeping its size and the search index up to date
+    // With "merge", typing in the same entry again is undone along with the edit before it
+    void setEntryString(EntrySection& section, size_t row, std::string_view _string, bool merge = false);
+
+    // Index every string for substring searches, the index is then kept up to date on edits
+    // Also copies the strings to an arena, strings edited or added later are not in it
+    // Returns false, leaving no index, if it was stopped through "progress"
+    bool buildSearchIndex(LoadProgress* progress = nullptr);
+    // Returns nullptr if the index was not built
+    const TrigramIndex* getSearchIndex();
+    // Returns nullptr if the index was not built
+    const StringArena* getStringArena();
+    // Swap in the search index rebuilt on another thread once it is ready, call regularly while nothing
+    // else reads the entries. Returns true if it was swapped, which changes the search IDs of the entries
+    bool updateSearchIndex();
+    // True once the index built on another thread is ready for updateSearchIndex()
+    bool isSearchIndexRebuilt() const;
+
 private:
+    // Lets ytx-bench time the load and save stages on their own
+    friend struct YtxFileBenchAccess;
+
     std::string name;
     std::string path;
     bool valid;
@@ -63,28 +234,134 @@ private:
 
     int pofoAddress{};
     int entrySectionsCount{};
+    // Position in entrySections of every section ID
+    IdMap sectionIndexes;
+
+    // Incremented when entries are added or removed, the layout changed since the file was last
+    // saved if it differs from the version that was saved
+    uint64_t layoutVersion = 0;
+    uint64_t savedLayoutVersion = 0;
+    // Strings were edited since the file was last saved
+    bool stringsChanged = false;
+    // No two strings, entry tables or other parts of the file on disk overlap, so a string can be
+    // written over its slot without touching anything else
+    bool disjointSlots = false;
+
+    // Read-only mapping of the file on disk, shared with the snapshots being saved
+    // Strings that were not decoded yet point into it
+    std::shared_ptr<MappedFile> mapping;
+    // View over the mapped bytes
+    std::span<const std::byte> data;
+
+    // History of the edits, written to a journal once openJournal() was called
+    EditJournal journal;
+    // Edits applied from the history are not recorded again
+    bool applyingHistory = false;
+    // Edits gathered between beginChange() and endChange()
+    int changeDepth = 0;
+    EditJournal::Change groupedChange{EditJournal::ChangeKind::DO, false, {}};
+    size_t recoveredChanges = 0;
 
-    void cleanPath(std::string& _path);
+    TrigramIndex searchIndex;
+    // Strings as they were when the index was built, with the same document IDs
+    StringArena stringArena;
+    bool hasSearchIndex = false;
+
+    // Search index built again on another thread from a copy of the entries
+    struct SearchIndexRebuild
+    {
+        // Entries of every section, sharing the blocks of their arenas with the file
+        std::vector<EntryStore> sections;
+        // Keeps the bytes the strings that were not decoded point into mapped
+        std::shared_ptr<MappedFile> mapping;
+        // Document IDs the index had given when the copy was taken
+        size_t previousCount = 0;
+        // New document of every previous document ID, NO_DOCUMENT for IDs no entry had
+        std::vector<uint32_t> documents;
+        TrigramIndex index;
+        StringArena arena;
+        bool built = false;
+        std::atomic<bool> done = false;
+    };
+    std::unique_ptr<SearchIndexRebuild> searchIndexRebuild;
+    std::thread searchIndexThread;
+    std::stop_source searchIndexStop;
 
     void backupFile();
-    void saveFile();
+    // Write the reassembled file to disk, replacing the original only once it is complete
+    static bool saveFile(SaveSnapshot& snapshot, size_t fileSize);
+    // Hash the file a snapshot was saved to, for its journal to start over from
+    static void hashSavedFile(SaveSnapshot& snapshot);
+    // Map the file again after saving and point the strings that were not decoded to it
+    void remapFile();
+    // Close every view of the file and replace it with the file written by the snapshot
+    bool replaceWithSavedFile(SaveSnapshot& snapshot);
+
+    bool loadPofo();
+    bool loadHeaderValues();
+    bool loadEntrySections();
+    bool loadEntries(LoadProgress* progress = nullptr);
+    // Give every string of a section the zeros that follow it up to the next string as its slot,
+    // "stringsEnd" is where the strings of the section end in the file
+    void loadSlotSizes(EntryStore& entries, long stringsStart, long stringsEnd);
 
-    void loadPofo();
-    void loadHeaderValues();
-    void loadEntrySections();
-    void loadEntries();
+    // Get a view of "size" bytes of the mapped file starting at "offset"
+    // Returns false if the range is not fully inside the file
+    bool getFileSpan(long offset, long size, std::span<const std::byte>& result);
 
-    // Get the actual size in bytes occupied by a string in a file
-    int getStringSize(std::string _string);
+    // Compute the size in bytes a UTF-8 string takes once encoded in the file
+    static int computeStringSize(std::string_view _string);
     // Get the total amount of bytes occupied by strings in a given section
-    int getSectionStringsSize(int sectionIndex);
+    static int getSectionStringsSize(const std::vector<EntrySection>& sections, int sectionIndex);
+
+    // Lay out the snapshot again and return the new size of the file
+    static size_t reassemble(SaveSnapshot& snapshot);
+
+    // Whether the parts of the loaded file are laid out one after the other without overlapping
+    bool hasDisjointSlots();
+    // Whether every change fits in the string slots of the file on disk
+    bool canPatchInPlace();
+    // Write only the edited strings at their current addresses in the file on disk
+    // The bytes they replace are saved first and put back if the patch does not complete
+    static bool patchChanges(SaveSnapshot& snapshot);
+    // File the bytes a patch overwrites are kept in until it reached the disk
+    static std::string getUndoPath(const std::string& filePath);
+    static bool writeUndo(const SaveSnapshot& snapshot, std::span<const FileIO::Patch> patches, const std::string& undoPath);
+    // Put back the bytes kept by a patch that did not complete and remove them
+    // Returns false if the file could not be restored
+    static bool rollBackPatch(const std::string& filePath, const std::string& undoPath);
+
+    // Assign the new address of every section and return the offset where they end
+    static int layoutEntrySections(std::vector<EntrySection>& sections);
+
+    static void writeEntrySectionsInfo(const std::vector<EntrySection>& sections, FileIO::AtomicFileWriter& out);
+    static void writeEntrySections(std::vector<EntrySection>& sections, FileIO::AtomicFileWriter& out);
+    // Build the POF0 file matching the entry sections
+    static std::vector<std::byte> buildPofo(const std::vector<EntrySection>& sections);
+    // Same, with the bytes taken by the strings of every section given in "stringsSizes"
+    static std::vector<std::byte> buildPofo(const std::vector<EntrySection>& sections, const std::vector<int>& stringsSizes);
 
-    void reassemble();
+    // Give the entry at "row" a new document in the search index, if there is one
+    void indexEntry(EntryStore& entries, size_t row);
+    void unindexEntry(EntryStore& entries, size_t row);
+    // Start building the index again on another thread once most of its documents were removed
+    void compactSearchIndex();
+    static void rebuildSearchIndex(SearchIndexRebuild* rebuild, std::stop_token stopToken);
+    void cancelSearchIndexRebuild();
+    // Copy the strings of "documents" to "arena" and index them, returns false if it was stopped
+    static bool indexDocuments(const std::vector<std::pair<EntryStore*, uint32_t>>& documents, size_t stringsSize,
+                               TrigramIndex& index, StringArena& arena, LoadProgress* progress);
+    // Get the string of an entry as UTF-16, as it is indexed
+    static void getSearchString(EntryStore& entries, size_t row, std::u16string& result);
 
-    void rewriteEntrySectionsInfo();
-    void rewriteEntrySections();
-    void rewritePofo();
+    // Apply edits in order, runs of additions and removals in a single pass each
+    // Returns false, leaving the edits before the invalid one applied, if an edit does not fit the file
+    bool applyEdits(const std::vector<EditJournal::Edit>& edits);
+    // Record a change made to the file, unless it was applied from the history
+    void recordChange(EditJournal::Change change);
 
     EntrySection* findSection(int id);
-    bool entryIdExists(int entryId, EntrySection section);
+    bool entryIdExists(int entryId, const EntrySection& section);
+    // Index the entries of a section by ID again after they were loaded or moved
+    void rebuildEntryIndexes(EntrySection& section);
 };
\ No newline at end of file
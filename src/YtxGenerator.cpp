@@ -0,0 +1,198 @@
+#include "YtxGenerator.h"
+#include "ByteStream.h"
+#include "FileIO.h"
+#include "Transcoder.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace YtxGenerator
+{
+    namespace
+    {
+        void appendCodePoint(std::string& _string, char32_t codePoint)
+        {
+            if (codePoint < 0x80)
+            {
+                _string += (char)codePoint;
+            }
+            else if (codePoint < 0x800)
+            {
+                _string += (char)(0xC0 | (codePoint >> 6));
+                _string += (char)(0x80 | (codePoint & 0x3F));
+            }
+            else if (codePoint < 0x10000)
+            {
+                _string += (char)(0xE0 | (codePoint >> 12));
+                _string += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                _string += (char)(0x80 | (codePoint & 0x3F));
+            }
+            else
+            {
+                _string += (char)(0xF0 | (codePoint >> 18));
+                _string += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+                _string += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+                _string += (char)(0x80 | (codePoint & 0x3F));
+            }
+        }
+
+        int getLength(const Options& options, std::mt19937& random)
+        {
+            int minLength = std::max(0, options.minLength);
+            int maxLength = std::max(minLength, options.maxLength);
+            if (options.distribution == LengthDistribution::UNIFORM)
+            {
+                return std::uniform_int_distribution<int>(minLength, maxLength)(random);
+            }
+
+            // Average of a quarter of the range above the minimum, capped at the maximum
+            double mean = std::max(1.0, (maxLength - minLength) / 4.0);
+            int length = minLength + (int)std::exponential_distribution<double>(1.0 / mean)(random);
+            return std::min(length, maxLength);
+        }
+
+        std::string makeString(const Options& options, std::mt19937& random)
+        {
+            std::uniform_int_distribution<int> percent(0, 99);
+            std::uniform_int_distribution<char32_t> ascii(0x20, 0x7E);
+            std::uniform_int_distribution<char32_t> latin(0xC0, 0x17F);
+            std::uniform_int_distribution<char32_t> cjk(0x4E00, 0x9FFF);
+            std::uniform_int_distribution<char32_t> surrogate(0x1F300, 0x1F64F);
+
+            int latinEnd = options.latinPercent;
+            int cjkEnd = latinEnd + options.cjkPercent;
+            int surrogateEnd = cjkEnd + options.surrogatePercent;
+
+            std::string _string;
+            int characters = getLength(options, random);
+            for (int c = 0; c < characters; c++)
+            {
+                int kind = percent(random);
+                char32_t codePoint = kind < latinEnd       ? latin(random)
+                                     : kind < cjkEnd       ? cjk(random)
+                                     : kind < surrogateEnd ? surrogate(random)
+                                                           : ascii(random);
+                appendCodePoint(_string, codePoint);
+            }
+            return _string;
+        }
+
+        // POF0: "A", a "C" per section, a "B" per entry(but the first of every section after the first one)
+        // and the size of the strings of every section but the last one
+        std::vector<std::byte> makePofo(const std::vector<int>& sectionEntries, const std::vector<int>& sectionStringsSize)
+        {
+            int sectionsCount = (int)sectionEntries.size();
+
+            std::vector<std::byte> pofo(8);
+            std::memcpy(pofo.data(), "POF0", 4);
+            pofo.push_back(std::byte('A'));
+            pofo.insert(pofo.end(), sectionsCount, std::byte('C'));
+            for (int section = 0; section < sectionsCount; section++)
+            {
+                pofo.insert(pofo.end(), std::max(0, sectionEntries[section] - (section > 0 ? 1 : 0)), std::byte('B'));
+                if (section == sectionsCount - 1)
+                {
+                    continue;
+                }
+
+                unsigned int value = sectionStringsSize[section] / 4;
+                std::byte encoded[4];
+                if (value < 0x7FFE)
+                {
+                    ByteStream::store<uint16_t, std::endian::big>(encoded, (uint16_t)(value + 0x8002));
+                    pofo.insert(pofo.end(), encoded, encoded + 2);
+                }
+                else
+                {
+                    ByteStream::store<uint32_t, std::endian::big>(encoded, value + 0xC0000002);
+                    pofo.insert(pofo.end(), encoded, encoded + 4);
+                }
+            }
+            ByteStream::store<int32_t, std::endian::big>(pofo.data() + 4, (int32_t)pofo.size() - 8);
+            return pofo;
+        }
+    }
+
+    std::vector<std::byte> generate(const Options& options)
+    {
+        std::mt19937 random(options.seed);
+        int sectionsCount = std::max(0, options.sectionsCount);
+        size_t entriesCount = sectionsCount > 0 ? options.entriesCount : 0;
+
+        std::vector<int> sectionEntries(sectionsCount, 0);
+        for (int section = 0; section < sectionsCount; section++)
+        {
+            sectionEntries[section] = (int)(entriesCount / sectionsCount + (section < (int)(entriesCount % sectionsCount) ? 1 : 0));
+        }
+
+        // Strings of every section, encoded and padded one after the other
+        std::vector<std::vector<std::byte>> sectionStrings(sectionsCount);
+        std::vector<std::vector<int>> stringSizes(sectionsCount);
+        std::vector<int> sectionStringsSize(sectionsCount, 0);
+        for (int section = 0; section < sectionsCount; section++)
+        {
+            std::vector<std::byte>& strings = sectionStrings[section];
+            for (int entry = 0; entry < sectionEntries[section]; entry++)
+            {
+                size_t start = strings.size();
+                Transcoder::utf8ToUtf16Be(makeString(options, random), strings);
+                strings.resize(start + Utils::getStringSizeUtf16((strings.size() - start) / 2), std::byte(0));
+                stringSizes[section].push_back((int)(strings.size() - start));
+            }
+            sectionStringsSize[section] = (int)strings.size();
+        }
+
+        std::vector<std::byte> pofo = makePofo(sectionEntries, sectionStringsSize);
+
+        size_t infoEnd = 0x28 + sectionsCount * 12;
+        size_t sectionsEnd = infoEnd;
+        for (int section = 0; section < sectionsCount; section++)
+        {
+            sectionsEnd += sectionEntries[section] * 8 + sectionStringsSize[section];
+        }
+
+        std::vector<std::byte> output(sectionsEnd + pofo.size());
+        ByteWriter writer(output);
+        writer.writeAt<int32_t>(0x1C, (int32_t)(sectionsEnd - 0x20));
+        writer.writeAt<int32_t>(0x20, sectionsCount);
+        writer.seek(0x28);
+
+        int address = (int)infoEnd - 0x20;
+        for (int section = 0; section < sectionsCount; section++)
+        {
+            writer.write<int32_t>(0x100 + section);
+            writer.write<int32_t>(sectionEntries[section]);
+            writer.write<int32_t>(address);
+            address += sectionEntries[section] * 8 + sectionStringsSize[section];
+        }
+
+        for (int section = 0; section < sectionsCount; section++)
+        {
+            int stringAddress = (int)writer.position() - 0x20 + sectionEntries[section] * 8;
+            for (int entry = 0; entry < sectionEntries[section]; entry++)
+            {
+                writer.write<int32_t>(entry * 3);
+                writer.write<int32_t>(stringAddress);
+                stringAddress += stringSizes[section][entry];
+            }
+            writer.writeBytes(sectionStrings[section]);
+        }
+        writer.writeBytes(pofo);
+
+        return output;
+    }
+
+    bool writeFile(const std::string& path, const Options& options)
+    {
+        std::vector<std::byte> bytes = generate(options);
+
+        FileIO::AtomicFileWriter out;
+        if (!out.open(path, bytes.size()))
+        {
+            return false;
+        }
+        out.writeView(bytes);
+        return out.commit();
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Generation of valid .ytx files with random strings, used to test and benchmark files of any size
+namespace YtxGenerator
+{
+    enum class LengthDistribution
+    {
+        UNIFORM,    // Any length between the minimum and the maximum is as likely
+        EXPONENTIAL // Mostly short strings with a few long ones, like most localization files
+    };
+
+    struct Options
+    {
+        int sectionsCount = 8;
+        size_t entriesCount = 1000; // Spread evenly over the sections
+
+        // Length of the strings in characters
+        int minLength = 4;
+        int maxLength = 64;
+        LengthDistribution distribution = LengthDistribution::UNIFORM;
+
+        // Share of the characters, in percent, taken from each script. The rest is ASCII
+        int latinPercent = 8;     // U+00C0 - U+017F
+        int cjkPercent = 6;       // U+4E00 - U+9FFF
+        int surrogatePercent = 1; // U+1F300 - U+1F64F, stored as surrogate pairs
+
+        unsigned int seed = 1;
+    };
+
+    // Build the bytes of a file. The same options always produce the same file
+    std::vector<std::byte> generate(const Options& options);
+
+    // Generate a file and write it to "path"
+    bool writeFile(const std::string& path, const Options& options);
+}
@@ -0,0 +1,414 @@
+#include "YtxPatch.h"
+#include "ByteStream.h"
+#include "FileIO.h"
+#include "IdMap.h"
+#include "MappedFile.h"
+#include "Transcoder.h"
+#include "Utils.h"
+#include "YtxFile.h"
+#include <loguru.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <span>
+#include <unordered_set>
+
+namespace YtxPatch
+{
+    namespace
+    {
+        // "YTXP"
+        const uint32_t MAGIC = 0x59545850;
+        const uint32_t VERSION = 1;
+        // Magic, version and amount of operations
+        const size_t HEADER_SIZE = 12;
+        // Type, section ID, entry ID, old hash and the size of the string
+        const size_t OPERATION_SIZE = 21;
+        // Hash of everything before it
+        const size_t TRAILER_SIZE = 8;
+
+        std::span<const std::byte> asBytes(const std::string& _string)
+        {
+            return std::as_bytes(std::span<const char>(_string.data(), _string.size()));
+        }
+
+        // Sections sharing an ID are found by the first one, as everywhere else
+        IdMap indexSections(YtxFile& file)
+        {
+            IdMap sectionIndexes;
+            sectionIndexes.reserve(file.entrySections.size());
+            for (size_t i = 0; i < file.entrySections.size(); i++)
+            {
+                sectionIndexes.insert(file.entrySections[i].id, (uint32_t)i);
+            }
+            return sectionIndexes;
+        }
+
+        // UTF-16 big endian bytes of a string, as they are in the file if it was not decoded
+        std::span<const std::byte> getUtf16(EntryStore& entries, size_t row, std::vector<std::byte>& scratch)
+        {
+            if (!entries.isDecoded(row))
+            {
+                return entries.getRawString(row);
+            }
+            scratch.clear();
+            Transcoder::utf8ToUtf16Be(entries.getString(row), scratch);
+            return scratch;
+        }
+
+        // Strings that were not decoded are converted without being kept, like exporting a table
+        std::string getUtf8(EntryStore& entries, size_t row)
+        {
+            if (entries.isDecoded(row))
+            {
+                return std::string(entries.getString(row));
+            }
+            std::string decoded;
+            Transcoder::utf16BeToUtf8(entries.getRawString(row), decoded);
+            return decoded;
+        }
+
+        bool isSameString(EntryStore& oldEntries, size_t oldRow, EntryStore& newEntries, size_t newRow,
+                          std::vector<std::byte>& oldScratch, std::vector<std::byte>& newScratch)
+        {
+            if (oldEntries.isDecoded(oldRow) && newEntries.isDecoded(newRow))
+            {
+                return oldEntries.getString(oldRow) == newEntries.getString(newRow);
+            }
+            std::span<const std::byte> oldString = getUtf16(oldEntries, oldRow, oldScratch);
+            std::span<const std::byte> newString = getUtf16(newEntries, newRow, newScratch);
+            return std::equal(oldString.begin(), oldString.end(), newString.begin(), newString.end());
+        }
+
+        std::string describeEntry(const Operation& operation, const char* problem)
+        {
+            char message[128];
+            std::snprintf(message, sizeof(message), "Entry %x of section %x %s", (unsigned int)operation.entryId,
+                          (unsigned int)operation.sectionId, problem);
+            return message;
+        }
+    }
+
+    bool diff(YtxFile& oldFile, YtxFile& newFile, std::vector<Operation>& operations, std::string& error)
+    {
+        operations.clear();
+        IdMap oldSections = indexSections(oldFile);
+        IdMap newSections = indexSections(newFile);
+
+        // The editor can't add or remove sections, so neither can a patch
+        char message[64];
+        for (const EntrySection& section : newFile.entrySections)
+        {
+            if (!oldSections.contains(section.id))
+            {
+                std::snprintf(message, sizeof(message), "Section %x is not in the old file", (unsigned int)section.id);
+                error = message;
+                return false;
+            }
+        }
+        for (const EntrySection& section : oldFile.entrySections)
+        {
+            if (!newSections.contains(section.id))
+            {
+                std::snprintf(message, sizeof(message), "Section %x is not in the new file", (unsigned int)section.id);
+                error = message;
+                return false;
+            }
+        }
+
+        // Entries are joined on their IDs through the entry indexes both files keep, strings that were not
+        // decoded are compared as they are in the files and only the ones that differ are converted
+        std::vector<std::byte> oldScratch;
+        std::vector<std::byte> newScratch;
+        for (size_t i = 0; i < newFile.entrySections.size(); i++)
+        {
+            EntrySection& newSection = newFile.entrySections[i];
+            if (newSections.find(newSection.id) != i)
+            {
+                continue;
+            }
+            EntrySection& oldSection = oldFile.entrySections[oldSections.find(newSection.id)];
+            EntryStore& oldEntries = oldSection.entries;
+            EntryStore& newEntries = newSection.entries;
+
+            for (size_t oldRow = 0; oldRow < oldEntries.size(); oldRow++)
+            {
+                int entryId = oldEntries.getId(oldRow);
+                if (newSection.entryIndexes.find(entryId) == IdMap::NOT_FOUND)
+                {
+                    uint64_t oldHash = Utils::hashBytes(getUtf16(oldEntries, oldRow, oldScratch));
+                    operations.push_back({OperationType::REMOVE, newSection.id, entryId, oldHash, ""});
+                }
+            }
+
+            for (size_t newRow = 0; newRow < newEntries.size(); newRow++)
+            {
+                int entryId = newEntries.getId(newRow);
+                uint32_t oldRow = oldSection.entryIndexes.find(entryId);
+                if (oldRow == IdMap::NOT_FOUND)
+                {
+                    operations.push_back({OperationType::ADD, newSection.id, entryId, 0, getUtf8(newEntries, newRow)});
+                }
+                else if (!isSameString(oldEntries, oldRow, newEntries, newRow, oldScratch, newScratch))
+                {
+                    uint64_t oldHash = Utils::hashBytes(getUtf16(oldEntries, oldRow, oldScratch));
+                    operations.push_back({OperationType::SET_STRING, newSection.id, entryId, oldHash,
+                                          getUtf8(newEntries, newRow)});
+                }
+            }
+        }
+
+        LOG_F(INFO, "Compared %s to %s: %d operations", oldFile.getName().c_str(), newFile.getName().c_str(),
+              (int)operations.size());
+        return true;
+    }
+
+    bool write(const std::string& path, const std::vector<Operation>& operations)
+    {
+        size_t size = HEADER_SIZE + TRAILER_SIZE;
+        for (const Operation& operation : operations)
+        {
+            size += OPERATION_SIZE + operation._string.size();
+        }
+
+        std::vector<std::byte> bytes(size);
+        ByteWriter writer(bytes);
+        writer.write<uint32_t>(MAGIC);
+        writer.write<uint32_t>(VERSION);
+        writer.write<uint32_t>((uint32_t)operations.size());
+        for (const Operation& operation : operations)
+        {
+            writer.write<uint8_t>((uint8_t)operation.type);
+            writer.write<int32_t>(operation.sectionId);
+            writer.write<int32_t>(operation.entryId);
+            writer.write<uint64_t>(operation.oldHash);
+            writer.write<uint32_t>((uint32_t)operation._string.size());
+            writer.writeBytes(asBytes(operation._string));
+        }
+        writer.write<uint64_t>(Utils::hashBytes(std::span<const std::byte>(bytes).first(size - TRAILER_SIZE)));
+
+        FileIO::AtomicFileWriter out;
+        if (!out.open(path, size))
+        {
+            LOG_F(ERROR, "Failed to create patch: %s", path.c_str());
+            return false;
+        }
+        out.writeView(bytes);
+        if (!out.commit())
+        {
+            LOG_F(ERROR, "Failed to write patch: %s", path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool read(const std::string& path, std::vector<Operation>& operations, std::string& error)
+    {
+        operations.clear();
+        MappedFile file;
+        if (!file.open(path))
+        {
+            error = "Could not read " + path;
+            return false;
+        }
+
+        std::span<const std::byte> bytes = file.bytes();
+        ByteReader reader(bytes);
+        if (bytes.size() < HEADER_SIZE + TRAILER_SIZE || reader.read<uint32_t>() != MAGIC)
+        {
+            error = path + " is not a patch";
+            return false;
+        }
+        if (reader.read<uint32_t>() != VERSION)
+        {
+            error = path + " was made by another version of the editor";
+            return false;
+        }
+
+        size_t end = bytes.size() - TRAILER_SIZE;
+        if (reader.readAt<uint64_t>(end) != Utils::hashBytes(bytes.first(end)))
+        {
+            error = path + " is damaged";
+            return false;
+        }
+
+        uint32_t operationsCount = reader.read<uint32_t>();
+        if (operationsCount > (end - HEADER_SIZE) / OPERATION_SIZE)
+        {
+            error = path + " is damaged";
+            return false;
+        }
+        operations.reserve(operationsCount);
+        for (uint32_t i = 0; i < operationsCount; i++)
+        {
+            Operation operation;
+            uint8_t type = reader.read<uint8_t>();
+            operation.type = (OperationType)type;
+            operation.sectionId = reader.read<int32_t>();
+            operation.entryId = reader.read<int32_t>();
+            operation.oldHash = reader.read<uint64_t>();
+            std::span<const std::byte> _string = reader.readBytes(reader.read<uint32_t>());
+            operation._string.assign(reinterpret_cast<const char*>(_string.data()), _string.size());
+            if (!reader.good() || reader.position() > end || type < (uint8_t)OperationType::SET_STRING ||
+                type > (uint8_t)OperationType::REMOVE)
+            {
+                operations.clear();
+                error = path + " is damaged";
+                return false;
+            }
+            operations.push_back(std::move(operation));
+        }
+
+        if (reader.position() != end)
+        {
+            operations.clear();
+            error = path + " is damaged";
+            return false;
+        }
+        return true;
+    }
+
+    ApplyResult apply(YtxFile& file, const std::vector<Operation>& operations, bool skipConflicts)
+    {
+        ApplyResult result;
+        IdMap sectionIndexes = indexSections(file);
+
+        struct PlannedString
+        {
+            EntrySection* section;
+            size_t row;
+            const std::string* _string;
+        };
+
+        // Every operation is checked against the file before anything changes
+        std::vector<PlannedString> strings;
+        std::vector<YtxFile::NewEntry> added;
+        std::vector<YtxFile::EntryKey> removed;
+        std::unordered_set<uint64_t> listed;
+        std::vector<std::byte> current;
+        std::vector<std::byte> encoded;
+        for (const Operation& operation : operations)
+        {
+            encoded.clear();
+            if (!Transcoder::utf8ToUtf16Be(operation._string, encoded).ok())
+            {
+                result.error = describeEntry(operation, "has an invalid UTF-8 string");
+                return result;
+            }
+            if (!listed.insert(((uint64_t)(uint32_t)operation.sectionId << 32) | (uint32_t)operation.entryId).second)
+            {
+                result.error = describeEntry(operation, "is listed twice");
+                return result;
+            }
+
+            uint32_t sectionIndex = sectionIndexes.find(operation.sectionId);
+            EntrySection* section = sectionIndex == IdMap::NOT_FOUND ? nullptr : &file.entrySections[sectionIndex];
+            uint32_t row = section == nullptr ? IdMap::NOT_FOUND : section->entryIndexes.find(operation.entryId);
+            std::span<const std::byte> existing;
+            if (row != IdMap::NOT_FOUND)
+            {
+                existing = getUtf16(section->entries, row, current);
+            }
+            bool isApplied = row != IdMap::NOT_FOUND &&
+                             std::equal(existing.begin(), existing.end(), encoded.begin(), encoded.end());
+
+            const char* conflict = nullptr;
+            switch (operation.type)
+            {
+            case OperationType::SET_STRING:
+                if (row == IdMap::NOT_FOUND)
+                {
+                    conflict = "is not in the file";
+                }
+                else if (isApplied)
+                {
+                    result.alreadyApplied++;
+                }
+                else if (Utils::hashBytes(existing) != operation.oldHash)
+                {
+                    conflict = "was changed since the patch was made";
+                }
+                else
+                {
+                    strings.push_back({section, row, &operation._string});
+                }
+                break;
+            case OperationType::ADD:
+                if (section == nullptr)
+                {
+                    conflict = "can't be added, the section is not in the file";
+                }
+                else if (isApplied)
+                {
+                    result.alreadyApplied++;
+                }
+                else if (row != IdMap::NOT_FOUND)
+                {
+                    conflict = "already exists with another string";
+                }
+                else
+                {
+                    added.push_back({operation.entryId, operation.sectionId, operation._string});
+                }
+                break;
+            case OperationType::REMOVE:
+                if (row == IdMap::NOT_FOUND)
+                {
+                    result.alreadyApplied++;
+                }
+                else if (Utils::hashBytes(existing) != operation.oldHash)
+                {
+                    conflict = "was changed since the patch was made";
+                }
+                else
+                {
+                    removed.push_back({operation.entryId, operation.sectionId});
+                }
+                break;
+            }
+
+            if (conflict != nullptr)
+            {
+                if (result.conflicts == 0)
+                {
+                    result.error = describeEntry(operation, conflict);
+                }
+                result.conflicts++;
+            }
+        }
+
+        if (result.conflicts > 0 && !skipConflicts)
+        {
+            return result;
+        }
+
+        // Added entries go after the existing ones and removing entries moves the rows after them,
+        // so strings are replaced at the rows found above before any entry is removed
+        size_t addedCount = added.size();
+        file.beginChange();
+        int errorCode = added.empty() ? 0 : file.addEntries(std::move(added));
+        if (errorCode == 0)
+        {
+            result.added = addedCount;
+            for (const PlannedString& planned : strings)
+            {
+                file.setEntryString(*planned.section, planned.row, *planned._string);
+            }
+            result.changed = strings.size();
+            errorCode = removed.empty() ? 0 : file.removeEntries(removed);
+        }
+        file.endChange();
+
+        if (errorCode != 0)
+        {
+            result.error = "Failed to apply the patch, error code " + std::to_string(errorCode);
+            return result;
+        }
+        result.removed = removed.size();
+        result.ok = true;
+
+        LOG_F(INFO, "Patched %s: %d changed, %d added, %d removed, %d already applied, %d conflicts",
+              file.getName().c_str(), (int)result.changed, (int)result.added, (int)result.removed,
+              (int)result.alreadyApplied, (int)result.conflicts);
+        return result;
+    }
+}
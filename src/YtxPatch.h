@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class YtxFile;
+
+// Differences between two versions of a file, keyed by section ID and entry ID, so a patch holds only the
+// strings that were added, removed or changed.
+// Every change keeps the hash of the string it replaces: a patch applies to any version of the file where
+// the entries it touches were left as they were, so patches that change different entries can be applied
+// one after the other in any order, and a patch changing an entry another one changed is caught.
+namespace YtxPatch
+{
+    enum class OperationType : uint8_t
+    {
+        SET_STRING = 1,
+        ADD = 2,
+        REMOVE = 3
+    };
+
+    struct Operation
+    {
+        OperationType type;
+        int sectionId;
+        int entryId;
+        // Hash of the UTF-16 string the entry had in the old file, 0 for ADD
+        uint64_t oldHash = 0;
+        // String of the entry in the new file, empty for REMOVE
+        std::string _string;
+    };
+
+    // Operations that turn "oldFile" into "newFile", section by section in the order of "newFile"
+    // Returns false, storing why in "error", if the files don't have the same sections
+    bool diff(YtxFile& oldFile, YtxFile& newFile, std::vector<Operation>& operations, std::string& error);
+
+    // Returns false if the patch could not be written
+    bool write(const std::string& path, const std::vector<Operation>& operations);
+    // Returns false, storing why in "error", if the patch could not be read or is damaged
+    bool read(const std::string& path, std::vector<Operation>& operations, std::string& error);
+
+    struct ApplyResult
+    {
+        bool ok = false;
+        size_t changed = 0;
+        size_t added = 0;
+        size_t removed = 0;
+        // Operations whose entry was already the way the patch leaves it
+        size_t alreadyApplied = 0;
+        // Operations whose entry was changed since the old file, or whose section is missing
+        size_t conflicts = 0;
+        std::string error;
+    };
+
+    // Apply a patch to a loaded file, touching only the entries it lists, as a single undo step
+    // Nothing changes if any operation conflicts, unless "skipConflicts", which applies the others
+    // Saving the file afterwards lays it out once for every change
+    ApplyResult apply(YtxFile& file, const std::vector<Operation>& operations, bool skipConflicts = false);
+}